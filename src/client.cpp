@@ -33,6 +33,7 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <random>
 #include <boost/tokenizer.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -46,71 +47,91 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
-#include <sys/select.h>
 #include <sstream>
 
 
 namespace sbt {
 
-Client::Client(const std::string& port, const std::string& torrent)
+const uint64_t Client::RESUME_SAVE_INTERVAL_MS = 60 * 1000;
+const uint64_t Client::ANNOUNCE_RETRY_INTERVAL_MS = 30 * 1000;
+
+Client::Client(const std::string& port, const std::string& torrent, Storage::Mode storageMode)
   : m_id("SIMPLEBT.TEST.PEERID")
   , m_interval(3600)
   , m_isFirstReq(true)
   , m_isFirstRes(true)
   , m_uploaded(0)
   , m_downloaded(0)
+  , m_resolver(m_reactor)
+  , m_trackers(m_reactor, m_resolver)
+  , m_isZeroCopyUpload(true)
+  , m_minPipelineDepth(PeerConnection::MIN_PIPELINE_DEPTH)
+  , m_maxPipelineDepth(PeerConnection::MAX_PIPELINE_DEPTH)
+  , m_hashPool(m_reactor)
+  , m_isResumeDirty(false)
 {
   srand(time(NULL));
 
-  m_peerIdList.push_back(m_id);
-
-  int fileLen = m_metaInfo.getLength();
-  m_left = fileLen;
-
   m_clientPort = boost::lexical_cast<uint16_t>(port);
 
+  // the tracker lists us as well, under the address we announce
+  PeerEndpoint self;
+  self.setIp("127.0.0.1");
+  self.port = m_clientPort;
+  m_connectedPeers.insert(self);
+
   loadMetaInfo(torrent);
 
-  m_fileLen = m_metaInfo.getLength();
   m_pieceLen = m_metaInfo.getPieceLength();
 
+  // single-file torrents store the name as the file, multi-file torrents as a directory
+  std::vector<Storage::FileSpec> files;
+  m_fileLen = m_metaInfo.getLength();
+  if (m_fileLen >= 0) {
+    Storage::FileSpec spec = {Storage::makePayloadPath(m_metaInfo.getName(), {}), m_fileLen};
+    files.push_back(spec);
+  }
+  else {
+    m_fileLen = 0;
+    for (const auto& file : m_metaInfo.getFiles()) {
+      // the path comes from the .torrent, it must stay inside the download directory
+      Storage::FileSpec spec = {Storage::makePayloadPath(m_metaInfo.getName(), file.path),
+                                file.length};
+      files.push_back(spec);
+      m_fileLen += file.length;
+    }
+  }
+
   if (m_fileLen % m_pieceLen == 0)
 	  m_numPieces = m_fileLen / m_pieceLen;
   else
 	  m_numPieces = (m_fileLen / m_pieceLen) + 1;
 
-  if (m_numPieces % 8 == 0)
-	  m_numBytes = m_numPieces / 8;
-  else
-	  m_numBytes = (m_numPieces / 8) + 1;
-
-  std::ifstream in(m_metaInfo.getName());
-  if (in){
-	  for (int i = 0; i < m_numPieces; ++i)
-		  m_bitfield.push_back(1);
-	  /*std::ofstream out(m_metaInfo.getName());
-	  out.close();*/
-  }
-  else
-	  for (int i = 0; i < m_numPieces; ++i)
-		  m_bitfield.push_back(0);
-
-  // build a vector of hash strings with index starting at 0.
-  // used after downloading a piece to check against the computed hash of that piece
-  std::vector<uint8_t> tempVec = m_metaInfo.getPieces();
-  for (int i = 0; i < tempVec.size();)
-	  for (int j = 0; j < 20; ++j)
-	  {
-		  std::string str = "";
-		  char c = (char)tempVec[i];
-		  str += c;
-		  m_hashPieces.push_back(str);
-		  ++i;
-	  }
-
-  for (int i = 0; i < m_numPieces; ++i)
-  {
-	  m_requestSent.push_back(false);
+  // checked against the hash of every piece once it is downloaded
+  m_pieceHashes = m_metaInfo.getPieceHashes();
+  if (m_pieceHashes.size() != static_cast<size_t>(m_numPieces))
+    throw bencoding::Error("Number of piece hashes does not match the payload length");
+
+  // the state of the files before opening them decides whether the resume data holds
+  std::vector<std::string> paths;
+  for (const auto& file : files)
+    paths.push_back(file.path);
+  std::vector<ResumeData::FileState> fileStates = ResumeData::statFiles(paths);
+
+  m_storage.open(files, m_pieceLen, storageMode);
+  m_scheduler.init(m_fileLen, m_pieceLen);
+
+  m_bitfield.resize(m_numPieces);
+  if (m_storage.hasExistingData())
+    restorePieces(fileStates);
+  // peers ask for pieces in no particular order
+  m_storage.advise(Storage::ACCESS_RANDOM);
+
+  m_left = m_fileLen;
+  m_picker.init(m_numPieces);
+  for (size_t i = m_bitfield.findFirst(); i != Bitset::npos; i = m_bitfield.findFirst(i + 1)) {
+    m_picker.setHave(i);
+    m_left -= m_scheduler.getPieceLength(i);
   }
 
   run();
@@ -119,461 +140,615 @@ Client::Client(const std::string& port, const std::string& torrent)
 void
 Client::run()
 {
-	connectTracker();
-	sendTrackerRequest();
-	m_isFirstReq = false;
-	recvTrackerResponse();
-  while (true) {
-      // now m_peers have a list of peers that have my requested file
-	connectPeers();
-	downloadAndUpload();
-	//sendPeerRequest();
-	//download();
-    close(m_trackerSock);
-    //sleep(m_interval);
+  startListening();
+  // peers are connected as soon as the tracker answers
+  announce();
+  scheduleSaveResume();
+
+  m_reactor.run();
+}
+
+std::string
+Client::getResumePath()
+{
+  return m_metaInfo.getName() + ".resume";
+}
+
+void
+Client::restorePieces(const std::vector<ResumeData::FileState>& fileStates)
+{
+  ConstBufferPtr infoHash = m_metaInfo.getHash();
+  std::string infoHashStr(infoHash->begin(), infoHash->end());
+
+  ResumeData resume;
+  if (resume.load(getResumePath(), m_numPieces) && resume.matches(infoHashStr, fileStates)) {
+    m_bitfield = resume.getPieces();
+    return;
   }
+
+  // no resume data, or the files were changed behind our back: hash everything
+  Bitset candidates(m_numPieces);
+  candidates.setAll();
+
+  bool isDone = false;
+  Recheck recheck(m_storage, m_hashPool, m_pieceHashes);
+  recheck.start(candidates, [this, &isDone] (const Bitset& valid) {
+      m_bitfield = valid;
+      isDone = true;
+    });
+  while (!isDone)
+    m_reactor.runOnce();
+
+  saveResume();
 }
 
-void Client::downloadAndUpload()
+void
+Client::saveResume()
 {
-	int maxSockfd = 0;
-
-	fd_set readFds;
-	fd_set tmpFds;
-	FD_ZERO(&readFds);
-	FD_ZERO(&tmpFds);
-
-	// create a socket using TCP IP
-	int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-	maxSockfd = sockfd;
-
-	// put the socket in the socket set
-	FD_SET(sockfd, &tmpFds);
-
-	// allow others to reuse the address
-	int yes = 1;
-	if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
-		perror("setsockopt");
-		return 1;
-	}
-
-	// bind address to socket
-	struct sockaddr_in addr;
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(m_clientPort);
-	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-	memset(addr.sin_zero, '\0', sizeof(addr.sin_zero));
-	if (bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-		perror("bind");
-		return 2;
-	}
-
-	// set the socket in listen status
-	if (listen(sockfd, 10) == -1) {
-		perror("listen");
-		return 3;
-	}
-
-	// initialize timer
-	struct timeval tv;
-	tv.tv_sec = m_interval;
-	tv.tv_usec = 0;
-	uint64_t expectedTimeOut = time(nullptr) + m_interval;  // time() gets current time
-
-	while (true) {
-		readFds = tmpFds;
-
-		/*get current time; update timer*/
-		if (expectedTimeOut - time(nullptr) < 0)
-		{
-			connectTracker();
-			sendTrackerRequest();
-			m_isFirstReq = false;
-			recvTrackerResponse();
-			connectPeers();
-			expectedTimeOut = time(nullptr) + m_interval;
-		}
-		tv.tv_sec = expectedTimeOut - time(nullptr);
-		// set up watcher
-		int returnVal = select(maxSockfd + 1, &readFds, NULL, NULL, &tv);
-		if (returnVal == -1) {
-			perror("select");
-			return 4;
-		}
-
-		else if (returnVal == 0)
-		{
-			connectTracker();
-			sendTrackerRequest();
-			m_isFirstReq = false;
-			recvTrackerResponse();
-			connectPeers();
-			expectedTimeOut = time(nullptr) + m_interval;
-		}
-		else
-		{
-			for (int fd = 0; fd <= maxSockfd; fd++) {
-				// get one socket for reading
-				if (FD_ISSET(fd, &readFds)) {
-					if (fd == sockfd) { // this is the listen socket
-						struct sockaddr_in clientAddr;
-						socklen_t clientAddrSize;
-						// I can assume that if a peer already set up a connection with me, it would not try again
-						int clientSockfd = accept(fd, (struct sockaddr*)&clientAddr, &clientAddrSize);
-
-						if (clientSockfd == -1) {
-							perror("accept");
-							return 5;
-						}
-
-						PeerConnection newConn(clientSockfd, false, true);
-						m_peerConnections[clientSockfd] = newConn;
-
-						// update maxSockfd
-						if (maxSockfd < clientSockfd)
-							maxSockfd = clientSockfd;
-
-						// add the socket into the socket set
-						FD_SET(clientSockfd, &tmpFds);
-					}
-					else { // this is the normal socket
-						PeerConnection peerConn = m_peerConnections[fd];
-						if (peerConn.isWaitingHS())
-						{
-							char* buf = new char[68];
-							memset(buf, '\0', sizeof(buf));
-							if (recv(fd, buf, 68, 0) == -1) {
-								perror("recv");
-								return 6;
-							}
-							// convert received char* buffer to ConstBufferPtr so I can extract the id (type) of the message
-							ConstBufferPtr recvData = make_shared<const Buffer>(buf, sizeof(buf));
-							if (peerConn.getInitiated())  // if i first sent a handshake, now I need to send a bitfield
-								sendBitfield(fd);
-							else
-								sendHandshake();
-							peerConn.setNotWaitingHS();
-						}
-						else  // not a handshake
-						{
-							char* buf = new char[5];  // read first 5 bytes to determine length and id
-							memset(buf, '\0', sizeof(buf));
-							if (recv(fd, buf, 5, 0) == -1) {
-								perror("recv");
-								return 6;
-							}
-							// convert received char* buffer to ConstBufferPtr so I can extract the id (type) of the message
-							ConstBufferPtr recvData = make_shared<const Buffer>(buf, sizeof(buf));
-							const uint32_t* value = reinterpret_cast<const uint32_t*>(recvData->buf());
-							uint32_t len = ntohl(*value);
-							uint8_t msgId = (*recvData)[4];  // ID_OFFSET
-							switch (msgId)
-							{
-							case 1:  // unchoke
-								char buf2[1] = { 0 };
-								recv(fd, buf2, 1, 0);  // // unchoke is not special so do not need any processing; unchoke msg is one-byte long
-								sendRequest(fd);  // inputs should be index wanted (need to check bitfield of peer to see availability)
-								// setLastReq() and m_requestSent done in sendRequest()
-								break;
-							case 2:  // interested
-								char buf3[1] = { 0 };
-								recv(fd, buf3, 1, 0);  // // interested is not special so do not need any processing; interested msg is one-byte long
-								sendUnchoke(fd);
-								break;
-							case 4:  // have
-							{
-								char buf4[4] = { 0 };
-								recv(fd, buf4, 4, 0);  // receive the piece index
-								char integrated[9];  // concatenated with length
-								for (int j = 0; j < 5; ++j)
-									integrated[j] = buf[j];
-								for (int j = 5; j < 9; ++j)
-									integrated[j] = buf4[j - 5];
-								ConstBufferPtr hptr = make_shared<const Buffer>(integrated, 9);
-								msg::Have haveMsg;
-								haveMsg.decode(hptr);
-								uint32_t newIndex = haveMsg.getIndex();
-								peerConn.setOneBit(newIndex);  //update peer bitfield
-								break; 
-							}
-							case 5: // bitfield
-							{
-								char * newBuf = new char[m_numBytes];
-								memset(newBuf, 0, m_numBytes);
-								recv(fd, newBuf, m_numBytes, 0);
-								ConstBufferPtr ttt = make_shared<const Buffer>(newBuf, m_numBytes);  // should be constbufferptr bitfield
-								// initialize the peer's bitfield
-								peerConn.setPeerBitfield(ttt, m_numPieces);
-								if (peerConn.getInitiated())  //"I have initiated this socket connection (this socket is for downloading)"
-									// can compare fd with a list of fd's populated when I set up the connections to peers before the while loop
-									// assume I am always interested :p
-									sendInterested(fd);
-								else  // this socket is an uploader
-									sendBitfield(fd);
-								break;
-							}
-							case 6:  // request
-							{
-								char * buf5 = new char[12];
-								memset(buf5, 0, 12);
-								recv(fd, buf5, 12, 0);
-								char * totalBuf = new char[5 + 12];
-								for (int k = 0; k < 5; ++k)
-									totalBuf[k] = buf[k];
-								for (int k = 5; k < 17; ++k)
-									totalBuf[k] = buf5[k - 5];
-								ConstBufferPtr setUp = make_shared<const Buffer>(totalBuf, 17);
-								msg::Request req;
-								req.decode(setUp);
-								int ind = req.getIndex();
-								int off = req.getBegin();
-								int length = req.getLength();
-								sendPiece(fd, ind, off, length);  // when sending, check that I do have the requested piece. Then use index and offset to upload the correct data
-								break; 
-							}
-							case 7:  //piece
-							{
-								char* tempBuff = new char[len - 1];  //it should be that len == m_pieceLen+9
-								memset(tempBuff, 0, len - 1);
-								recv(fd, tempBuff, len - 1, 0);  // receive block and index and offset
-								char * totalBuf2 = new char[5 + len - 1];  // concatentate with length
-								for (int k = 0; k < 5; ++k)
-									totalBuf2[k] = buf[k];
-								for (int k = 5; k < 5 + len - 1; ++k)
-									totalBuf2[k] = tempBuff[k - 5];
-								ConstBufferPtr ttttt = make_shared<const Buffer>(totalBuf2, len - 1 + 5);
-								//myFile2<<"debugging seg fault: "<<"check 7"<<std::endl;
-								msg::Piece piece;
-								piece.decode(ttttt);  // now piece is ready to be checked
-								uint32_t pieceIndex = piece.getIndex();
-								if (peerConn.getLastReq() == pieceIndex)  // check the index is the one I requested
-								{
-									if (checkPieceHash(piece)){  // check hash
-										uint32_t pieceOffset = piece.getBegin();
-										std::ofstream out(m_metaInfo.getName(), std::ofstream::binary);
-										std::ofstream test_out(m_metaInfo.getName() + "Zhao", std::ofstream::binary);
-										out.seekp(pieceIndex*m_pieceLen + pieceOffset);
-										test_out.seekp(pieceIndex*m_pieceLen + pieceOffset);
-										ConstBufferPtr anotherBuf = piece.getBlock();
-										out.write((char*)(anotherBuf->buf()), anotherBuf->size());
-										test_out.write((char*)(anotherBuf->buf()), anotherBuf->size());
-										out.close();
-										test_out.close();
-										m_bitfield[pieceIndex] = 1;  // update my bitfield
-										sendHave(fd, pieceIndex);  // if piece is good, send have_msg.
-									}
-								}
-								break;
-							}
-							}
-						}
-					}
-				}
-			}
-		}
-	}
+  // make sure every piece claimed has reached the disk before recording the file times
+  m_storage.sync();
+
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < m_storage.getNumFiles(); ++i)
+    paths.push_back(m_storage.getFilePath(i));
+
+  ConstBufferPtr infoHash = m_metaInfo.getHash();
+
+  ResumeData resume;
+  resume.setInfoHash(std::string(infoHash->begin(), infoHash->end()));
+  resume.setPieces(m_bitfield);
+  resume.setFiles(ResumeData::statFiles(paths));
+
+  try {
+    resume.save(getResumePath());
+    m_isResumeDirty = false;
+  }
+  catch (const ResumeData::Error& e) {
+    // not fatal, the next start rechecks the payload
+    std::cerr << e.what() << std::endl;
+  }
 }
 
 void
-Client::sendHave(const int& fd, const int& index){
-	msg::Have haveMsg(index);
-	ConstBufferPtr whatever = haveMsg.encode();
-	send(fd, whatever->get(),whatever->size(),0);
+Client::scheduleSaveResume()
+{
+  m_reactor.schedule(RESUME_SAVE_INTERVAL_MS, [this] {
+      if (m_isResumeDirty)
+        saveResume();
+      scheduleSaveResume();
+    });
 }
 
 void
-Client::sendRequest(const int& fd)
+Client::announce()
 {
-	PeerConnection pc = m_peerConnections[fd];
-	std::vector<int> pbf = pc.getBitfield();
-	for (int i = 0; i < m_bitfield.size();++i)
-		if (m_bitfield[i] == 0)
-			if (m_requestSent[i]==false)
-				if (pbf[i] == 1)
-				{
-					msg::Request req(i, 0, m_pieceLen);
-					//myFile2<<"debugging seg fault: "<<"check 3"<<std::endl;
-					ConstBufferPtr d = req.encode();
-					//myFile2<<"debugging seg fault: "<<"check 4"<<std::endl;
-					send(fd, d->get(), d->size(), 0);
-					m_peerConnections[fd].setLastReq(i);
-					m_uploaded += m_pieceLen;
-					m_requestSent[i] = true;
-				}
+  TrackerRequestParam param;
+
+  param.setInfoHash(m_metaInfo.getHash());
+  param.setPeerId(m_id); //TODO:
+  param.setIp("127.0.0.1"); //TODO:
+  param.setPort(m_clientPort); //TODO:
+  param.setUploaded(m_uploaded); //TODO:
+  param.setDownloaded(m_downloaded); //TODO:
+  param.setLeft(m_left); //TODO:
+  if (m_isFirstReq)
+    param.setEvent(TrackerRequestParam::STARTED);
+
+  m_trackers.announce(param,
+                      bind(&Client::handleTrackerPeers, this, std::placeholders::_1),
+                      bind(&Client::handleTrackerDone, this, std::placeholders::_1),
+                      bind(&Client::handleTrackerError, this, std::placeholders::_1));
 }
-// returns true if piece is good
-// returns false if piece is bad
-bool Client::checkPieceHash(const msg::Piece& piece)
+
+void
+Client::handleTrackerPeers(const std::vector<PeerEndpoint>& peers)
 {
-	ConstBufferPtr block = piece.getBlock();
-	uint32_t index = piece.getIndex();
+  // connect right away, slower trackers of the tier may still add more
+  m_peers = peers;
+  connectPeers();
+}
 
-	// should be 20 bytes of length, because a block is a piece
-	ConstBufferPtr hash = util::sha1(block);
-	std::string hashStr = "";
-	char* c = (char*)(hash->buf());
-	for (int i = 0; i < hash->size(); ++i){
-			hashStr += *(c + i);
-	}
+void
+Client::handleTrackerDone(uint64_t interval)
+{
+  m_isFirstReq = false;
+  m_isFirstRes = false;
 
-	return (hashStr == m_hashPieces[index]);
+  m_interval = interval;
+  scheduleAnnounce(m_interval * 1000);
+}
 
+void
+Client::handleTrackerError(const std::string& reason)
+{
+  // transfers go on with the peers we have, ask again later
+  std::cerr << reason << std::endl;
+  scheduleAnnounce(std::min<uint64_t>(ANNOUNCE_RETRY_INTERVAL_MS, m_interval * 1000));
 }
 
+void
+Client::scheduleAnnounce(uint64_t delayMs)
+{
+  m_reactor.schedule(delayMs, [this] { announce(); });
+}
 
-/*used by download()*/
-void Client::connectPeers()
+void
+Client::startListening()
 {
-	for (auto peer : m_peers)
-	{	//if I haven't set up a connection with this peer before
-		if (std::find(m_peerIdList.begin(), m_peerIdList.end(), peer.peerId) == m_peerIdList.end())
-		{
-			int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-			m_client_socketFd.push_back(sockfd);
-
-			struct sockaddr_in serverAddr;
-			serverAddr.sin_family = AF_INET;
-			serverAddr.sin_port = htons(peer.port);     // short, network byte order
-			serverAddr.sin_addr.s_addr = inet_addr(peer.ip.c_str());
-			memset(serverAddr.sin_zero, '\0', sizeof(serverAddr.sin_zero));
-
-			// connect to the server
-			if (connect(sockfd, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) == -1) {
-				perror("connect");
-				throw Error("Cannot connect to peer");
-			}
-
-			sendHandshake(sockfd);
-
-			PeerConnection newConn(sockfd, true, true, peer.peerId);
-			m_peerConnections[sockfd] = newConn;
-			m_peerIdList.push_back(peer.peerId);
-		}
-	}
+  m_serverSock = socket(AF_INET, SOCK_STREAM, 0);
+
+  // allow others to reuse the address
+  int yes = 1;
+  if (setsockopt(m_serverSock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
+    perror("setsockopt");
+    throw Error("Cannot set SO_REUSEADDR on listen socket");
+  }
+
+  // bind address to socket
+  struct sockaddr_in addr;
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(m_clientPort);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  memset(addr.sin_zero, '\0', sizeof(addr.sin_zero));
+  if (bind(m_serverSock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+    perror("bind");
+    throw Error("Cannot bind listen socket");
+  }
+
+  // set the socket in listen status
+  if (listen(m_serverSock, 10) == -1) {
+    perror("listen");
+    throw Error("Cannot listen");
+  }
+
+  net::Reactor::setNonBlocking(m_serverSock);
+  m_reactor.add(m_serverSock, net::Reactor::EVENT_READ,
+                bind(&Client::handleAccept, this, std::placeholders::_1));
 }
 
 void
-Client::sendPiece(const int& fd, const int& index, const int& offset, const int& length)
+Client::handleAccept(uint32_t events)
 {
-	std::ifstream is(m_metaInfo.getName(), std::ifstream::binary);  // is the stream of the entire file
-	if (is)
-	{
-		std::streampos pos = index*m_pieceLen + offset;
-		is.seekg(pos);  // now read pointer points to the start position
-		char * buffer = new char[length];
-		memset(buffer, 0, length);
-		is.read(buffer, length);
-		ConstBufferPtr block = make_shared<const Buffer>(buffer, is.gcount());
-		
-		msg::Piece p(index, offset, block);
-		ConstBufferPtr ptr = p.encode();
-		send(fd, ptr->buf(), ptr->size(), 0);
-	}
+  // edge-triggered: accept everything that is pending before going back to epoll
+  while (true) {
+    struct sockaddr_in clientAddr;
+    socklen_t clientAddrSize = sizeof(clientAddr);
+    int clientSockfd = accept(m_serverSock, (struct sockaddr*)&clientAddr, &clientAddrSize);
 
+    if (clientSockfd == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        perror("accept");
+      return;
+    }
+
+    // I can assume that if a peer already set up a connection with me, it would not try again
+    addPeerConnection(make_shared<PeerConnection>(clientSockfd, false, true));
+  }
 }
 
-// send trivial message
 void
-Client::sendUnchoke(const int& fd){
-	msg::Unchoke unchokeMsg;
-	ConstBufferPtr q = unchokeMsg.encode();
-	send(fd, q->get(), q->size(), 0);
+Client::addPeerConnection(shared_ptr<PeerConnection> conn)
+{
+  using namespace std::placeholders;
+  conn->setOnHandshake(bind(&Client::handleHandshake, this, _1, _2, _3));
+  conn->setOnMessage(bind(&Client::handleMessage, this, _1, _2, _3));
+  conn->setOnClose(bind(&Client::closePeer, this, _1));
+  conn->setOnConnect(bind(&Client::handleConnect, this, _1));
+  conn->setPipelineLimits(m_minPipelineDepth, m_maxPipelineDepth);
+
+  net::Reactor::setNonBlocking(conn->getSocket());
+
+  m_peerConnections[conn->getSocket()] = conn;
+  // with edge triggering, watching EPOLLOUT permanently only costs a wakeup when a full
+  // send buffer drains, which is exactly when queued data has to be flushed
+  m_reactor.add(conn->getSocket(), net::Reactor::EVENT_READ | net::Reactor::EVENT_WRITE,
+                conn.get());
 }
 
 void
-Client::sendInterested(const int& fd){
-	msg::Interested interestMsg;
-	ConstBufferPtr q = interestMsg.encode();
-	send(fd, q->get(), q->size(), 0);
+Client::closePeer(PeerConnection& conn)
+{
+  int fd = conn.getSocket();
+
+  cancelRequests(conn);
+  m_picker.removePeer(conn.getBitfield());
+  conn.setClosed();
+  m_reactor.remove(fd);
+  close(fd);
+
+  // the peer may be connected again when a later announce returns it
+  auto outgoing = m_outgoingPeers.find(fd);
+  if (outgoing != m_outgoingPeers.end()) {
+    m_connectedPeers.erase(outgoing->second);
+    m_outgoingPeers.erase(outgoing);
+  }
+
+  // conn is owned by the map, do not touch it after this line (a handler that is
+  // still running holds its own reference)
+  m_peerConnections.erase(fd);
 }
 
 void
-Client::sendBitfield(const int& fd){
-	char* bitField = new char[m_numBytes];
-	vectorToBitfield(m_bitfield, bitField);  // assume this function works
-	ConstBufferPtr ttt = make_shared<const Buffer>(bitField, m_numBytes);
-	msg::Bitfield bf(ttt);
-			
-	ConstBufferPtr tttt = bf.encode();
-	send(fd, tttt->get(), tttt->size(), 0);
+Client::handleConnect(PeerConnection& conn)
+{
+  sendHandshake(conn);
 }
 
-void 
-Client::vectorToBitfield(const std::vector<uint8_t>& bitFieldVec, char* cPtr)
+void
+Client::handleHandshake(PeerConnection& conn, const uint8_t* frame, size_t length)
 {
-	for (int i = 0, count = 0; i<m_numBytes; i++)
-	{
-		for (int j = 0; j<8 && count < m_numPieces; j++, count++)
-		{
-			cPtr[i] += (bitFieldVec[count] << (8 - 1 - j));
-		}
-	}
-	//result = make_shared<Buffer>(buf, m_numBytes);
-	//return result;
+  if (conn.getInitiated())  // if i first sent a handshake, now I need to send a bitfield
+    sendBitfield(conn);
+  else
+    sendHandshake(conn);
 }
 
-std::vector<int>
-Client::bitfieldToVector(ConstBufferPtr bitfield)
+void
+Client::handleMessage(PeerConnection& conn, const uint8_t* frame, size_t length)
 {
-	std::vector<int> result;
-
-	int size = bitfield->size();
-	const uint8_t* buf = bitfield->buf();
-	for (int i = 0, count = 0; i<size; i++)
-	{
-		for (int j = 0; j<8; j++, count++)
-		{
-			if (count > m_numPieces)
-			{
-				result.push_back(0);
-			}
-			else
-			{
-				result.push_back((1 << (8 - 1 - j) & buf[i]) >> (8 - 1 - j));
-			}
-		}
-	}
-	return result;
+  if (length == 4) // keep-alive
+    return;
+
+  // decode in place: payloads stay views into the connection's receive buffer
+  BufferView msgBuf(frame, length);
+
+  uint8_t msgId = frame[4];  // ID_OFFSET
+  switch (msgId) {
+  case msg::MSG_ID_CHOKE:
+    // the peer discards our outstanding requests
+    conn.setPeerChoking(true);
+    cancelRequests(conn);
+    break;
+  case msg::MSG_ID_UNCHOKE:
+    conn.setPeerChoking(false);
+    sendRequest(conn);
+    break;
+  case msg::MSG_ID_INTERESTED:
+    sendUnchoke(conn);
+    break;
+  case msg::MSG_ID_HAVE:
+    {
+      msg::Have haveMsg;
+      haveMsg.decode(msgBuf);
+      uint32_t index = haveMsg.getIndex();
+      if (index >= static_cast<uint32_t>(m_numPieces) || conn.hasPiece(index))
+        break;
+      conn.setOneBit(index);  //update peer bitfield
+      m_picker.incrementAvailability(index);
+      sendRequest(conn);
+      break;
+    }
+  case msg::MSG_ID_BITFIELD:
+    {
+      msg::Bitfield bitfieldMsg;
+      bitfieldMsg.decode(msgBuf);
+      // initialize the peer's bitfield
+      m_picker.removePeer(conn.getBitfield());
+      conn.setPeerBitfield(bitfieldMsg.getBitfieldView(), m_numPieces);
+      m_picker.addPeer(conn.getBitfield());
+      if (conn.getInitiated())  //"I have initiated this socket connection (this socket is for downloading)"
+        // assume I am always interested :p
+        sendInterested(conn);
+      else  // this socket is an uploader
+        sendBitfield(conn);
+      break;
+    }
+  case msg::MSG_ID_REQUEST:
+    {
+      msg::Request req;
+      req.decode(msgBuf);
+      // sendPiece() checks that I do have the requested piece and that the block is in it
+      try {
+        sendPiece(conn, req.getIndex(), req.getBegin(), req.getLength());
+      }
+      catch (const Storage::Error& e) {
+        // the block cannot be read, the peer would wait for it forever
+        std::cerr << e.what() << std::endl;
+        closePeer(conn);
+      }
+      break;
+    }
+  case msg::MSG_ID_PIECE:
+    {
+      msg::Piece piece;
+      piece.decode(msgBuf);
+      const BufferView& data = piece.getBlockView();
+      Block block = {piece.getIndex(), piece.getBegin(), static_cast<uint32_t>(data.size())};
+
+      // only take blocks we asked this peer for, of pieces still being downloaded; a
+      // block that already came from another peer (endgame) must not touch a piece
+      // that may be being hashed
+      if (!conn.removeRequest(block))
+        break;
+      if (!m_scheduler.isInProgress(block.index) || m_scheduler.isReceived(block)) {
+        sendRequest(conn);
+        break;
+      }
+
+      conn.recordDownload(block.length);
+      m_downloaded += block.length;
+
+      if (m_picker.isEndgame())
+        cancelDuplicates(conn, block);
+
+      try {
+        bool isComplete = false;
+        if (m_storage.isMapped()) {
+          // straight into the page cache, the piece is hashed there once complete
+          m_storage.writeBlock(block.index, block.begin, data);
+          isComplete = m_scheduler.markReceived(block);
+        }
+        else
+          isComplete = m_scheduler.receiveBlock(block, data);
+
+        if (isComplete)
+          completePiece(block.index);
+      }
+      catch (const Storage::Error& e) {
+        // not the peer's fault: the piece is given up and downloaded again
+        std::cerr << e.what() << std::endl;
+        m_scheduler.finishPiece(block.index);
+        m_picker.abortPiece(block.index);
+      }
+
+      sendRequest(conn);
+      break;
+    }
+  default:
+    break;
+  }
 }
 
-void Client::sendHandshake(const int& fd)
+void
+Client::sendHave(PeerConnection& conn, const int& index){
+	msg::Have haveMsg(index);
+	ConstBufferPtr whatever = haveMsg.encode();
+	conn.send(whatever);
+}
+
+void
+Client::sendRequest(PeerConnection& conn)
 {
-	msg::HandShake hsA(m_metaInfo.getHash(), "SIMPLEBT.TEST.PEERID");
-	ConstBufferPtr t = hsA.encode();
-	send(fd, t->get(), t->size(), 0);
+  if (conn.isPeerChoking() || conn.isClosed())
+    return;
+
+  // one word-wide pass tells whether the peer has anything we still need
+  if (conn.getBitfield().findFirstAndNot(m_bitfield) == Bitset::npos)
+    return;
+
+  auto peerHas = [&conn] (uint32_t index) { return conn.hasPiece(index); };
+
+  // all new requests go out in one write
+  auto requests = make_shared<Buffer>();
+  size_t depth = conn.getPipelineDepth();
+  while (conn.getNumRequests() < depth) {
+    Block block;
+    if (!m_scheduler.pickBlock(peerHas, block)) {
+      // no free block left in the pieces in progress, start another one
+      int index = m_picker.pick(peerHas);
+      if (index >= 0) {
+        m_scheduler.startPiece(index);
+        continue;
+      }
+
+      // endgame: ask for the blocks still in flight elsewhere as well, whoever answers
+      // first wins and the other requests are cancelled
+      auto isDuplicate = [&conn] (const Block& block) {
+        return conn.hasPiece(block.index) && !conn.hasRequest(block);
+      };
+      if (!m_picker.isEndgame() || !m_scheduler.pickRequestedBlock(isDuplicate, block))
+        break;
+    }
+
+    msg::Request req(block.index, block.begin, block.length);
+    ConstBufferPtr wire = req.encode();
+    requests->insert(requests->end(), wire->begin(), wire->end());
+    conn.addRequest(block);
+  }
+
+  if (!requests->empty())
+    conn.send(requests);
 }
 
-void Client::receiveHandshake()
+void
+Client::cancelRequests(PeerConnection& conn)
 {
-	char buf[68] = { 0 };
-	
-	ssize_t res = recv(fd, buf, 68, 0);
-			
-	if (res == -1) {
-		perror("recv");
-		return;
-	}
-	
-	ConstBufferPtr tt = make_shared<const Buffer>(buf, 68);
-	
-	msg::HandShake hsB;
-	hsB.decode(tt);
+  for (const auto& block : conn.takeRequests())
+    m_scheduler.cancelBlock(block);
+}
+
+void
+Client::cancelDuplicates(PeerConnection& conn, const Block& block)
+{
+  for (const auto& entry : m_peerConnections) {
+    PeerConnection& other = *entry.second;
+    if (&other != &conn && other.removeRequest(block)) {
+      msg::Cancel cancel(block.index, block.begin, block.length);
+      other.send(cancel.encode());
+    }
+  }
 }
 
-void Client::sendBitfield(const int& fd)
+void
+Client::completePiece(uint32_t index)
 {
-	uint8_t* bitField = new uint8_t[m_numBytes];
-	
-	memset(bitField, '\0', m_numBytes);  // bitField is all zero because I have nothing
-	
-	for (int i = 0; i < m_numBytes; ++i)  // m_bitField should have been initialized and properly updated whenever a verified download happens
-		bitField[i] = m_bitfield[i];
-
-	ConstBufferPtr t = make_shared<const Buffer>(bitField, m_numBytes);
-	msg::Bitfield bf(t);
+  // hashed block by block as it arrived, only the verdict is left
+  uint8_t digest[util::Sha1::DIGEST_LENGTH];
+  if (m_scheduler.getPieceDigest(index, digest)) {
+    handlePieceHashed(index, m_pieceHashes.matches(index, digest));
+    return;
+  }
+
+  uint32_t length = m_scheduler.getPieceLength(index);
+
+  // hashed in place: in the mapping, or in the buffer the blocks were reassembled in;
+  // no more blocks are written to a piece once it is complete
+  BufferView piece;
+  ConstBufferPtr holder;
+  if (m_storage.isMapped())
+    piece = m_storage.getMappedBlock(index, 0, length);
+  if (piece.empty()) {
+    holder = m_storage.isMapped() ? m_storage.readBlock(index, 0, length) // spans files
+                                  : m_scheduler.getPieceData(index);
+    piece = *holder;
+  }
+
+  using namespace std::placeholders;
+  m_hashPool.submit(index, piece, holder, m_pieceHashes[index],
+                    bind(&Client::handlePieceHashed, this, _1, _2));
+}
+
+void
+Client::handlePieceHashed(uint32_t index, bool isValid)
+{
+  if (isValid) {
+    try {
+      if (!m_storage.isMapped())
+        m_storage.writeBlock(index, 0, *m_scheduler.getPieceData(index));
+      // writeback starts now in either mode; it is waited for only by the sync before
+      // the resume data is saved, never per piece on the reactor thread
+      m_storage.syncPiece(index);
+    }
+    catch (const Storage::Error& e) {
+      // the piece did not make it to the disk, treat it like a corrupt one
+      std::cerr << e.what() << std::endl;
+      isValid = false;
+    }
+  }
+
+  // a corrupt piece is downloaded again from scratch
+  m_scheduler.finishPiece(index);
+  if (!isValid) {
+    m_picker.abortPiece(index);
+    return;
+  }
+
+  m_picker.setHave(index);
+  m_bitfield.set(index);
+  m_left -= m_scheduler.getPieceLength(index);
+
+  m_isResumeDirty = true;
+  if (m_left == 0)
+    saveResume();
+
+  // peers still connecting or handshaking learn about the piece from our bitfield
+  for (const auto& entry : m_peerConnections) {
+    if (entry.second->hasSentBitfield())
+      sendHave(*entry.second, index);
+  }
+}
+
+
+void
+Client::connectPeers()
+{
+  for (const auto& peer : m_peers) {
+    // if I haven't set up a connection with this peer before
+    if (!m_connectedPeers.insert(peer).second)
+      continue;
+
+    // non-blocking: an unreachable peer fails on its own, without stalling the reactor
+    int sockfd = socket(peer.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd == -1) {
+      m_connectedPeers.erase(peer);
+      continue;
+    }
+
+    sockaddr_storage addr;
+    socklen_t addrLen = peer.toSockaddr(addr);
+    if (connect(sockfd, reinterpret_cast<sockaddr*>(&addr), addrLen) == -1 &&
+        errno != EINPROGRESS) {
+      close(sockfd);
+      m_connectedPeers.erase(peer);
+      continue;
+    }
+
+    // compact peer lists carry no peer id; the handshake goes out once connected
+    auto conn = make_shared<PeerConnection>(sockfd, true, true, "");
+    conn->setConnecting();
+    m_outgoingPeers[sockfd] = peer;
+    addPeerConnection(conn);
+  }
+}
+
+void
+Client::sendPiece(PeerConnection& conn, const int& index, const int& offset, const int& length)
+{
+  // only verified pieces are served, in blocks no larger than the ones we ask for; a
+  // peer that asks for anything else is dropped
+  if (index < 0 || index >= m_numPieces || !m_bitfield.test(index) ||
+      offset < 0 || length <= 0 || static_cast<uint32_t>(length) > BlockScheduler::BLOCK_LENGTH ||
+      static_cast<int64_t>(offset) + length > m_scheduler.getPieceLength(index)) {
+    closePeer(conn);
+    return;
+  }
+
+  size_t blockLength = length;
+  m_uploaded += blockLength;
+
+  if (m_storage.isMapped()) {
+    // header and the mapped block in one gathering write, the block is never copied
+    std::vector<Storage::Segment> segments;
+    m_storage.locate(index, offset, blockLength, segments);
+    ConstBufferPtr header = msg::Piece::encodeHeader(index, offset, blockLength);
+    for (const auto& segment : segments) {
+      conn.send(header, segment.data, segment.length, segment.mapping);
+      header.reset();
+    }
+    return;
+  }
+
+  if (m_isZeroCopyUpload) {
+    // header from memory, block straight from the page cache, one run per file it spans
+    std::vector<Storage::Segment> segments;
+    m_storage.locate(index, offset, blockLength, segments);
+    ConstBufferPtr header = msg::Piece::encodeHeader(index, offset, blockLength);
+    for (const auto& segment : segments) {
+      conn.sendFile(header, segment.file->fd, segment.offset, segment.length, segment.file);
+      header.reset();
+    }
+    return;
+  }
+
+  ConstBufferPtr block = m_storage.readBlock(index, offset, blockLength);
+
+  // header and block go out in one gathering write, the block is not copied again
+  msg::Piece p(index, offset, block);
+  std::vector<struct iovec> iov;
+  p.encode(iov);
+  conn.send(iov, block);
+}
+
+// send trivial message
+void
+Client::sendUnchoke(PeerConnection& conn){
+	msg::Unchoke unchokeMsg;
+	ConstBufferPtr q = unchokeMsg.encode();
+	conn.send(q);
+}
+
+void
+Client::sendInterested(PeerConnection& conn){
+	msg::Interested interestMsg;
+	ConstBufferPtr q = interestMsg.encode();
+	conn.send(q);
+}
+
+void
+Client::sendBitfield(PeerConnection& conn){
+	msg::Bitfield bf(m_bitfield.encode());
 			
-	ConstBufferPtr tt = bf.encode();
-	send(fd, tt->get(), tt->size(), 0);
+	ConstBufferPtr tttt = bf.encode();
+	conn.send(tttt);
+	conn.setBitfieldSent();
+}
+
+
+void Client::sendHandshake(PeerConnection& conn)
+{
+	msg::HandShake hsA(m_metaInfo.getHash(), "SIMPLEBT.TEST.PEERID");
+	ConstBufferPtr t = hsA.encode();
+	conn.send(t);
 }
 
 //void Client::sendPeerRequest()
@@ -589,7 +764,7 @@ void Client::sendBitfield(const int& fd)
 //		// send and receive hand shake
 //		msg::HandShake hsA(m_metaInfo.getHash(), "SIMPLEBT-TEST-PEERID");
 //		ConstBufferPtr t = hsA.encode();
-//		send(fd, t->get(), t->size(), 0);
+//		conn.send(t);
 //		char buf[68] = { 0 };
 //		//memset(buf, '\0', sizeof(buf));
 //		//memcpy(buf, lastTree, 3);
@@ -630,7 +805,7 @@ void Client::sendBitfield(const int& fd)
 //		msg::Bitfield bf(ttt);
 //		
 //		ConstBufferPtr tttt = bf.encode();
-//		send(fd, tttt->get(), tttt->size(), 0);
+//		conn.send(tttt);
 //
 //		char* buf2 = new char[numBytes];
 //		ssize_t ress = recv(fd, buf2, numBytes, 0);
@@ -643,7 +818,7 @@ void Client::sendBitfield(const int& fd)
 //		// send interest and receive unchoke messages
 //		msg::Interested interestMsg;
 //		ConstBufferPtr q = interestMsg.encode();
-//		send(fd, q->get(), q->size(), 0);
+//		conn.send(q);
 //		//because interest msg is only 1-byte long
 //		char buf3[2048] = { 0 };
 //
@@ -672,7 +847,7 @@ void Client::sendBitfield(const int& fd)
 //			//myFile2<<"debugging seg fault: "<<"check 3"<<std::endl;
 //			ConstBufferPtr d = req.encode();
 //			//myFile2<<"debugging seg fault: "<<"check 4"<<std::endl;
-//			send(fd, d->get(), d->size(), 0);
+//			conn.send(d);
 //			//myFile2<<"debugging seg fault: "<<"check 5"<<std::endl;
 //			sleep(1);
 //			ssize_t dddd = recv(fd, data, pieceLen+512, 0);
@@ -694,7 +869,7 @@ void Client::sendBitfield(const int& fd)
 //			uint32_t index = piece.getIndex();
 //			msg::Have haveMsg(index);
 //			ConstBufferPtr whatever = haveMsg.encode();
-//			send(fd, whatever->get(),whatever->size(),0);
+//			conn.send(whatever);
 //			delete[] data;
 //		}
 //		myFile.close();
@@ -715,191 +890,25 @@ Client::loadMetaInfo(const std::string& torrent)
   std::ifstream is(torrent);
   m_metaInfo.wireDecode(is);
 
-  std::string announce = m_metaInfo.getAnnounce();
-  std::string url;
-  std::string defaultPort;
-  if (announce.substr(0, 5) == "https") {
-    url = announce.substr(8);
-    defaultPort = "443";
-  }
-  else if (announce.substr(0, 4) == "http") {
-    url = announce.substr(7);
-    defaultPort = "80";
-  }
-  else
-    throw Error("Wrong tracker url, wrong scheme");
+  // without an announce-list, the announce URL is the only tracker (BEP 12)
+  std::vector<std::vector<std::string>> tiers = m_metaInfo.getAnnounceList();
+  if (tiers.empty())
+    tiers.push_back(std::vector<std::string>(1, m_metaInfo.getAnnounce()));
 
-  size_t slashPos = url.find('/');
-  if (slashPos == std::string::npos) {
-    throw Error("Wrong tracker url, no file");
+  std::mt19937 random(std::random_device{}());
+  for (auto& tier : tiers) {
+    // the order within a tier is randomized once, answers reorder it later
+    std::shuffle(tier.begin(), tier.end(), random);
+    m_trackers.addTier(tier);
   }
-  m_trackerFile = url.substr(slashPos);
 
-  std::string host = url.substr(0, slashPos);
-
-  size_t colonPos = host.find(':');
-  if (colonPos == std::string::npos) {
-    m_trackerHost = host;
-    m_trackerPort = defaultPort;
-  }
-  else {
-    m_trackerHost = host.substr(0, colonPos);
-    m_trackerPort = host.substr(colonPos + 1);
-  }
-}
+  if (m_trackers.getNumTiers() == 0)
+    throw Error("Wrong tracker url, no usable tracker");
 
-void
-Client::connectTracker()
-{
-  m_trackerSock = socket(AF_INET, SOCK_STREAM, 0);
-
-  struct addrinfo hints;
-  struct addrinfo* res;
-
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET; // IPv4
-  hints.ai_socktype = SOCK_STREAM;
-
-  // get address
-  int status = 0;
-  if ((status = getaddrinfo(m_trackerHost.c_str(), m_trackerPort.c_str(), &hints, &res)) != 0)
-    throw Error("Cannot resolver tracker ip");
-
-  struct sockaddr_in* ipv4 = (struct sockaddr_in*)res->ai_addr;
-  char ipstr[INET_ADDRSTRLEN] = {'\0'};
-  inet_ntop(res->ai_family, &(ipv4->sin_addr), ipstr, sizeof(ipstr));
-  // std::cout << "tracker address: " << ipstr << ":" << ntohs(ipv4->sin_port) << std::endl;
-
-  if (connect(m_trackerSock, res->ai_addr, res->ai_addrlen) == -1) {
-    perror("connect");
-    throw Error("Cannot connect tracker");
-  }
-
-  freeaddrinfo(res);
-}
-
-void
-Client::sendTrackerRequest()
-{
-  TrackerRequestParam param;
-
-  param.setInfoHash(m_metaInfo.getHash());
-  param.setPeerId(m_id); //TODO:
-  param.setIp("127.0.0.1"); //TODO:
-  param.setPort(m_clientPort); //TODO:
-  param.setUploaded(m_uploaded); //TODO:
-  param.setDownloaded(m_downloaded); //TODO:
-  param.setLeft(m_left); //TODO:
-  if (m_isFirstReq)
-    param.setEvent(TrackerRequestParam::STARTED);
-
-  // std::string path = m_trackerFile;
-  std::string path = m_metaInfo.getAnnounce();
-  path += param.encode();
-
-  HttpRequest request;
-  request.setMethod(HttpRequest::GET);
-  request.setHost(m_trackerHost);
-  request.setPort(boost::lexical_cast<uint16_t>(m_trackerPort));
-  request.setPath(path);
-  request.setVersion("1.0");
-
-  Buffer buffer(request.getTotalLength());
-
-  request.formatRequest(reinterpret_cast<char *>(buffer.buf()));
-
-  send(m_trackerSock, buffer.buf(), buffer.size(), 0);
-}
-
-void
-Client::recvTrackerResponse()
-{
-  std::stringstream headerOs;
-  std::stringstream bodyOs;
-
-  char buf[512] = {0};
-  char lastTree[3] = {0};
-
-  bool hasEnd = false;
-  bool hasParseHeader = false;
-  HttpResponse response;
-
-  uint64_t bodyLength = 0;
-
-  while (true) {
-    memset(buf, '\0', sizeof(buf));
-    memcpy(buf, lastTree, 3);
-
-    ssize_t res = recv(m_trackerSock, buf + 3, 512 - 3, 0);
-
-    if (res == -1) {
-      perror("recv");
-      return;
-    }
-
-    const char* endline = 0;
-
-    if (!hasEnd)
-      endline = (const char*)memmem(buf, res, "\r\n\r\n", 4);
-
-    if (endline != 0) {
-      const char* headerEnd = endline + 4;
-
-      headerOs.write(buf + 3, (endline + 4 - buf - 3));
-
-      if (headerEnd < (buf + 3 + res)) {
-        bodyOs.write(headerEnd, (buf + 3 + res - headerEnd));
-      }
-
-      hasEnd = true;
-    }
-    else {
-      if (!hasEnd) {
-        memcpy(lastTree, buf + res, 3);
-        headerOs.write(buf + 3, res);
-      }
-      else
-        bodyOs.write(buf + 3, res);
-    }
-
-    if (hasEnd) {
-      if (!hasParseHeader) {
-        response.parseResponse(headerOs.str().c_str(), headerOs.str().size());
-        hasParseHeader = true;
-
-        bodyLength = boost::lexical_cast<uint64_t>(response.findHeader("Content-Length"));
-      }
-    }
-
-    if (hasParseHeader && bodyOs.str().size() >= bodyLength)
-      break;
-  }
-
-  close(m_trackerSock);
-  FD_CLR(m_trackerSock, &m_readSocks);
-
-
-  bencoding::Dictionary dict;
-
-  std::stringstream tss;
-  tss.str(bodyOs.str());
-  dict.wireDecode(tss);
-
-  TrackerResponse trackerResponse;
-  trackerResponse.decode(dict);
-  //  const std::vector<PeerInfo>&
-  m_peers = trackerResponse.getPeers();
- 
-  m_interval = trackerResponse.getInterval();
-
-//  if (m_isFirstRes) {
-  //  for (const auto& peer : peers) {
-      //std::cout << peer.ip << ":" << peer.port << std::endl;
-//		m_peers.push_back(peer);
-  //  }
-//  }
-
-  m_isFirstRes = false;
+  TrackerUrl primary = TrackerUrl::parse(m_trackers.getTier(0).front());
+  m_trackerHost = primary.host;
+  m_trackerPort = primary.port;
+  m_trackerFile = primary.path;
 }
 
 } // namespace sbt
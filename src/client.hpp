@@ -25,10 +25,19 @@
 #include "common.hpp"
 #include "tracker-response.hpp"
 #include "peerConnection.hpp"
+#include "net/reactor.hpp"
+#include "storage/storage.hpp"
+#include "storage/resume-data.hpp"
+#include "download/block-scheduler.hpp"
+#include "download/piece-picker.hpp"
+#include "download/hash-pool.hpp"
+#include "download/recheck.hpp"
+#include "tracker/tracker-list.hpp"
 #include "msg/msg-base.hpp"
 #include <vector>
 #include "meta-info.hpp"
 #include <unordered_map>
+#include <set>
 //using namespace std;
 
 namespace sbt {
@@ -47,8 +56,41 @@ public:
   };
 
 public:
+  static const uint64_t RESUME_SAVE_INTERVAL_MS;
+  static const uint64_t ANNOUNCE_RETRY_INTERVAL_MS;
+
+  /**
+   * @param storageMode Storage::MODE_MMAP maps the payload, so blocks are hashed, stored
+   *                    and uploaded straight from the page cache
+   */
   Client(const std::string& port,
-         const std::string& torrent);
+         const std::string& torrent,
+         Storage::Mode storageMode = Storage::MODE_PREAD);
+
+  /**
+   * @brief Serve requested blocks with sendfile() instead of reading them into memory
+   *
+   * Enabled by default; when disabled, blocks are read with pread() and sent from
+   * memory.
+   */
+  void
+  setZeroCopyUpload(bool isEnabled)
+  {
+    m_isZeroCopyUpload = isEnabled;
+  }
+
+  /**
+   * @brief Bounds of the number of block requests kept outstanding per peer
+   *
+   * Within the bounds the depth follows each peer's download rate, see
+   * PeerConnection::getPipelineDepth().
+   */
+  void
+  setPipelineLimits(size_t minDepth, size_t maxDepth)
+  {
+    m_minPipelineDepth = minDepth;
+    m_maxPipelineDepth = maxDepth;
+  }
 
   void
   run();
@@ -72,40 +114,104 @@ private:
   void
   loadMetaInfo(const std::string& torrent);
 
+  std::string
+  getResumePath();
+
+  /**
+   * @brief Find out which pieces of the existing payload are valid
+   *
+   * Trusts the resume file if the payload files are unchanged since it was written,
+   * hashes every piece otherwise.
+   */
   void
-  connectTracker();
+  restorePieces(const std::vector<ResumeData::FileState>& fileStates);
 
   void
-  sendTrackerRequest();
+  saveResume();
 
+  /**
+   * @brief Save the resume data periodically while pieces are coming in
+   */
   void
-  recvTrackerResponse();
+  scheduleSaveResume();
 
-  void downloadAndUpload();
+  /**
+   * @brief Start an announce, the peers it returns are connected when it completes
+   */
+  void
+  announce();
 
-  void sendHandshake(const int& fd);
+  void
+  handleTrackerPeers(const std::vector<PeerEndpoint>& peers);
 
-  void sendBitfield(const int& fd);
+  void
+  handleTrackerDone(uint64_t interval);
 
-  void receiveBitfield();
+  void
+  handleTrackerError(const std::string& reason);
 
-  void sendInterested(const int& fd);
+  void
+  scheduleAnnounce(uint64_t delayMs);
 
-  void sendUnchoke(const int& fd);
+  void
+  startListening();
 
-  void sendRequest(const int& fd);
+  void
+  handleAccept(uint32_t events);
 
-  void sendPiece(const int& fd, const int& index, const int& offset, const int& length);
+  void
+  addPeerConnection(shared_ptr<PeerConnection> conn);
 
-  void sendHave(const int& fd, const int& index);
-  
-  void connectPeers();
+  void
+  closePeer(PeerConnection& conn);
 
-  void vectorToBitfield(const std::vector<uint8_t>& bitFieldVec, char* cPtr);
+  void
+  handleConnect(PeerConnection& conn);
+
+  void
+  handleHandshake(PeerConnection& conn, const uint8_t* frame, size_t length);
+
+  void
+  handleMessage(PeerConnection& conn, const uint8_t* frame, size_t length);
+
+  void sendHandshake(PeerConnection& conn);
+
+  void sendBitfield(PeerConnection& conn);
+
+  void sendInterested(PeerConnection& conn);
+
+  void sendUnchoke(PeerConnection& conn);
+
+  /**
+   * @brief Fill the request pipeline of @p conn up to its depth
+   */
+  void sendRequest(PeerConnection& conn);
 
-  std::vector<int> bitfieldToVector(ConstBufferPtr bitfield);
+  /**
+   * @brief Cancel the outstanding requests of @p conn so other peers can take them over
+   */
+  void cancelRequests(PeerConnection& conn);
+
+  /**
+   * @brief Endgame: withdraw the requests for @p block from all peers but @p conn
+   */
+  void cancelDuplicates(PeerConnection& conn, const Block& block);
+
+  /**
+   * @brief Hand a piece whose blocks have all arrived to the hash workers
+   */
+  void completePiece(uint32_t index);
+
+  /**
+   * @brief Store and announce a verified piece, or download a corrupt one again
+   */
+  void handlePieceHashed(uint32_t index, bool isValid);
+
+  void sendPiece(PeerConnection& conn, const int& index, const int& offset, const int& length);
+
+  void sendHave(PeerConnection& conn, const int& index);
   
-  bool checkPieceHash(const msg::Piece& piece);
+  void connectPeers();
 
   //void sendPeerRequest();
 
@@ -114,20 +220,18 @@ private:
 private:
   MetaInfo m_metaInfo;
   std::string m_id;
-  std::vector<PeerInfo> m_peers;
-  std::vector<std::string> m_peerIdList;  // also connection list, by peer id
-  std::vector<int> m_client_socketFd;
-  std::vector<uint8_t> m_bitfield;
-  std::vector<std::string> m_hashPieces;
-  std::vector<bool> m_requestSent;
-  std::unordered_map<int, PeerConnection> m_peerConnections;  // connection list, by fd
-  int m_fileLen;
+  std::vector<PeerEndpoint> m_peers;
+  std::set<PeerEndpoint> m_connectedPeers;  // also connection list, by address
+  std::unordered_map<int, PeerEndpoint> m_outgoingPeers;  // connections I set up, by fd
+  Bitset m_bitfield;  // pieces I have
+  util::DigestTable m_pieceHashes;
+  std::unordered_map<int, shared_ptr<PeerConnection>> m_peerConnections;  // connection list, by fd
+  int64_t m_fileLen;  // total payload length, over all files
   int m_pieceLen;
   int m_numPieces;
-  int m_numBytes;
   int m_uploaded;
   int m_downloaded;
-  int m_left;
+  int64_t m_left;
 
 
   std::string m_trackerHost;
@@ -136,10 +240,23 @@ private:
 
   uint16_t m_clientPort;
 
-  int m_trackerSock;
   int m_serverSock = -1;
 
-  fd_set m_readSocks;
+  net::Reactor m_reactor;
+  net::Resolver m_resolver;
+  TrackerList m_trackers;
+
+  Storage m_storage;
+  bool m_isZeroCopyUpload;
+
+  PiecePicker m_picker;
+  BlockScheduler m_scheduler;
+  size_t m_minPipelineDepth;
+  size_t m_maxPipelineDepth;
+
+  // declared after the state its workers read, so they are stopped first
+  HashPool m_hashPool;
+  bool m_isResumeDirty;
 
   uint64_t m_interval;
   bool m_isFirstReq;
@@ -0,0 +1,223 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "block-scheduler.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+const uint32_t BlockScheduler::BLOCK_LENGTH;
+
+BlockScheduler::BlockScheduler()
+  : m_totalLength(0)
+  , m_pieceLength(0)
+  , m_numPieces(0)
+{
+}
+
+void
+BlockScheduler::init(int64_t totalLength, uint32_t pieceLength)
+{
+  m_totalLength = totalLength;
+  m_pieceLength = pieceLength;
+  m_numPieces = pieceLength > 0 ? (totalLength + pieceLength - 1) / pieceLength : 0;
+  m_pieces.clear();
+}
+
+uint32_t
+BlockScheduler::getPieceLength(uint32_t index) const
+{
+  if (index + 1 < m_numPieces)
+    return m_pieceLength;
+  if (index >= m_numPieces)
+    return 0;
+  return m_totalLength - static_cast<int64_t>(index) * m_pieceLength;
+}
+
+void
+BlockScheduler::startPiece(uint32_t index)
+{
+  if (index >= m_numPieces || isInProgress(index))
+    return;
+
+  PartialPiece& piece = m_pieces[index];
+  piece.blocks.assign(getNumBlocks(index), BLOCK_FREE);
+  piece.numReceived = 0;
+  piece.nextFree = 0;
+  piece.hasher.reset();
+  piece.numHashed = 0;
+}
+
+bool
+BlockScheduler::pickBlock(const PieceFilter& filter, Block& block)
+{
+  for (auto& entry : m_pieces) {
+    PartialPiece& piece = entry.second;
+    if (piece.nextFree >= piece.blocks.size() || !filter(entry.first))
+      continue;
+
+    auto it = std::find(piece.blocks.begin() + piece.nextFree, piece.blocks.end(), BLOCK_FREE);
+    piece.nextFree = it - piece.blocks.begin();
+    if (it == piece.blocks.end())
+      continue;
+
+    *it = BLOCK_REQUESTED;
+    ++piece.nextFree;
+
+    block.index = entry.first;
+    block.begin = (it - piece.blocks.begin()) * BLOCK_LENGTH;
+    block.length = std::min(BLOCK_LENGTH, getPieceLength(entry.first) - block.begin);
+    return true;
+  }
+
+  return false;
+}
+
+bool
+BlockScheduler::pickRequestedBlock(const BlockFilter& filter, Block& block)
+{
+  for (const auto& entry : m_pieces) {
+    const PartialPiece& piece = entry.second;
+    for (size_t i = 0; i < piece.blocks.size(); ++i) {
+      if (piece.blocks[i] != BLOCK_REQUESTED)
+        continue;
+
+      Block candidate;
+      candidate.index = entry.first;
+      candidate.begin = i * BLOCK_LENGTH;
+      candidate.length = std::min(BLOCK_LENGTH, getPieceLength(entry.first) - candidate.begin);
+      if (filter(candidate)) {
+        block = candidate;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+uint8_t*
+BlockScheduler::findBlock(const Block& block, PartialPiece** piece)
+{
+  auto it = m_pieces.find(block.index);
+  if (it == m_pieces.end() || block.begin % BLOCK_LENGTH != 0)
+    return nullptr;
+
+  size_t i = block.begin / BLOCK_LENGTH;
+  if (i >= it->second.blocks.size() ||
+      block.length != std::min(BLOCK_LENGTH, getPieceLength(block.index) - block.begin))
+    return nullptr;
+
+  *piece = &it->second;
+  return &it->second.blocks[i];
+}
+
+bool
+BlockScheduler::isReceived(const Block& block) const
+{
+  auto it = m_pieces.find(block.index);
+  if (it == m_pieces.end() || block.begin % BLOCK_LENGTH != 0)
+    return false;
+
+  size_t i = block.begin / BLOCK_LENGTH;
+  return i < it->second.blocks.size() && it->second.blocks[i] == BLOCK_RECEIVED;
+}
+
+void
+BlockScheduler::cancelBlock(const Block& block)
+{
+  PartialPiece* piece = nullptr;
+  uint8_t* state = findBlock(block, &piece);
+  if (state == nullptr || *state != BLOCK_REQUESTED)
+    return;
+
+  *state = BLOCK_FREE;
+  piece->nextFree = std::min<size_t>(piece->nextFree, block.begin / BLOCK_LENGTH);
+}
+
+bool
+BlockScheduler::markReceived(const Block& block)
+{
+  PartialPiece* piece = nullptr;
+  uint8_t* state = findBlock(block, &piece);
+  if (state == nullptr || *state == BLOCK_RECEIVED)
+    return false;
+
+  // a block that was cancelled but arrives anyway is just as good
+  *state = BLOCK_RECEIVED;
+  ++piece->numReceived;
+  return piece->numReceived == piece->blocks.size();
+}
+
+bool
+BlockScheduler::receiveBlock(const Block& block, const BufferView& data)
+{
+  PartialPiece* piece = nullptr;
+  uint8_t* state = findBlock(block, &piece);
+  if (state == nullptr || *state == BLOCK_RECEIVED || data.size() != block.length)
+    return false;
+
+  if (!static_cast<bool>(piece->data))
+    piece->data = make_shared<Buffer>(getPieceLength(block.index));
+  std::copy(data.begin(), data.end(), piece->data->begin() + block.begin);
+
+  bool isComplete = markReceived(block);
+
+  // blocks mostly arrive in order; one that arrives early waits in the buffer until
+  // the gap before it is filled
+  uint32_t length = piece->data->size();
+  while (piece->numHashed < piece->blocks.size() &&
+         piece->blocks[piece->numHashed] == BLOCK_RECEIVED) {
+    uint32_t begin = piece->numHashed * BLOCK_LENGTH;
+    piece->hasher.update(piece->data->buf() + begin, std::min(BLOCK_LENGTH, length - begin));
+    ++piece->numHashed;
+  }
+
+  return isComplete;
+}
+
+bool
+BlockScheduler::getPieceDigest(uint32_t index, uint8_t* digest)
+{
+  auto it = m_pieces.find(index);
+  if (it == m_pieces.end())
+    return false;
+
+  PartialPiece& piece = it->second;
+  if (!static_cast<bool>(piece.data) || piece.numHashed != piece.blocks.size() ||
+      piece.hasher.getLength() != piece.data->size())
+    return false;
+
+  piece.hasher.final(digest);
+  return true;
+}
+
+ConstBufferPtr
+BlockScheduler::getPieceData(uint32_t index) const
+{
+  auto it = m_pieces.find(index);
+  if (it == m_pieces.end())
+    return nullptr;
+  return it->second.data;
+}
+
+} // namespace sbt
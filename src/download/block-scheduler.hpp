@@ -0,0 +1,216 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_DOWNLOAD_BLOCK_SCHEDULER_HPP
+#define SBT_DOWNLOAD_BLOCK_SCHEDULER_HPP
+
+#include "../common.hpp"
+#include "../util/buffer.hpp"
+#include "../util/hash.hpp"
+
+#include <map>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief A block of a piece, the unit of request and piece messages
+ */
+struct Block
+{
+  uint32_t index;
+  uint32_t begin;
+  uint32_t length;
+};
+
+inline bool
+operator==(const Block& lhs, const Block& rhs)
+{
+  return lhs.index == rhs.index && lhs.begin == rhs.begin && lhs.length == rhs.length;
+}
+
+/**
+ * @brief Splits the pieces being downloaded into blocks and tracks every block's state
+ *
+ * Peers refuse requests for more than BLOCK_LENGTH bytes, so a piece is downloaded as
+ * a series of BLOCK_LENGTH blocks (the last one of the payload may be shorter), possibly
+ * from several peers at once.  A block is free, requested (in flight on some
+ * connection) or received.  The scheduler hands out free blocks of the pieces in
+ * progress, takes back blocks whose request was dropped, and reassembles received
+ * blocks into the piece buffer until the piece is complete.  Received blocks are hashed
+ * as soon as they extend the in-order prefix of their piece, so the piece digest is ready
+ * when its last block arrives, without a second pass over the piece.
+ *
+ * Which pieces to start is up to the caller.
+ */
+class BlockScheduler
+{
+public:
+  static const uint32_t BLOCK_LENGTH = 16 * 1024;
+
+  typedef function<bool(uint32_t index)> PieceFilter;
+  typedef function<bool(const Block& block)> BlockFilter;
+
+public:
+  BlockScheduler();
+
+  /**
+   * @brief Set the payload geometry, forgetting all pieces in progress
+   */
+  void
+  init(int64_t totalLength, uint32_t pieceLength);
+
+  uint32_t
+  getNumPieces() const
+  {
+    return m_numPieces;
+  }
+
+  /**
+   * @brief Length of piece @p index; only the last piece may be shorter than nominal
+   */
+  uint32_t
+  getPieceLength(uint32_t index) const;
+
+  uint32_t
+  getNumBlocks(uint32_t index) const
+  {
+    return (getPieceLength(index) + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+  }
+
+  bool
+  isInProgress(uint32_t index) const
+  {
+    return m_pieces.count(index) > 0;
+  }
+
+  size_t
+  getNumInProgress() const
+  {
+    return m_pieces.size();
+  }
+
+  /**
+   * @brief Start downloading piece @p index, all its blocks become free
+   */
+  void
+  startPiece(uint32_t index);
+
+  /**
+   * @brief Mark the next free block of a piece in progress that passes @p filter as requested
+   * @return false if there is none
+   */
+  bool
+  pickBlock(const PieceFilter& filter, Block& block);
+
+  /**
+   * @brief Endgame: find a block that is requested but not received, for which @p filter holds
+   *
+   * The block stays requested; the caller asks one more peer for it and cancels the
+   * other requests once it arrives.
+   */
+  bool
+  pickRequestedBlock(const BlockFilter& filter, Block& block);
+
+  /**
+   * @brief Make a requested block free again, e.g. after the peer choked or went away
+   */
+  void
+  cancelBlock(const Block& block);
+
+  bool
+  isReceived(const Block& block) const;
+
+  /**
+   * @brief Mark @p block as received without keeping its data
+   *
+   * For callers that store blocks themselves, e.g. straight into a mapped file.
+   * @return true if this completed the piece; false if it did not, or if @p block is
+   *         unexpected or a duplicate
+   */
+  bool
+  markReceived(const Block& block);
+
+  /**
+   * @brief Copy @p data into the piece buffer and mark the block as received
+   * @return true if this completed the piece (see markReceived)
+   */
+  bool
+  receiveBlock(const Block& block, const BufferView& data);
+
+  /**
+   * @brief Digest of a complete piece whose blocks were received with receiveBlock()
+   *
+   * Writes Sha1::DIGEST_LENGTH bytes to @p digest; the digest can be taken only once.
+   * @return false if the piece is not complete, was received with markReceived(), or its
+   *         digest was already taken
+   */
+  bool
+  getPieceDigest(uint32_t index, uint8_t* digest);
+
+  /**
+   * @brief The reassembled piece, if its blocks were received with receiveBlock()
+   */
+  ConstBufferPtr
+  getPieceData(uint32_t index) const;
+
+  /**
+   * @brief Forget piece @p index, after it was stored or failed the hash check
+   */
+  void
+  finishPiece(uint32_t index)
+  {
+    m_pieces.erase(index);
+  }
+
+private:
+  enum BlockState : uint8_t {
+    BLOCK_FREE,
+    BLOCK_REQUESTED,
+    BLOCK_RECEIVED
+  };
+
+  struct PartialPiece
+  {
+    std::vector<uint8_t> blocks; // BlockState of every block
+    size_t numReceived;
+    size_t nextFree; // no free block before this one
+    BufferPtr data;
+    util::Sha1 hasher;
+    size_t numHashed; // blocks fed to hasher, in order
+  };
+
+  /**
+   * @brief The block state slot of @p block, or nullptr if it is not a block in progress
+   */
+  uint8_t*
+  findBlock(const Block& block, PartialPiece** piece);
+
+private:
+  int64_t m_totalLength;
+  uint32_t m_pieceLength;
+  uint32_t m_numPieces;
+  std::map<uint32_t, PartialPiece> m_pieces;
+};
+
+} // namespace sbt
+
+#endif // SBT_DOWNLOAD_BLOCK_SCHEDULER_HPP
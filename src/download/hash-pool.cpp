@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "hash-pool.hpp"
+#include "../util/hash.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+HashPool::HashPool(net::Reactor& reactor, size_t numThreads)
+  : m_reactor(reactor)
+  , m_isStopping(false)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (size_t i = 0; i < numThreads; ++i)
+    m_threads.push_back(std::thread(&HashPool::work, this));
+}
+
+HashPool::~HashPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_hasJob.notify_all();
+
+  for (auto& thread : m_threads)
+    thread.join();
+}
+
+void
+HashPool::submit(uint32_t index, const BufferView& piece, shared_ptr<const void> holder,
+                 const uint8_t* digest, const Callback& callback)
+{
+  Job job = {index, piece, holder, digest, callback};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(job);
+  }
+  m_hasJob.notify_one();
+}
+
+size_t
+HashPool::getBatchWidth() const
+{
+  return util::Sha1Batch::getWidth();
+}
+
+void
+HashPool::work()
+{
+  std::vector<Job> batch;
+  std::vector<BufferView> pieces;
+  std::vector<uint8_t> digests;
+
+  while (true) {
+    batch.clear();
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_hasJob.wait(lock, [this] { return m_isStopping || !m_jobs.empty(); });
+      if (m_isStopping)
+        return;
+
+      // leave enough for the other workers, so that a short burst is still spread over
+      // all cores
+      size_t maxBatch = std::min(getBatchWidth(),
+                                 std::max<size_t>(1, m_jobs.size() / m_threads.size()));
+      do {
+        batch.push_back(std::move(m_jobs.front()));
+        m_jobs.pop_front();
+      } while (batch.size() < maxBatch && !m_jobs.empty() &&
+               m_jobs.front().piece.size() == batch.front().piece.size());
+    }
+
+    pieces.clear();
+    for (const auto& job : batch)
+      pieces.push_back(job.piece);
+    digests.resize(batch.size() * util::Sha1::DIGEST_LENGTH);
+    util::Sha1Batch::hash(pieces.data(), pieces.size(), digests.data());
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const uint8_t* digest = &digests[i * util::Sha1::DIGEST_LENGTH];
+      bool isValid = memcmp(digest, batch[i].digest, util::Sha1::DIGEST_LENGTH) == 0;
+
+      // the holder travels back with the verdict, the piece stays valid until it is handled
+      Callback callback = batch[i].callback;
+      uint32_t index = batch[i].index;
+      shared_ptr<const void> holder = batch[i].holder;
+      m_reactor.post([callback, index, isValid, holder] { callback(index, isValid); });
+    }
+  }
+}
+
+} // namespace sbt
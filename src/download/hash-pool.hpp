@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_DOWNLOAD_HASH_POOL_HPP
+#define SBT_DOWNLOAD_HASH_POOL_HPP
+
+#include "../common.hpp"
+#include "../net/reactor.hpp"
+#include "../util/buffer.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Worker threads that verify completed pieces against their SHA-1 digest
+ *
+ * Hashing a piece of several MiB would stall every socket if it ran on the reactor
+ * thread.  Pieces are queued here instead, hashed by the first idle worker, and the
+ * verdict is posted back to the reactor, where the callback runs; so hashing throughput
+ * grows with the number of cores while all client state stays single-threaded.
+ *
+ * When more pieces of the same length are queued than there are workers, a worker takes
+ * several at once and hashes them side by side with util::Sha1Batch.
+ */
+class HashPool
+{
+public:
+  /**
+   * @brief Receives the verdict for piece @p index, on the reactor thread
+   */
+  typedef function<void(uint32_t index, bool isValid)> Callback;
+
+public:
+  /**
+   * @param numThreads number of workers, 0 for one per core
+   */
+  explicit
+  HashPool(net::Reactor& reactor, size_t numThreads = 0);
+
+  /**
+   * @brief Stop the workers; pieces still queued are not verified
+   */
+  ~HashPool();
+
+  HashPool(const HashPool&) = delete;
+
+  HashPool&
+  operator=(const HashPool&) = delete;
+
+  size_t
+  getNumThreads() const
+  {
+    return m_threads.size();
+  }
+
+  /**
+   * @brief Most pieces a worker hashes at once
+   */
+  size_t
+  getBatchWidth() const;
+
+  /**
+   * @brief Queue piece @p index for verification against @p digest
+   *
+   * @p piece must stay valid and unmodified until @p callback has run; @p holder is
+   * referenced until then to keep it alive.  @p digest, util::Sha1::DIGEST_LENGTH bytes
+   * (usually an entry of the torrent's util::DigestTable), must stay valid as long.
+   */
+  void
+  submit(uint32_t index, const BufferView& piece, shared_ptr<const void> holder,
+         const uint8_t* digest, const Callback& callback);
+
+private:
+  void
+  work();
+
+private:
+  struct Job
+  {
+    uint32_t index;
+    BufferView piece;
+    shared_ptr<const void> holder;
+    const uint8_t* digest;
+    Callback callback;
+  };
+
+  net::Reactor& m_reactor;
+
+  std::mutex m_mutex;
+  std::condition_variable m_hasJob;
+  std::deque<Job> m_jobs;
+  bool m_isStopping;
+
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace sbt
+
+#endif // SBT_DOWNLOAD_HASH_POOL_HPP
@@ -0,0 +1,198 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "piece-picker.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+const uint32_t PiecePicker::RANDOM_FIRST_PIECES = 4;
+
+PiecePicker::PiecePicker()
+  : m_numHave(0)
+  , m_random(std::random_device()())
+{
+}
+
+void
+PiecePicker::init(uint32_t numPieces)
+{
+  m_state.assign(numPieces, PIECE_WANTED);
+  m_availability.assign(numPieces, 0);
+  m_numHave = 0;
+
+  m_order.resize(numPieces);
+  for (uint32_t i = 0; i < numPieces; ++i)
+    m_order[i] = i;
+  std::shuffle(m_order.begin(), m_order.end(), m_random);
+
+  m_position.resize(numPieces);
+  for (size_t i = 0; i < numPieces; ++i)
+    m_position[m_order[i]] = i;
+
+  m_bucketEnd.assign(1, numPieces);
+}
+
+void
+PiecePicker::swapPositions(size_t a, size_t b)
+{
+  std::swap(m_order[a], m_order[b]);
+  m_position[m_order[a]] = a;
+  m_position[m_order[b]] = b;
+}
+
+void
+PiecePicker::insert(uint32_t index)
+{
+  // append to the last bucket, then hop down one bucket at a time by swapping with the
+  // first piece of the current bucket and moving the boundary behind it
+  size_t position = m_order.size();
+  m_order.push_back(index);
+  m_position[index] = position;
+
+  for (size_t bucket = m_bucketEnd.size() - 1; bucket > m_availability[index]; --bucket) {
+    ++m_bucketEnd[bucket];
+    size_t first = m_bucketEnd[bucket - 1];
+    swapPositions(position, first);
+    position = first;
+  }
+  ++m_bucketEnd[m_availability[index]];
+}
+
+void
+PiecePicker::remove(uint32_t index)
+{
+  // the reverse of insert(): hop up to the end of the array and drop it there
+  size_t position = m_position[index];
+  for (size_t bucket = m_availability[index]; bucket < m_bucketEnd.size(); ++bucket) {
+    size_t last = --m_bucketEnd[bucket];
+    swapPositions(position, last);
+    position = last;
+  }
+  m_order.pop_back();
+}
+
+void
+PiecePicker::setHave(uint32_t index)
+{
+  if (m_state[index] == PIECE_HAVE)
+    return;
+
+  if (m_state[index] == PIECE_WANTED)
+    remove(index);
+  m_state[index] = PIECE_HAVE;
+  ++m_numHave;
+}
+
+void
+PiecePicker::incrementAvailability(uint32_t index)
+{
+  uint32_t availability = m_availability[index];
+  if (availability + 1 >= m_bucketEnd.size())
+    m_bucketEnd.push_back(m_order.size());
+
+  if (m_state[index] == PIECE_WANTED) {
+    // the last piece of a bucket becomes the first of the next one
+    size_t last = m_bucketEnd[availability] - 1;
+    swapPositions(m_position[index], last);
+    --m_bucketEnd[availability];
+  }
+  ++m_availability[index];
+}
+
+void
+PiecePicker::decrementAvailability(uint32_t index)
+{
+  uint32_t availability = m_availability[index];
+  if (availability == 0)
+    return;
+
+  if (m_state[index] == PIECE_WANTED) {
+    // the first piece of a bucket becomes the last of the previous one
+    size_t first = m_bucketEnd[availability - 1];
+    swapPositions(m_position[index], first);
+    ++m_bucketEnd[availability - 1];
+  }
+  --m_availability[index];
+}
+
+void
+PiecePicker::addPeer(const Bitset& bitfield)
+{
+  for (size_t i = bitfield.findFirst(); i < m_state.size(); i = bitfield.findFirst(i + 1))
+    incrementAvailability(i);
+}
+
+void
+PiecePicker::removePeer(const Bitset& bitfield)
+{
+  for (size_t i = bitfield.findFirst(); i < m_state.size(); i = bitfield.findFirst(i + 1))
+    decrementAvailability(i);
+}
+
+int
+PiecePicker::pick(const PieceFilter& peerHas)
+{
+  if (m_order.empty())
+    return -1;
+
+  // pieces nobody has are in bucket 0 and skipped
+  size_t begin = m_bucketEnd[0];
+  size_t end = m_order.size();
+  if (begin == end)
+    return -1;
+
+  size_t found = end;
+  if (m_numHave < RANDOM_FIRST_PIECES) {
+    size_t start = std::uniform_int_distribution<size_t>(begin, end - 1)(m_random);
+    for (size_t i = 0; i < end - begin && found == end; ++i) {
+      size_t position = begin + (start - begin + i) % (end - begin);
+      if (peerHas(m_order[position]))
+        found = position;
+    }
+  }
+  else {
+    for (size_t position = begin; position < end && found == end; ++position)
+      if (peerHas(m_order[position]))
+        found = position;
+  }
+
+  if (found == end)
+    return -1;
+
+  uint32_t index = m_order[found];
+  remove(index);
+  m_state[index] = PIECE_DOWNLOADING;
+  return index;
+}
+
+void
+PiecePicker::abortPiece(uint32_t index)
+{
+  if (m_state[index] != PIECE_DOWNLOADING)
+    return;
+
+  m_state[index] = PIECE_WANTED;
+  insert(index);
+}
+
+} // namespace sbt
@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_DOWNLOAD_PIECE_PICKER_HPP
+#define SBT_DOWNLOAD_PIECE_PICKER_HPP
+
+#include "../common.hpp"
+#include "../util/bitset.hpp"
+
+#include <random>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Decides which piece to download next from a peer
+ *
+ * The picker counts how many connected peers have each piece.  The pieces still wanted
+ * (neither had nor being downloaded) are kept in one array ordered by that count, as
+ * consecutive buckets of equal availability; moving a piece to the neighbouring
+ * bucket when a peer announces or loses it is a single swap.  Picking scans the array
+ * from the rarest bucket and takes the first piece the peer has, so the rarest pieces
+ * spread first.  Pieces of equal availability are in random order, so different
+ * clients (and different peers) do not all chase the same piece.
+ *
+ * Until RANDOM_FIRST_PIECES pieces are complete, a random piece is picked instead: the
+ * rarest pieces are slow to complete and the client has nothing to upload until the
+ * first one is.  Once every missing piece is being downloaded, the picker is in
+ * endgame: the caller may request the remaining blocks from several peers at once.
+ */
+class PiecePicker
+{
+public:
+  static const uint32_t RANDOM_FIRST_PIECES;
+
+  typedef function<bool(uint32_t index)> PieceFilter;
+
+public:
+  PiecePicker();
+
+  /**
+   * @brief Start over with @p numPieces wanted pieces that no peer has
+   */
+  void
+  init(uint32_t numPieces);
+
+  uint32_t
+  getNumPieces() const
+  {
+    return m_state.size();
+  }
+
+  /**
+   * @brief Mark piece @p index as complete, it is never picked again
+   */
+  void
+  setHave(uint32_t index);
+
+  bool
+  hasPiece(uint32_t index) const
+  {
+    return m_state[index] == PIECE_HAVE;
+  }
+
+  uint32_t
+  getNumHave() const
+  {
+    return m_numHave;
+  }
+
+  /**
+   * @brief Whether every missing piece is being downloaded
+   */
+  bool
+  isEndgame() const
+  {
+    return m_order.empty() && m_numHave < m_state.size();
+  }
+
+  uint32_t
+  getAvailability(uint32_t index) const
+  {
+    return m_availability[index];
+  }
+
+  /**
+   * @brief A peer announced piece @p index
+   */
+  void
+  incrementAvailability(uint32_t index);
+
+  /**
+   * @brief A peer that had piece @p index went away
+   */
+  void
+  decrementAvailability(uint32_t index);
+
+  /**
+   * @brief Account every piece of a peer's bitfield
+   */
+  void
+  addPeer(const Bitset& bitfield);
+
+  void
+  removePeer(const Bitset& bitfield);
+
+  /**
+   * @brief Pick a wanted piece for which @p peerHas holds and mark it as being downloaded
+   * @return the piece index, or -1 if the peer has nothing we want
+   */
+  int
+  pick(const PieceFilter& peerHas);
+
+  /**
+   * @brief Make a piece being downloaded wanted again, e.g. after it failed the hash check
+   */
+  void
+  abortPiece(uint32_t index);
+
+private:
+  enum PieceState : uint8_t {
+    PIECE_WANTED,
+    PIECE_DOWNLOADING,
+    PIECE_HAVE
+  };
+
+  void
+  swapPositions(size_t a, size_t b);
+
+  /**
+   * @brief Insert wanted piece @p index into its availability bucket
+   */
+  void
+  insert(uint32_t index);
+
+  /**
+   * @brief Take piece @p index out of m_order
+   */
+  void
+  remove(uint32_t index);
+
+private:
+  std::vector<uint8_t> m_state;
+  std::vector<uint32_t> m_availability;
+  uint32_t m_numHave;
+
+  // wanted pieces by ascending availability; bucket a spans
+  // [m_bucketEnd[a - 1], m_bucketEnd[a]), bucket 0 starts at 0
+  std::vector<uint32_t> m_order;
+  std::vector<size_t> m_position; // of each wanted piece in m_order
+  std::vector<size_t> m_bucketEnd;
+
+  std::mt19937 m_random;
+};
+
+} // namespace sbt
+
+#endif // SBT_DOWNLOAD_PIECE_PICKER_HPP
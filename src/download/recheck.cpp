@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "recheck.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+// pieces read ahead of the workers when they are copied out of the files rather than
+// hashed in a mapping; a full window of batches could otherwise take gigabytes
+static const size_t MAX_READ_AHEAD = 256 * 1024 * 1024;
+
+Recheck::Recheck(Storage& storage, HashPool& pool, const util::DigestTable& digests)
+  : m_storage(storage)
+  , m_pool(pool)
+  , m_digests(digests)
+  , m_next(0)
+  , m_numInFlight(0)
+  // a full batch being hashed by every worker and one more waiting for each of them
+  , m_maxInFlight(pool.getNumThreads() * (pool.getBatchWidth() + 1))
+  , m_numChecked(0)
+{
+}
+
+void
+Recheck::start(const Bitset& candidates, const Callback& onDone)
+{
+  m_candidates = candidates;
+  m_valid = Bitset(candidates.size());
+  m_onDone = onDone;
+  m_next = m_candidates.findFirst();
+  m_numInFlight = 0;
+  m_numChecked = 0;
+
+  if (!m_storage.isMapped() && m_storage.getPieceLength() > 0)
+    m_maxInFlight = std::min<size_t>(m_maxInFlight,
+                                     std::max<size_t>(m_pool.getNumThreads() * 2,
+                                                      MAX_READ_AHEAD /
+                                                        m_storage.getPieceLength()));
+
+  m_storage.advise(Storage::ACCESS_SEQUENTIAL);
+  fillWindow();
+}
+
+void
+Recheck::fillWindow()
+{
+  using namespace std::placeholders;
+
+  while (m_numInFlight < m_maxInFlight && m_next != Bitset::npos) {
+    uint32_t index = m_next;
+    m_next = m_candidates.findFirst(m_next + 1);
+
+    int64_t offset = m_storage.getOffset(index, 0);
+    size_t length = std::min<int64_t>(m_storage.getPieceLength(), m_storage.getLength() - offset);
+
+    BufferView piece = m_storage.getMappedBlock(index, 0, length);
+    ConstBufferPtr holder;
+    if (piece.empty()) {
+      holder = m_storage.readBlock(index, 0, length);
+      piece = *holder;
+    }
+
+    ++m_numInFlight;
+    m_pool.submit(index, piece, holder, m_digests[index],
+                  bind(&Recheck::handleHashed, this, _1, _2));
+  }
+
+  if (m_numInFlight == 0) {
+    m_storage.advise(Storage::ACCESS_RANDOM);
+    m_onDone(m_valid);
+  }
+}
+
+void
+Recheck::handleHashed(uint32_t index, bool isValid)
+{
+  --m_numInFlight;
+  ++m_numChecked;
+  if (isValid)
+    m_valid.set(index);
+
+  fillWindow();
+}
+
+} // namespace sbt
@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_DOWNLOAD_RECHECK_HPP
+#define SBT_DOWNLOAD_RECHECK_HPP
+
+#include "../common.hpp"
+#include "../storage/storage.hpp"
+#include "../util/bitset.hpp"
+#include "../util/hash.hpp"
+#include "hash-pool.hpp"
+
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Finds out which pieces of an existing payload are valid by hashing them
+ *
+ * Pieces are read in payload order, so the kernel's readahead streams the files from
+ * disk, and handed to the hash workers as they are read; a bounded window of pieces is
+ * in flight at any time, enough to give every worker full batches of pieces to hash side
+ * by side without holding the whole payload in memory.  Mapped storage is hashed in
+ * place.
+ *
+ * Results arrive through the reactor, so the reactor must run until the done callback
+ * has been called; the Recheck must stay alive until then.
+ */
+class Recheck
+{
+public:
+  /**
+   * @brief Receives the pieces that passed the check
+   */
+  typedef function<void(const Bitset& pieces)> Callback;
+
+public:
+  /**
+   * @param digests SHA-1 digest of every piece
+   */
+  Recheck(Storage& storage, HashPool& pool, const util::DigestTable& digests);
+
+  Recheck(const Recheck&) = delete;
+
+  Recheck&
+  operator=(const Recheck&) = delete;
+
+  /**
+   * @brief Check the pieces in @p candidates, then call @p onDone
+   */
+  void
+  start(const Bitset& candidates, const Callback& onDone);
+
+  size_t
+  getNumChecked() const
+  {
+    return m_numChecked;
+  }
+
+private:
+  /**
+   * @brief Read and submit pieces until the window is full
+   */
+  void
+  fillWindow();
+
+  void
+  handleHashed(uint32_t index, bool isValid);
+
+private:
+  Storage& m_storage;
+  HashPool& m_pool;
+  util::DigestTable m_digests;
+
+  Bitset m_candidates;
+  Bitset m_valid;
+  Callback m_onDone;
+
+  size_t m_next; // next candidate to read
+  size_t m_numInFlight;
+  size_t m_maxInFlight;
+  size_t m_numChecked;
+};
+
+} // namespace sbt
+
+#endif // SBT_DOWNLOAD_RECHECK_HPP
@@ -153,7 +153,7 @@ HttpHeaders::modifyHeader(const std::string& key, const std::string& value)
 }
 
 std::string
-HttpHeaders::findHeader(const std::string& key)
+HttpHeaders::findHeader(const std::string& key) const
 {
   auto item = std::find(m_headers.begin(), m_headers.end(), key);
   if (item != m_headers.end())
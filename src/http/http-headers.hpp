@@ -26,6 +26,7 @@
 #include "../common.hpp"
 #include <string>
 #include <list>
+#include <strings.h>
 
 namespace sbt {
 
@@ -103,7 +104,7 @@ public:
    * If header doesn't exist, it the method will return a blank line
    */
   std::string
-  findHeader(const std::string& key);
+  findHeader(const std::string& key) const;
 
 private:
   struct HttpHeader
@@ -117,7 +118,8 @@ private:
     bool
     operator==(const std::string& key) const
     {
-      return key == m_key;
+      // field names are case-insensitive
+      return strcasecmp(key.c_str(), m_key.c_str()) == 0;
     }
 
     std::string m_key;
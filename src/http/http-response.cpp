@@ -8,7 +8,9 @@
 #include "http-response.hpp"
 
 #include <string> // C++ STL string
+#include <limits>
 #include <string.h> // helpers to copy C-style strings
+#include <ctype.h>
 
 #include "compat.hpp"
 
@@ -24,6 +26,7 @@ using std::string;
 #endif // _DEBUG
 
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
 
 namespace sbt {
 
@@ -143,4 +146,98 @@ HttpResponse::setStatusMsg(const std::string& msg)
   m_statusMsg = msg;
 }
 
+bool
+HttpResponse::isKeepAlive() const
+{
+  std::string connection = boost::algorithm::to_lower_copy(findHeader("Connection"));
+  if (m_version == "1.0")
+    return connection.find("keep-alive") != string::npos;
+  return connection.find("close") == string::npos;
+}
+
+bool
+HttpResponse::isChunked() const
+{
+  std::string encoding = boost::algorithm::to_lower_copy(findHeader("Transfer-Encoding"));
+  return encoding.find("chunked") != string::npos;
+}
+
+// longest chunk header or trailer line accepted
+static const size_t MAX_CHUNK_LINE = 4096;
+
+ChunkedDecoder::ChunkedDecoder()
+{
+  reset();
+}
+
+void
+ChunkedDecoder::reset()
+{
+  m_state = STATE_SIZE;
+  m_remaining = 0;
+}
+
+size_t
+ChunkedDecoder::decode(const uint8_t* input, size_t size, Buffer& body)
+{
+  size_t pos = 0;
+
+  while (pos < size && m_state != STATE_DONE) {
+    if (m_state == STATE_DATA) {
+      size_t length = std::min(m_remaining, size - pos);
+      body.insert(body.end(), input + pos, input + pos + length);
+      pos += length;
+      m_remaining -= length;
+      if (m_remaining == 0)
+        m_state = STATE_DATA_END;
+      continue;
+    }
+
+    if (m_state == STATE_DATA_END) {
+      if (size - pos < 2)
+        break;
+      if (input[pos] != '\r' || input[pos + 1] != '\n')
+        throw ParseError("Chunk data doesn't end with \\r\\n");
+      pos += 2;
+      m_state = STATE_SIZE;
+      continue;
+    }
+
+    // STATE_SIZE and STATE_TRAILER consume whole lines
+    const uint8_t* endline = static_cast<const uint8_t*>(memmem(input + pos, size - pos, "\r\n", 2));
+    if (endline == nullptr) {
+      if (size - pos > MAX_CHUNK_LINE)
+        throw ParseError("Chunk header is too long");
+      break;
+    }
+
+    const uint8_t* line = input + pos;
+    size_t lineLength = endline - line;
+    pos += lineLength + 2;
+
+    if (m_state == STATE_TRAILER) {
+      if (lineLength == 0)
+        m_state = STATE_DONE;
+      continue;
+    }
+
+    // chunk size in hex, possibly followed by extensions
+    size_t chunkSize = 0;
+    size_t nDigits = 0;
+    for (; nDigits < lineLength && isxdigit(line[nDigits]); ++nDigits) {
+      if (chunkSize > (std::numeric_limits<size_t>::max() >> 4))
+        throw ParseError("Chunk size is too large");
+      int digit = isdigit(line[nDigits]) ? line[nDigits] - '0' : (tolower(line[nDigits]) - 'a' + 10);
+      chunkSize = (chunkSize << 4) | digit;
+    }
+    if (nDigits == 0)
+      throw ParseError("Chunk header without size");
+
+    m_remaining = chunkSize;
+    m_state = chunkSize == 0 ? STATE_TRAILER : STATE_DATA;
+  }
+
+  return pos;
+}
+
 } // namespace sbt
@@ -24,6 +24,7 @@
 #define SBT_HTTP_RESPONSE_HPP
 
 #include "http-headers.hpp"
+#include "../util/buffer.hpp"
 
 namespace sbt {
 /**
@@ -111,12 +112,71 @@ public:
   void
   setStatusMsg(const std::string& msg);
 
+  /**
+   * @brief Check whether the connection stays open after this response
+   *
+   * HTTP/1.1 connections persist unless the server says "Connection: close", HTTP/1.0
+   * ones only with "Connection: keep-alive".
+   */
+  bool
+  isKeepAlive() const;
+
+  /**
+   * @brief Check whether the body is sent in chunked transfer coding
+   */
+  bool
+  isChunked() const;
+
 private:
   std::string m_version;
   std::string m_statusCode;
   std::string m_statusMsg;
 };
 
+/**
+ * @brief Incremental decoder of the chunked transfer coding
+ *
+ * The body can be fed in whatever pieces it arrives in; a chunk header cut off at the
+ * end of the input is left unconsumed until the rest of it is there.
+ */
+class ChunkedDecoder
+{
+public:
+  ChunkedDecoder();
+
+  /**
+   * @brief Decode as much of @p input as possible, appending the chunk data to @p body
+   * @return number of bytes consumed
+   * @throw ParseError if the coding is malformed
+   */
+  size_t
+  decode(const uint8_t* input, size_t size, Buffer& body);
+
+  /**
+   * @brief Check whether the last chunk and the trailer have been decoded
+   */
+  bool
+  isComplete() const
+  {
+    return m_state == STATE_DONE;
+  }
+
+  void
+  reset();
+
+private:
+  enum State {
+    STATE_SIZE,
+    STATE_DATA,
+    STATE_DATA_END,
+    STATE_TRAILER,
+    STATE_DONE
+  };
+
+  State m_state;
+  size_t m_remaining;  // bytes left in the current chunk
+};
+
 } // namespace sbt
 
 #endif // SBT_HTTP_RESPONSE_HPP
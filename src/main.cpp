@@ -27,14 +27,15 @@ main(int argc, char** argv)
   try
   {
     // Check command line arguments.
-    if (argc != 3)
+    if (argc != 3 && !(argc == 4 && std::string(argv[3]) == "--mmap"))
     {
-      std::cerr << "Usage: simple-bt <port> <torrent_file>\n";
+      std::cerr << "Usage: simple-bt <port> <torrent_file> [--mmap]\n";
       return 1;
     }
 
     // Initialise the client.
-    sbt::Client client(argv[1], argv[2]);
+    sbt::Client client(argv[1], argv[2],
+                       argc == 4 ? sbt::Storage::MODE_MMAP : sbt::Storage::MODE_PREAD);
   }
   catch (std::exception& e)
   {
@@ -23,6 +23,9 @@
 #include "util/buffer-stream.hpp"
 #include "util/hash.hpp"
 
+#include <iterator>
+#include <sstream>
+
 using std::string;
 using std::make_shared;
 using std::dynamic_pointer_cast;
@@ -30,6 +33,7 @@ using std::dynamic_pointer_cast;
 namespace sbt {
 
 const std::string MetaInfo::ANNOUNCE("announce");
+const std::string MetaInfo::ANNOUNCE_LIST("announce-list");
 const std::string MetaInfo::INFO("info");
 const std::string MetaInfo::NAME("name");
 const std::string MetaInfo::PIECE_LENGTH("piece length");
@@ -58,19 +62,26 @@ MetaInfo::File::encode() const
 void
 MetaInfo::File::decode(const bencoding::Dictionary& dict)
 {
-  auto l = dict.get(LENGTH);
+  OBufferStream os;
+  dict.wireEncode(os);
+  bencoding::Document document(os.buf());
+  decode(document.getRoot());
+}
 
-  if (static_cast<bool>(l))
-    length = dynamic_pointer_cast<bencoding::Integer>(l)->getValue();
+void
+MetaInfo::File::decode(const bencoding::Value& dict)
+{
+  auto l = dict.get(LENGTH, bencoding::TYPE_INTEGER);
+
+  if (l != nullptr)
+    length = l->getInteger();
   else
     throw Error("No length in files");
 
-  auto p = dict.get(PATH);
-  if (static_cast<bool>(p)) {
-    auto list = dynamic_pointer_cast<bencoding::List>(p)->getList();
-
-    for (const auto& i : list) {
-      path.push_back(dynamic_pointer_cast<bencoding::String>(i)->toString());
+  auto p = dict.get(PATH, bencoding::TYPE_LIST);
+  if (p != nullptr) {
+    for (const auto& i : p->getList()) {
+      path.push_back(i.toString());
     }
   }
   else
@@ -79,6 +90,7 @@ MetaInfo::File::decode(const bencoding::Dictionary& dict)
 
 MetaInfo::MetaInfo()
   : m_info(new bencoding::Dictionary)
+  , m_hasRoot(true)
 {
   m_root.insert(INFO, m_info);
 }
@@ -86,55 +98,148 @@ MetaInfo::MetaInfo()
 void
 MetaInfo::wireEncode(std::ostream& os) const
 {
-  m_root.wireEncode(os);
+  BufferView wire = getDocumentRoot().getWire();
+  os.write(reinterpret_cast<const char*>(wire.buf()), wire.size());
 }
 
 void
 MetaInfo::wireDecode(std::istream& is)
 {
-  m_root = bencoding::Dictionary();
-  m_root.wireDecode(is);
+  auto input = make_shared<Buffer>(std::istreambuf_iterator<char>(is),
+                                   std::istreambuf_iterator<char>());
+  auto document = make_shared<bencoding::Document>(input);
 
-  if (static_cast<bool>(m_root.get(INFO))) {
-    m_info = dynamic_pointer_cast<bencoding::Dictionary>(m_root.get(INFO));
-  }
-  else {
-    m_root = bencoding::Dictionary();
+  if (document->getRoot().get(INFO, bencoding::TYPE_DICTIONARY) == nullptr)
     throw bencoding::Error("no info in meta-info");
+
+  // hashed once, over the bytes of the file rather than a re-encoding, which would
+  // differ if the file is not canonical
+  m_hash = util::sha1(document->getRoot().get(INFO)->getWire());
+  m_document = document;
+  m_root = bencoding::Dictionary();
+  m_info.reset();
+  m_hasRoot = false;
+}
+
+const bencoding::Dictionary&
+MetaInfo::getRoot() const
+{
+  buildRoot();
+  return m_root;
+}
+
+const bencoding::Value&
+MetaInfo::getDocumentRoot() const
+{
+  if (!static_cast<bool>(m_document)) {
+    OBufferStream os;
+    m_root.wireEncode(os);
+    m_document = make_shared<bencoding::Document>(os.buf());
   }
+
+  return m_document->getRoot();
+}
+
+const bencoding::Value&
+MetaInfo::getInfo() const
+{
+  return *getDocumentRoot().get(INFO);
+}
+
+void
+MetaInfo::buildRoot() const
+{
+  if (m_hasRoot)
+    return;
+
+  BufferView wire = m_document->getRoot().getWire();
+  std::istringstream is(std::string(wire.begin(), wire.end()));
+  m_root.wireDecode(is);
+  m_info = dynamic_pointer_cast<bencoding::Dictionary>(m_root.get(INFO));
+  m_hasRoot = true;
+}
+
+void
+MetaInfo::prepareEdit()
+{
+  buildRoot();
+
+  m_document.reset();
+  m_hash.reset();
 }
 
 void
 MetaInfo::setAnnounce(const std::string& announce)
 {
+  prepareEdit();
   m_root.insert(ANNOUNCE, make_shared<bencoding::String>(announce));
 }
 
 std::string
 MetaInfo::getAnnounce()
 {
-  auto i = m_root.get(ANNOUNCE);
+  auto i = getDocumentRoot().get(ANNOUNCE, bencoding::TYPE_STRING);
 
-  if (static_cast<bool>(i)) {
-    return dynamic_pointer_cast<bencoding::String>(i)->toString();
+  if (i != nullptr) {
+    return i->toString();
   }
   else
     return string();
 }
 
+void
+MetaInfo::setAnnounceList(const std::vector<std::vector<std::string>>& tiers)
+{
+  prepareEdit();
+
+  auto list = make_shared<bencoding::List>();
+  for (const auto& tier : tiers) {
+    auto urls = make_shared<bencoding::List>();
+    for (const auto& url : tier)
+      urls->append(make_shared<bencoding::String>(url));
+    list->append(urls);
+  }
+  m_root.insert(ANNOUNCE_LIST, list);
+}
+
+std::vector<std::vector<std::string>>
+MetaInfo::getAnnounceList()
+{
+  std::vector<std::vector<std::string>> tiers;
+  auto list = getDocumentRoot().get(ANNOUNCE_LIST, bencoding::TYPE_LIST);
+
+  if (list != nullptr) {
+    for (const auto& tier : list->getList()) {
+      if (!tier.isList())
+        continue;
+
+      std::vector<std::string> urls;
+      for (const auto& url : tier.getList()) {
+        if (url.isString())
+          urls.push_back(url.toString());
+      }
+      if (!urls.empty())
+        tiers.push_back(urls);
+    }
+  }
+
+  return tiers;
+}
+
 void
 MetaInfo::setName(const std::string& name)
 {
+  prepareEdit();
   m_info->insert(NAME, make_shared<bencoding::String>(name));
 }
 
 std::string
 MetaInfo::getName()
 {
-  auto i = m_info->get(NAME);
+  auto i = getInfo().get(NAME, bencoding::TYPE_STRING);
 
-  if (static_cast<bool>(i)) {
-    return dynamic_pointer_cast<bencoding::String>(i)->toString();
+  if (i != nullptr) {
+    return i->toString();
   }
   else
     return string();
@@ -143,16 +248,17 @@ MetaInfo::getName()
 void
 MetaInfo::setPieceLength(int64_t length)
 {
+  prepareEdit();
   m_info->insert(PIECE_LENGTH, make_shared<bencoding::Integer>(length));
 }
 
 int64_t
 MetaInfo::getPieceLength()
 {
-  auto i = m_info->get(PIECE_LENGTH);
+  auto i = getInfo().get(PIECE_LENGTH, bencoding::TYPE_INTEGER);
 
-  if (static_cast<bool>(i)) {
-    return dynamic_pointer_cast<bencoding::Integer>(i)->getValue();
+  if (i != nullptr) {
+    return i->getInteger();
   }
   else
     return -1;
@@ -161,23 +267,35 @@ MetaInfo::getPieceLength()
 void
 MetaInfo::setPieces(const std::vector<uint8_t> pieces)
 {
+  prepareEdit();
   m_info->insert(PIECES, make_shared<bencoding::String>(&pieces.front(), pieces.size()));
 }
 
 std::vector<uint8_t>
 MetaInfo::getPieces()
 {
-  auto i = m_info->get(PIECES);
+  auto i = getInfo().get(PIECES, bencoding::TYPE_STRING);
 
-  if (static_cast<bool>(i))
-    return dynamic_pointer_cast<bencoding::String>(i)->getValue();
+  if (i != nullptr)
+    return std::vector<uint8_t>(i->getString().begin(), i->getString().end());
   else
     return std::vector<uint8_t>();
 }
 
+util::DigestTable
+MetaInfo::getPieceHashes() const
+{
+  auto i = getInfo().get(PIECES, bencoding::TYPE_STRING);
+  if (i == nullptr || i->size() % util::Sha1::DIGEST_LENGTH != 0)
+    throw bencoding::Error("Missing or malformed pieces in meta-info");
+
+  return util::DigestTable(i->getString(), m_document);
+}
+
 void
 MetaInfo::setLength(int64_t length)
 {
+  prepareEdit();
   m_info->erase(FILES);
 
   m_info->insert(LENGTH, make_shared<bencoding::Integer>(length));
@@ -186,10 +304,10 @@ MetaInfo::setLength(int64_t length)
 int64_t
 MetaInfo::getLength()
 {
-  auto i = m_info->get(LENGTH);
+  auto i = getInfo().get(LENGTH, bencoding::TYPE_INTEGER);
 
-  if (static_cast<bool>(i))
-    return dynamic_pointer_cast<bencoding::Integer>(i)->getValue();
+  if (i != nullptr)
+    return i->getInteger();
   else
     return -1;
 }
@@ -197,6 +315,7 @@ MetaInfo::getLength()
 void
 MetaInfo::addFile(const MetaInfo::File file)
 {
+  prepareEdit();
   m_info->erase(LENGTH);
 
   auto i = m_info->get(FILES);
@@ -213,13 +332,12 @@ std::vector<MetaInfo::File>
 MetaInfo::getFiles()
 {
   std::vector<MetaInfo::File> result;
-  auto f = m_info->get(FILES);
+  auto f = getInfo().get(FILES, bencoding::TYPE_LIST);
 
-  if (static_cast<bool>(f)) {
-    auto list = dynamic_pointer_cast<bencoding::List>(f)->getList();
-    for (const auto& i : list) {
+  if (f != nullptr) {
+    for (const auto& i : f->getList()) {
       MetaInfo::File file;
-      file.decode(*dynamic_pointer_cast<bencoding::Dictionary>(i));
+      file.decode(i);
       result.push_back(file);
     }
   }
@@ -227,14 +345,18 @@ MetaInfo::getFiles()
   return result;
 }
 
-ConstBufferPtr
-MetaInfo::getHash()
+BufferView
+MetaInfo::getInfoWire() const
 {
-  OBufferStream os;
-
-  m_info->wireEncode(os);
+  return getInfo().getWire();
+}
 
-  return util::sha1(os.buf());
+ConstBufferPtr
+MetaInfo::getHash() const
+{
+  if (!static_cast<bool>(m_hash))
+    m_hash = util::sha1(getInfoWire());
+  return m_hash;
 }
 
 } // namespace sbt
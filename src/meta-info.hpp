@@ -23,6 +23,8 @@
 #define SBT_META_INFO_HPP
 
 #include "util/bencoding.hpp"
+#include "util/bencoding-document.hpp"
+#include "util/hash.hpp"
 
 namespace sbt {
 
@@ -48,6 +50,9 @@ public:
     void
     decode(const bencoding::Dictionary& dict);
 
+    void
+    decode(const bencoding::Value& dict);
+
   public:
     int64_t length;
     std::vector<std::string> path;
@@ -68,6 +73,20 @@ public:
   std::string
   getAnnounce();
 
+  /**
+   * @brief Set the tiers of tracker URLs (BEP 12), most preferred tier first
+   */
+  void
+  setAnnounceList(const std::vector<std::vector<std::string>>& tiers);
+
+  /**
+   * @brief The tiers of tracker URLs, empty if the meta-info has no announce-list
+   *
+   * Entries that are not strings and tiers without any URL are skipped.
+   */
+  std::vector<std::vector<std::string>>
+  getAnnounceList();
+
   void
   setName(const std::string& name);
 
@@ -86,6 +105,15 @@ public:
   std::vector<uint8_t>
   getPieces();
 
+  /**
+   * @brief The digest of every piece, a view into the decoded pieces string
+   *
+   * The table keeps the parsed meta-info alive, even across later edits.
+   * @throw bencoding::Error the pieces string is missing or not made of whole digests
+   */
+  util::DigestTable
+  getPieceHashes() const;
+
   void
   setLength(int64_t length);
 
@@ -98,17 +126,34 @@ public:
   std::vector<MetaInfo::File>
   getFiles();
 
+  /**
+   * @brief The whole meta-info as an editable tree, built on first use after decoding
+   */
   const bencoding::Dictionary&
-  getRoot() const
-  {
-    return m_root;
-  }
-
+  getRoot() const;
+
+  /**
+   * @brief The whole meta-info as a parsed document, as decoded or as built with the
+   *        setters
+   */
+  const bencoding::Value&
+  getDocumentRoot() const;
+
+  /**
+   * @brief The info dictionary exactly as it was encoded; the info-hash covers these bytes
+   */
+  BufferView
+  getInfoWire() const;
+
+  /**
+   * @brief SHA-1 of the info dictionary, computed once and cached until the next edit
+   */
   ConstBufferPtr
-  getHash();
+  getHash() const;
 
 private:
   static const std::string ANNOUNCE;
+  static const std::string ANNOUNCE_LIST;
   static const std::string INFO;
   static const std::string NAME;
   static const std::string PIECE_LENGTH;
@@ -117,9 +162,32 @@ private:
   static const std::string FILES;
   static const std::string PATH;
 
+  /**
+   * @brief The info dictionary; a decoded meta-info always has one
+   */
+  const bencoding::Value&
+  getInfo() const;
 
-  bencoding::Dictionary m_root;
-  std::shared_ptr<bencoding::Dictionary> m_info;
+  /**
+   * @brief Build m_root from the document, if it does not hold the meta-info yet
+   */
+  void
+  buildRoot() const;
+
+  /**
+   * @brief Make m_root hold the meta-info before a setter changes it
+   */
+  void
+  prepareEdit();
+
+  // Decoded meta-info is only read, straight from the parsed document; m_root, the
+  // editable tree, is built from it only if a setter or getRoot() is called afterwards.
+  // After edits, the document is rebuilt from m_root when it is next read.
+  mutable bencoding::Dictionary m_root;
+  mutable std::shared_ptr<bencoding::Dictionary> m_info;
+  mutable bool m_hasRoot;
+  mutable std::shared_ptr<const bencoding::Document> m_document;
+  mutable ConstBufferPtr m_hash;
 };
 
 } // namespace sbt
@@ -69,23 +69,48 @@ MsgBase::encode()
   return os.buf();
 }
 
+void
+MsgBase::encode(std::vector<struct iovec>& iov)
+{
+  m_encoded = encode();
+
+  struct iovec vec;
+  vec.iov_base = const_cast<uint8_t*>(m_encoded->buf());
+  vec.iov_len = m_encoded->size();
+  iov.push_back(vec);
+}
+
 void
 MsgBase::decode(ConstBufferPtr msg)
 {
-  size_t totalLength = decodeUint32(msg->get());
+  decode(BufferView(*msg));
+  m_wire = msg;
+}
+
+void
+MsgBase::decode(const BufferView& msg)
+{
+  if (msg.size() < 4)
+    throw Error("Truncated message length");
+
+  size_t totalLength = decodeUint32(msg.get());
+
+  m_wire = nullptr;
+  m_payload = nullptr;
+  m_payloadView = BufferView();
 
   if (totalLength == 0) {
     m_id = MSG_ID_KEEP_ALIVE;
-    m_payload = nullptr;
     return;
   }
 
-  m_id = (*msg)[ID_OFFSET];
+  if (msg.size() < ID_OFFSET + totalLength)
+    throw Error("Truncated message");
+
+  m_id = msg[ID_OFFSET];
 
   if (totalLength > 1)
-    m_payload = make_shared<Buffer>(msg->get() + PAYLOAD_OFFSET,  totalLength - 1);
-  else
-    m_payload = nullptr;
+    m_payloadView = msg.slice(PAYLOAD_OFFSET, totalLength - 1);
 
   decodePayload();
 }
@@ -104,6 +129,13 @@ MsgBase::encodeUint32(std::ostream& os, uint32_t value)
   os.write(reinterpret_cast<const char*>(&tmpValue), 4);
 }
 
+void
+MsgBase::encodeUint32(uint8_t* buf, uint32_t value)
+{
+  uint32_t tmpValue = htonl(value);
+  memcpy(buf, &tmpValue, 4);
+}
+
 KeepAlive::KeepAlive()
   : MsgBase(MSG_ID_KEEP_ALIVE)
 {
@@ -153,10 +185,10 @@ Have::encodePayload()
 void
 Have::decodePayload()
 {
-  if (getPayload()->size() != 4)
+  if (getPayloadView().size() != 4)
     throw Error("Wrong have payload!");
 
-  m_index = decodeUint32(getPayload()->get());
+  m_index = decodeUint32(getPayloadView().get());
 }
 
 
@@ -188,10 +220,10 @@ Request::encodePayload()
 void
 Request::decodePayload()
 {
-  if (getPayload()->size() != 12)
+  if (getPayloadView().size() != 12)
     throw Error("Wrong request payload!");
 
-  const uint8_t* payload = getPayload()->get();
+  const uint8_t* payload = getPayloadView().get();
   m_index = decodeUint32(payload);
   m_begin = decodeUint32(payload + 4);
   m_length = decodeUint32(payload + 8);
@@ -205,9 +237,12 @@ Bitfield::Bitfield()
 Bitfield::Bitfield(ConstBufferPtr bitfield)
   : MsgBase(MSG_ID_BITFIELD)
   , m_bitfield(bitfield)
+  , m_bitfieldView(static_cast<bool>(bitfield) ? BufferView(*bitfield) : BufferView())
 {
 }
 
+const size_t Piece::HEADER_LENGTH = 13;
+
 Piece::Piece()
   : MsgBase(MSG_ID_PIECE)
 {
@@ -219,31 +254,67 @@ Piece::Piece(uint32_t index, uint32_t begin, ConstBufferPtr block)
   , m_begin(begin)
   , m_block(block)
 {
+  if (static_cast<bool>(block))
+    m_blockView = BufferView(*block);
+}
+
+ConstBufferPtr
+Piece::encodeHeader(uint32_t index, uint32_t begin, size_t blockLength)
+{
+  auto header = make_shared<Buffer>(HEADER_LENGTH);
+
+  encodeUint32(header->buf(), 9 + blockLength);
+  (*header)[ID_OFFSET] = MSG_ID_PIECE;
+  encodeUint32(header->buf() + 5, index);
+  encodeUint32(header->buf() + 9, begin);
+
+  return header;
+}
+
+void
+Piece::encode(std::vector<struct iovec>& iov)
+{
+  encodeUint32(m_header, 9 + m_blockView.size());
+  m_header[ID_OFFSET] = m_id;
+  encodeUint32(m_header + 5, m_index);
+  encodeUint32(m_header + 9, m_begin);
+
+  struct iovec vec;
+  vec.iov_base = m_header;
+  vec.iov_len = HEADER_LENGTH;
+  iov.push_back(vec);
+
+  if (!m_blockView.empty()) {
+    vec.iov_base = const_cast<uint8_t*>(m_blockView.buf());
+    vec.iov_len = m_blockView.size();
+    iov.push_back(vec);
+  }
 }
 
 void
 Piece::encodePayload()
 {
-  OBufferStream os;
+  auto payload = make_shared<Buffer>(8 + m_blockView.size());
 
-  encodeUint32(os, m_index);
-  encodeUint32(os, m_begin);
-  if (static_cast<bool>(m_block))
-    os.write(reinterpret_cast<const char*>(m_block->buf()), m_block->size());
+  encodeUint32(payload->buf(), m_index);
+  encodeUint32(payload->buf() + 4, m_begin);
+  if (!m_blockView.empty())
+    memcpy(payload->buf() + 8, m_blockView.buf(), m_blockView.size());
 
-  setPayload(os.buf());
+  setPayload(payload);
 }
 
 void
 Piece::decodePayload()
 {
-  if (getPayload()->size() < 8)
+  if (getPayloadView().size() < 8)
     throw Error("Wrong piece payload!");
 
-  const uint8_t* payload = getPayload()->get();
+  const uint8_t* payload = getPayloadView().get();
   m_index = decodeUint32(payload);
   m_begin = decodeUint32(payload + 4);
-  m_block = make_shared<Buffer>(payload + 8, getPayload()->size() - 8);
+  m_block = nullptr;
+  m_blockView = getPayloadView().slice(8);
 }
 
 Cancel::Cancel()
@@ -274,10 +345,10 @@ Cancel::encodePayload()
 void
 Cancel::decodePayload()
 {
-  if (getPayload()->size() != 12)
+  if (getPayloadView().size() != 12)
     throw Error("Wrong request payload!");
 
-  const uint8_t* payload = getPayload()->get();
+  const uint8_t* payload = getPayloadView().get();
   m_index = decodeUint32(payload);
   m_begin = decodeUint32(payload + 4);
   m_length = decodeUint32(payload + 8);
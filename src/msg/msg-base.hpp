@@ -23,6 +23,8 @@
 #define SBT_MSG_BASE_HPP
 
 #include "../util/buffer.hpp"
+#include <vector>
+#include <sys/uio.h>
 
 namespace sbt {
 namespace msg {
@@ -75,24 +77,65 @@ public:
     m_id = id;
   }
 
+  /**
+   * @brief Get the payload as a Buffer
+   *
+   * For a message decoded from a view, the payload is copied out of the view on the
+   * first call; use getPayloadView() to avoid that.
+   */
   ConstBufferPtr
   getPayload()
   {
+    if (!static_cast<bool>(m_payload) && !m_payloadView.empty())
+      m_payload = m_payloadView.copy();
     return m_payload;
   }
 
+  /**
+   * @brief Get the payload of a decoded message without copying it
+   */
+  const BufferView&
+  getPayloadView() const
+  {
+    return m_payloadView;
+  }
+
   void
   setPayload(ConstBufferPtr payload)
   {
     m_payload = payload;
+    m_payloadView = static_cast<bool>(payload) ? BufferView(*payload) : BufferView();
   }
 
   ConstBufferPtr
   encode();
 
+  /**
+   * @brief Encode the message as a gather list for writev()/sendmsg()
+   *
+   * Appends iovecs that together form exactly the bytes encode() would return.  The
+   * default implementation encodes into a buffer owned by the message; subclasses that
+   * carry bulk data reference it instead of copying.  The iovecs stay valid as long as
+   * the message (and its payload) is alive and not modified.
+   */
+  virtual void
+  encode(std::vector<struct iovec>& iov);
+
+  /**
+   * @brief Decode the message, keeping a reference to @p msg
+   */
   void
   decode(ConstBufferPtr msg);
 
+  /**
+   * @brief Decode the message in place
+   *
+   * No bytes are copied: the payload (and e.g. the block of a Piece) stay views into
+   * @p msg, which must outlive every use of them.
+   */
+  void
+  decode(const BufferView& msg);
+
 protected:
   virtual void
   encodePayload() = 0;
@@ -106,6 +149,9 @@ protected:
   static void
   encodeUint32(std::ostream& os, uint32_t value);
 
+  static void
+  encodeUint32(uint8_t* buf, uint32_t value);
+
 
 protected:
   static const size_t ID_OFFSET;
@@ -113,6 +159,9 @@ protected:
 
   uint8_t m_id;
   ConstBufferPtr m_payload;
+  BufferView m_payloadView;
+  ConstBufferPtr m_wire; // keeps the bytes behind the views alive after decode(ConstBufferPtr)
+  ConstBufferPtr m_encoded; // backs the iovec returned by the default encode(iov)
 };
 
 class KeepAlive : public MsgBase
@@ -234,31 +283,42 @@ public:
   Bitfield(ConstBufferPtr bitfield);
 
   ConstBufferPtr
-  getBitfield() const
+  getBitfield()
   {
+    if (!static_cast<bool>(m_bitfield) && !m_bitfieldView.empty())
+      m_bitfield = m_bitfieldView.copy();
     return m_bitfield;
   }
 
+  const BufferView&
+  getBitfieldView() const
+  {
+    return m_bitfieldView;
+  }
+
   void
   setBitfield(ConstBufferPtr bitfield)
   {
     m_bitfield = bitfield;
+    m_bitfieldView = static_cast<bool>(bitfield) ? BufferView(*bitfield) : BufferView();
   }
 
   virtual void
   encodePayload()
   {
-    setPayload(m_bitfield);
+    setPayload(getBitfield());
   }
 
   void
   decodePayload()
   {
-    m_bitfield = getPayload();
+    m_bitfield = nullptr;
+    m_bitfieldView = getPayloadView();
   }
 
 private:
   ConstBufferPtr m_bitfield;
+  BufferView m_bitfieldView;
 };
 
 class Request : public MsgBase
@@ -347,28 +407,67 @@ public:
     m_begin = begin;
   }
 
+  /**
+   * @brief Get the block as a Buffer
+   *
+   * For a piece decoded from a view, the block is copied out of the view on the first
+   * call; use getBlockView() to avoid that.
+   */
   ConstBufferPtr
-  getBlock() const
+  getBlock()
   {
+    if (!static_cast<bool>(m_block) && !m_blockView.empty())
+      m_block = m_blockView.copy();
     return m_block;
   }
 
+  const BufferView&
+  getBlockView() const
+  {
+    return m_blockView;
+  }
+
   void
   setBitfield(ConstBufferPtr block)
   {
     m_block = block;
+    m_blockView = static_cast<bool>(block) ? BufferView(*block) : BufferView();
   }
 
+  /**
+   * @brief Encode as two iovecs: the 13-byte header and the block itself
+   *
+   * The block is not copied, so a piece can be sent straight from the buffer it was
+   * read into.
+   */
+  virtual void
+  encode(std::vector<struct iovec>& iov);
+
+  using MsgBase::encode;
+
+  /**
+   * @brief Encode only the header of a piece message carrying @p blockLength bytes
+   *
+   * Used when the block is sent separately, e.g. straight from a file.
+   */
+  static ConstBufferPtr
+  encodeHeader(uint32_t index, uint32_t begin, size_t blockLength);
+
   virtual void
   encodePayload();
 
   virtual void
   decodePayload();
 
+public:
+  static const size_t HEADER_LENGTH; // length, id, index and begin
+
 private:
   uint32_t m_index;
   uint32_t m_begin;
+  uint8_t m_header[13];
   ConstBufferPtr m_block;
+  BufferView m_blockView;
 };
 
 class Cancel : public MsgBase
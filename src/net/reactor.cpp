@@ -0,0 +1,264 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "reactor.hpp"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace sbt {
+namespace net {
+
+const uint32_t Reactor::EVENT_READ = EPOLLIN;
+const uint32_t Reactor::EVENT_WRITE = EPOLLOUT;
+const uint32_t Reactor::EVENT_ERROR = EPOLLERR | EPOLLHUP | EPOLLRDHUP;
+
+static const size_t MAX_EVENTS_PER_WAIT = 256;
+
+static uint64_t
+makeEventData(int fd, uint32_t generation)
+{
+  return static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(fd);
+}
+
+Reactor::Handler::~Handler()
+{
+}
+
+Reactor::Reactor()
+  : m_epollFd(epoll_create1(EPOLL_CLOEXEC))
+  , m_isRunning(false)
+  , m_readyEvents(MAX_EVENTS_PER_WAIT)
+  , m_lastGeneration(0)
+  , m_lastTimerId(0)
+  , m_wakeupFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+  if (m_epollFd == -1)
+    throw Error(std::string("Cannot create epoll instance: ") + strerror(errno));
+  if (m_wakeupFd == -1) {
+    close(m_epollFd);
+    throw Error(std::string("Cannot create eventfd: ") + strerror(errno));
+  }
+
+  add(m_wakeupFd, EVENT_READ, [this] (uint32_t) { runPosted(); });
+}
+
+Reactor::~Reactor()
+{
+  close(m_wakeupFd);
+  close(m_epollFd);
+}
+
+void
+Reactor::add(int fd, uint32_t events, Handler* handler)
+{
+  add(fd, events, bind(&Handler::handleEvent, handler, std::placeholders::_1));
+}
+
+void
+Reactor::add(int fd, uint32_t events, const EventCallback& callback)
+{
+  uint32_t generation = ++m_lastGeneration;
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events | EPOLLET | EPOLLRDHUP;
+  ev.data.u64 = makeEventData(fd, generation);
+
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    throw Error(std::string("Cannot register fd: ") + strerror(errno));
+
+  Entry& entry = m_entries[fd];
+  entry.callback = callback;
+  entry.generation = generation;
+}
+
+void
+Reactor::modify(int fd, uint32_t events)
+{
+  auto it = m_entries.find(fd);
+  if (it == m_entries.end())
+    throw Error("Cannot modify fd: not registered");
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events | EPOLLET | EPOLLRDHUP;
+  ev.data.u64 = makeEventData(fd, it->second.generation);
+
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev) == -1)
+    throw Error(std::string("Cannot modify fd: ") + strerror(errno));
+}
+
+void
+Reactor::remove(int fd)
+{
+  auto it = m_entries.find(fd);
+  if (it == m_entries.end())
+    return;
+
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  m_entries.erase(it);
+}
+
+Reactor::TimerId
+Reactor::schedule(uint64_t delayMs, const TimerCallback& callback)
+{
+  TimerId id = ++m_lastTimerId;
+  auto it = m_timers.insert(std::make_pair(now() + delayMs, std::make_pair(id, callback)));
+  m_timerIndex[id] = it;
+  return id;
+}
+
+void
+Reactor::cancel(TimerId id)
+{
+  auto it = m_timerIndex.find(id);
+  if (it == m_timerIndex.end())
+    return;
+
+  m_timers.erase(it->second);
+  m_timerIndex.erase(it);
+}
+
+void
+Reactor::post(const Task& task)
+{
+  bool wasEmpty;
+  {
+    std::lock_guard<std::mutex> lock(m_postMutex);
+    wasEmpty = m_posted.empty();
+    m_posted.push_back(task);
+  }
+
+  // one wakeup per batch: the reactor takes the whole queue at once
+  if (wasEmpty) {
+    uint64_t one = 1;
+    while (write(m_wakeupFd, &one, sizeof(one)) == -1 && errno == EINTR)
+      ;
+  }
+}
+
+void
+Reactor::runPosted()
+{
+  // reset the counter first, so a task posted from now on triggers a new edge
+  uint64_t count;
+  while (read(m_wakeupFd, &count, sizeof(count)) > 0 || errno == EINTR)
+    ;
+
+  std::vector<Task> tasks;
+  {
+    std::lock_guard<std::mutex> lock(m_postMutex);
+    tasks.swap(m_posted);
+  }
+
+  for (const auto& task : tasks)
+    task();
+}
+
+void
+Reactor::runOnce(int maxWaitMs)
+{
+  int nReady = epoll_wait(m_epollFd, &m_readyEvents.front(), m_readyEvents.size(),
+                          getWaitTime(maxWaitMs));
+
+  if (nReady == -1) {
+    if (errno == EINTR)
+      return;
+    throw Error(std::string("epoll_wait failed: ") + strerror(errno));
+  }
+
+  for (int i = 0; i < nReady; i++) {
+    // look the entry up every time: an earlier handler in this batch may have removed
+    // it, or even closed the descriptor and registered a new one under the same number
+    uint64_t data = m_readyEvents[i].data.u64;
+    auto it = m_entries.find(static_cast<int>(data & 0xffffffff));
+    if (it == m_entries.end() || it->second.generation != data >> 32)
+      continue;
+
+    // copy, the handler is allowed to remove itself
+    EventCallback callback = it->second.callback;
+    callback(m_readyEvents[i].events);
+  }
+
+  fireTimers();
+}
+
+void
+Reactor::run()
+{
+  m_isRunning = true;
+  while (m_isRunning)
+    runOnce();
+}
+
+uint64_t
+Reactor::now()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void
+Reactor::setNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    throw Error(std::string("Cannot set O_NONBLOCK: ") + strerror(errno));
+}
+
+int
+Reactor::getWaitTime(int maxWaitMs) const
+{
+  if (m_timers.empty())
+    return maxWaitMs;
+
+  uint64_t current = now();
+  uint64_t deadline = m_timers.begin()->first;
+  int untilTimer = deadline > current ? static_cast<int>(deadline - current) : 0;
+
+  if (maxWaitMs < 0 || untilTimer < maxWaitMs)
+    return untilTimer;
+  else
+    return maxWaitMs;
+}
+
+void
+Reactor::fireTimers()
+{
+  uint64_t current = now();
+
+  while (!m_timers.empty() && m_timers.begin()->first <= current) {
+    auto it = m_timers.begin();
+    TimerCallback callback = it->second.second;
+    m_timerIndex.erase(it->second.first);
+    m_timers.erase(it);
+
+    callback();
+  }
+}
+
+} // namespace net
+} // namespace sbt
@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_NET_REACTOR_HPP
+#define SBT_NET_REACTOR_HPP
+
+#include "../common.hpp"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+
+namespace sbt {
+namespace net {
+
+/**
+ * @brief Edge-triggered epoll event loop
+ *
+ * Every socket the client owns (listen socket, peer sockets, tracker socket) is
+ * registered here together with the object that handles its readiness.  Each wakeup
+ * only touches the descriptors that are actually ready, so the cost of an iteration
+ * does not depend on the number of open connections.
+ *
+ * Descriptors are registered edge-triggered: a handler must consume input (or output
+ * space) until the call returns EAGAIN, otherwise it will not be notified again.
+ *
+ * The reactor is single-threaded; other threads hand work back to it with post().
+ */
+class Reactor
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief Per-descriptor event handler
+   */
+  class Handler
+  {
+  public:
+    virtual
+    ~Handler();
+
+    /**
+     * @brief Called when the descriptor becomes ready
+     * @param events mask of EVENT_* flags that fired
+     */
+    virtual void
+    handleEvent(uint32_t events) = 0;
+  };
+
+  typedef function<void(uint32_t events)> EventCallback;
+  typedef function<void()> TimerCallback;
+  typedef function<void()> Task;
+  typedef uint64_t TimerId;
+
+  static const uint32_t EVENT_READ;
+  static const uint32_t EVENT_WRITE;
+  static const uint32_t EVENT_ERROR;
+
+public:
+  Reactor();
+
+  ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+
+  Reactor&
+  operator=(const Reactor&) = delete;
+
+  /**
+   * @brief Register @p fd and dispatch its readiness to @p handler
+   *
+   * The reactor does not own the handler; it must stay alive until remove() is called.
+   */
+  void
+  add(int fd, uint32_t events, Handler* handler);
+
+  /**
+   * @brief Register @p fd and dispatch its readiness to @p callback
+   */
+  void
+  add(int fd, uint32_t events, const EventCallback& callback);
+
+  /**
+   * @brief Change the set of events @p fd is watched for
+   */
+  void
+  modify(int fd, uint32_t events);
+
+  /**
+   * @brief Stop watching @p fd
+   *
+   * Must be called before the descriptor is closed.  It is safe to call from inside
+   * the descriptor's own handler.
+   */
+  void
+  remove(int fd);
+
+  bool
+  isRegistered(int fd) const
+  {
+    return m_entries.count(fd) > 0;
+  }
+
+  /**
+   * @brief Run @p callback once, after @p delayMs milliseconds
+   */
+  TimerId
+  schedule(uint64_t delayMs, const TimerCallback& callback);
+
+  void
+  cancel(TimerId id);
+
+  /**
+   * @brief Run @p task on the reactor thread, soon
+   *
+   * The only method that may be called from other threads.  Tasks run in the order
+   * they were posted; tasks still pending when the reactor is destroyed never run.
+   */
+  void
+  post(const Task& task);
+
+  /**
+   * @brief Wait for ready descriptors or the next timer and dispatch them
+   * @param maxWaitMs upper bound of the wait, -1 to wait until something happens
+   */
+  void
+  runOnce(int maxWaitMs = -1);
+
+  /**
+   * @brief Dispatch events until stop() is called
+   */
+  void
+  run();
+
+  void
+  stop()
+  {
+    m_isRunning = false;
+  }
+
+  /**
+   * @brief Monotonic clock in milliseconds, used for all timer deadlines
+   */
+  static uint64_t
+  now();
+
+  static void
+  setNonBlocking(int fd);
+
+private:
+  int
+  getWaitTime(int maxWaitMs) const;
+
+  void
+  fireTimers();
+
+  void
+  runPosted();
+
+private:
+  int m_epollFd;
+  bool m_isRunning;
+
+  // epoll_event.data carries the fd and the generation of its registration, so an event
+  // of a descriptor that was closed and reused during the same batch is recognized
+  struct Entry
+  {
+    EventCallback callback;
+    uint32_t generation;
+  };
+
+  std::unordered_map<int, Entry> m_entries;
+  std::vector<epoll_event> m_readyEvents;
+  uint32_t m_lastGeneration;
+
+  // deadline (ms) -> (id, callback)
+  std::multimap<uint64_t, std::pair<TimerId, TimerCallback>> m_timers;
+  std::unordered_map<TimerId, std::multimap<uint64_t, std::pair<TimerId, TimerCallback>>::iterator> m_timerIndex;
+  TimerId m_lastTimerId;
+
+  // eventfd that wakes up epoll_wait() when tasks are posted
+  int m_wakeupFd;
+  std::mutex m_postMutex;
+  std::vector<Task> m_posted;
+};
+
+} // namespace net
+} // namespace sbt
+
+#endif // SBT_NET_REACTOR_HPP
@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "resolver.hpp"
+
+#include <algorithm>
+#include <netdb.h>
+#include <string.h>
+
+namespace sbt {
+namespace net {
+
+// lookups that take long are rare, a few workers cover a tier of trackers
+const size_t Resolver::DEFAULT_MAX_THREADS = 8;
+
+Resolver::Resolver(Reactor& reactor, size_t maxThreads)
+  : m_reactor(reactor)
+  , m_lookup(&Resolver::lookup)
+  , m_maxThreads(std::max<size_t>(maxThreads, 1))
+  , m_isStopping(false)
+  , m_nIdle(0)
+{
+}
+
+Resolver::~Resolver()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_hasQuery.notify_all();
+
+  for (auto& thread : m_threads)
+    thread.join();
+}
+
+void
+Resolver::resolve(const std::string& host, const std::string& port, const Callback& callback)
+{
+  Query query = {host, port, callback};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queries.push_back(query);
+
+    // every idle worker takes one query, start another one for the rest
+    if (m_queries.size() > m_nIdle && m_threads.size() < m_maxThreads)
+      m_threads.push_back(std::thread(&Resolver::work, this));
+  }
+  m_hasQuery.notify_one();
+}
+
+std::string
+Resolver::lookup(const std::string& host, const std::string& port, std::vector<Address>& addresses)
+{
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+
+  addrinfo* res = nullptr;
+  int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+  if (status != 0)
+    return std::string("Cannot resolve ") + host + ": " + gai_strerror(status);
+
+  for (addrinfo* ai = res; ai != nullptr; ai = ai->ai_next) {
+    if (ai->ai_addrlen > sizeof(sockaddr_storage))
+      continue;
+
+    Address address;
+    memset(&address.storage, 0, sizeof(address.storage));
+    memcpy(&address.storage, ai->ai_addr, ai->ai_addrlen);
+    address.length = ai->ai_addrlen;
+    addresses.push_back(address);
+  }
+  freeaddrinfo(res);
+
+  if (addresses.empty())
+    return "No usable address for " + host;
+  return "";
+}
+
+void
+Resolver::work()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    ++m_nIdle;
+    m_hasQuery.wait(lock, [this] { return m_isStopping || !m_queries.empty(); });
+    --m_nIdle;
+    if (m_isStopping)
+      return;
+
+    Query query = std::move(m_queries.front());
+    m_queries.pop_front();
+    lock.unlock();
+
+    std::vector<Address> addresses;
+    std::string error = m_lookup(query.host, query.port, addresses);
+
+    Callback callback = query.callback;
+    m_reactor.post([callback, addresses, error] { callback(addresses, error); });
+
+    lock.lock();
+  }
+}
+
+} // namespace net
+} // namespace sbt
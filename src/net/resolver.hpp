@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_NET_RESOLVER_HPP
+#define SBT_NET_RESOLVER_HPP
+
+#include "reactor.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+namespace sbt {
+namespace net {
+
+/**
+ * @brief A resolved socket address, ready for connect()
+ */
+struct Address
+{
+  sockaddr_storage storage;
+  socklen_t length;
+
+  const sockaddr*
+  get() const
+  {
+    return reinterpret_cast<const sockaddr*>(&storage);
+  }
+
+  int
+  getFamily() const
+  {
+    return storage.ss_family;
+  }
+};
+
+/**
+ * @brief Host name resolution off the reactor thread
+ *
+ * getaddrinfo() blocks for as long as the name servers take to answer, so it runs on
+ * worker threads and the result is posted back to the reactor.  Workers are started as
+ * lookups come in, up to a maximum, so a name whose servers do not answer only holds up
+ * its own lookup; beyond the maximum, lookups wait for a free worker.
+ */
+class Resolver
+{
+public:
+  /**
+   * @brief Receives the addresses of a host on the reactor thread
+   *
+   * @p addresses is empty if the lookup failed, @p error then says why.
+   */
+  typedef function<void(const std::vector<Address>& addresses, const std::string& error)> Callback;
+
+  /**
+   * @brief A blocking lookup, in the form of lookup()
+   */
+  typedef function<std::string(const std::string& host, const std::string& port,
+                               std::vector<Address>& addresses)> LookupFunction;
+
+  static const size_t DEFAULT_MAX_THREADS;
+
+public:
+  explicit
+  Resolver(Reactor& reactor, size_t maxThreads = DEFAULT_MAX_THREADS);
+
+  /**
+   * @brief Stop the workers; lookups still queued are never answered
+   */
+  ~Resolver();
+
+  Resolver(const Resolver&) = delete;
+
+  Resolver&
+  operator=(const Resolver&) = delete;
+
+  /**
+   * @brief Look up the stream socket addresses of @p host:@p port
+   */
+  void
+  resolve(const std::string& host, const std::string& port, const Callback& callback);
+
+  /**
+   * @brief Replace the lookup the workers run, e.g. in tests; call before resolve()
+   */
+  void
+  setLookup(const LookupFunction& lookup)
+  {
+    m_lookup = lookup;
+  }
+
+  /**
+   * @brief The blocking lookup the workers run by default
+   * @return error message, empty on success
+   */
+  static std::string
+  lookup(const std::string& host, const std::string& port, std::vector<Address>& addresses);
+
+private:
+  void
+  work();
+
+private:
+  struct Query
+  {
+    std::string host;
+    std::string port;
+    Callback callback;
+  };
+
+  Reactor& m_reactor;
+  LookupFunction m_lookup;
+  size_t m_maxThreads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_hasQuery;
+  std::deque<Query> m_queries;
+  bool m_isStopping;
+
+  size_t m_nIdle;  // workers waiting for a query
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace net
+} // namespace sbt
+
+#endif // SBT_NET_RESOLVER_HPP
@@ -1,28 +1,480 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
 #include "peerConnection.hpp"
-#include "tracker-response.hpp"
-#include <vector>
-#include "meta-info.hpp"
-#include "util/buffer.hpp"
-
-namespace sbt{
-	PeerConnection::PeerConnection(int sockfd, bool initiated, bool waitingForHandshake)
-		: m_sockfd(sockfd), m_initiated(initiated), m_waitingForHandshake(waitingForHandshake), lastRequestedPiece(-1)
-	{}
-	PeerConnection::PeerConnection(int sockfd, bool initiated, bool waitingForHandshake, std::string peerId)
-		: m_sockfd(sockfd), m_initiated(initiated), m_waitingForHandshake(waitingForHandshake), m_peerId(peerId), lastRequestedPiece(-1)
-	{}
-
-	void PeerConnection::setPeerBitfield(const ConstBufferPtr& bitfield, int numPieces)
-	{
-		int size = bitfield->size();
-		const uint8_t* buf = bitfield->buf();
-		for (int i = 0, count = 0; i<size; i++)
-			for (int j = 0; j<8; j++, count++)
-				if (count > numPieces)
-					peer_bitField.push_back(0);
-				else
-					peer_bitField.push_back((1 << (8 - 1 - j) & buf[i]) >> (8 - 1 - j));
-	}
-
-
-}
\ No newline at end of file
+#include "msg/msg-base.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+
+namespace sbt {
+
+const size_t PeerConnection::HANDSHAKE_LENGTH = 68;
+// a piece message carries a whole piece at most, and piece lengths beyond 16 MiB are unheard of
+const size_t PeerConnection::MAX_MESSAGE_LENGTH = (1 << 24) + 9;
+
+const size_t PeerConnection::MIN_PIPELINE_DEPTH = 16;
+const size_t PeerConnection::MAX_PIPELINE_DEPTH = 250;
+
+// requests are sized to keep this much download time in flight
+static const double PIPELINE_SECONDS = 3.0;
+static const uint64_t RATE_WINDOW_MS = 1000;
+
+static const size_t INITIAL_RECV_BUFFER_SIZE = 64 * 1024;
+static const size_t MIN_RECV_SPACE = 16 * 1024;
+
+// writev() that does not raise SIGPIPE when the peer has gone away
+static ssize_t
+sendVector(int fd, const struct iovec* iov, size_t nIov, int flags = 0)
+{
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = nIov;
+
+  ssize_t res;
+  do {
+    res = sendmsg(fd, &msg, MSG_NOSIGNAL | flags);
+  } while (res == -1 && errno == EINTR);
+  return res;
+}
+
+PeerConnection::PeerConnection(int sockfd, bool initiated, bool waitingForHandshake)
+  : m_sockfd(sockfd)
+  , m_initiated(initiated)
+  , m_waitingForHandshake(waitingForHandshake)
+  , m_isClosed(false)
+  , m_isConnecting(false)
+  , m_hasSentBitfield(false)
+  , m_isPeerChoking(true)
+  , m_minPipelineDepth(MIN_PIPELINE_DEPTH)
+  , m_maxPipelineDepth(MAX_PIPELINE_DEPTH)
+  , m_downloadRate(0)
+  , m_rateWindowStart(0)
+  , m_rateWindowBytes(0)
+  , m_recvBuffer(INITIAL_RECV_BUFFER_SIZE)
+  , m_recvBegin(0)
+  , m_recvEnd(0)
+  , m_sendOffset(0)
+{
+}
+
+PeerConnection::PeerConnection(int sockfd, bool initiated, bool waitingForHandshake,
+                               const std::string& peerId)
+  : m_sockfd(sockfd)
+  , m_initiated(initiated)
+  , m_waitingForHandshake(waitingForHandshake)
+  , m_peerId(peerId)
+  , m_isClosed(false)
+  , m_isConnecting(false)
+  , m_hasSentBitfield(false)
+  , m_isPeerChoking(true)
+  , m_minPipelineDepth(MIN_PIPELINE_DEPTH)
+  , m_maxPipelineDepth(MAX_PIPELINE_DEPTH)
+  , m_downloadRate(0)
+  , m_rateWindowStart(0)
+  , m_rateWindowBytes(0)
+  , m_recvBuffer(INITIAL_RECV_BUFFER_SIZE)
+  , m_recvBegin(0)
+  , m_recvEnd(0)
+  , m_sendOffset(0)
+{
+}
+
+void
+PeerConnection::handleEvent(uint32_t events)
+{
+  // callbacks may drop the client's reference to this connection
+  shared_ptr<PeerConnection> self = shared_from_this();
+
+  if (m_isConnecting) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(m_sockfd, SOL_SOCKET, SO_ERROR, &error, &length) == -1)
+      error = errno;
+    if (error == 0 && (events & net::Reactor::EVENT_WRITE) == 0)
+      return;
+
+    m_isConnecting = false;
+    if (error != 0) {
+      if (!m_isClosed && m_onClose)
+        m_onClose(*this);
+      return;
+    }
+
+    if (m_onConnect)
+      m_onConnect(*this);
+  }
+
+  if (events & net::Reactor::EVENT_WRITE)
+    flushSendQueue();
+
+  if (events & (net::Reactor::EVENT_READ | net::Reactor::EVENT_ERROR))
+    readAvailable();
+}
+
+bool
+PeerConnection::removeRequest(const Block& block)
+{
+  // peers answer in order, so this is almost always the front
+  auto it = std::find(m_requests.begin(), m_requests.end(), block);
+  if (it == m_requests.end())
+    return false;
+
+  m_requests.erase(it);
+  return true;
+}
+
+std::deque<Block>
+PeerConnection::takeRequests()
+{
+  std::deque<Block> requests;
+  requests.swap(m_requests);
+  return requests;
+}
+
+void
+PeerConnection::recordDownload(size_t bytes)
+{
+  uint64_t now = net::Reactor::now();
+  if (m_rateWindowStart == 0)
+    m_rateWindowStart = now;
+
+  m_rateWindowBytes += bytes;
+
+  uint64_t elapsed = now - m_rateWindowStart;
+  if (elapsed >= RATE_WINDOW_MS) {
+    double rate = m_rateWindowBytes * 1000.0 / elapsed;
+    m_downloadRate = (m_downloadRate == 0) ? rate : (m_downloadRate + rate) / 2;
+    m_rateWindowStart = now;
+    m_rateWindowBytes = 0;
+  }
+}
+
+size_t
+PeerConnection::getPipelineDepth() const
+{
+  size_t depth = m_downloadRate * PIPELINE_SECONDS / BlockScheduler::BLOCK_LENGTH;
+  return std::min(std::max(depth, m_minPipelineDepth), m_maxPipelineDepth);
+}
+
+void
+PeerConnection::send(ConstBufferPtr data)
+{
+  if (m_isClosed || data->empty())
+    return;
+
+  Chunk chunk = {data->buf(), data->size(), data, -1, 0, nullptr};
+  m_sendQueue.push_back(chunk);
+
+  // if older data is still waiting for EPOLLOUT, keep the order and wait with it
+  if (m_sendQueue.size() == 1)
+    flushSendQueue();
+}
+
+void
+PeerConnection::send(const std::vector<struct iovec>& iov, ConstBufferPtr owner)
+{
+  if (m_isClosed || iov.empty())
+    return;
+
+  size_t written = 0;
+  if (m_sendQueue.empty() && !m_isConnecting) {
+    ssize_t res = sendVector(m_sockfd, &iov.front(), std::min<size_t>(iov.size(), IOV_MAX));
+    if (res > 0)
+      written = res;
+  }
+
+  // queue whatever the socket did not take
+  for (const auto& vec : iov) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(vec.iov_base);
+    size_t size = vec.iov_len;
+
+    if (written >= size) {
+      written -= size;
+      continue;
+    }
+    data += written;
+    size -= written;
+    written = 0;
+
+    bool isOwned = static_cast<bool>(owner) && !owner->empty() &&
+                   data >= owner->buf() && data + size <= owner->buf() + owner->size();
+    if (isOwned) {
+      Chunk chunk = {data, size, owner, -1, 0, nullptr};
+      m_sendQueue.push_back(chunk);
+    }
+    else {
+      ConstBufferPtr copy = make_shared<Buffer>(data, size);
+      Chunk chunk = {copy->buf(), size, copy, -1, 0, nullptr};
+      m_sendQueue.push_back(chunk);
+    }
+  }
+}
+
+void
+PeerConnection::sendFile(ConstBufferPtr header, int fd, off_t offset, size_t length,
+                         shared_ptr<const void> fileOwner)
+{
+  if (m_isClosed)
+    return;
+
+  bool wasIdle = m_sendQueue.empty();
+
+  if (static_cast<bool>(header) && !header->empty()) {
+    Chunk chunk = {header->buf(), header->size(), header, -1, 0, nullptr};
+    m_sendQueue.push_back(chunk);
+  }
+
+  if (length > 0) {
+    Chunk chunk = {nullptr, length, nullptr, fd, offset, fileOwner};
+    m_sendQueue.push_back(chunk);
+  }
+
+  if (wasIdle)
+    flushSendQueue();
+}
+
+void
+PeerConnection::send(ConstBufferPtr header, const uint8_t* data, size_t length,
+                     shared_ptr<const void> holder)
+{
+  if (m_isClosed)
+    return;
+
+  bool wasIdle = m_sendQueue.empty();
+
+  if (static_cast<bool>(header) && !header->empty()) {
+    Chunk chunk = {header->buf(), header->size(), header, -1, 0, nullptr};
+    m_sendQueue.push_back(chunk);
+  }
+
+  if (length > 0) {
+    Chunk chunk = {data, length, nullptr, -1, 0, holder};
+    m_sendQueue.push_back(chunk);
+  }
+
+  // both chunks go out in one gathering write
+  if (wasIdle)
+    flushSendQueue();
+}
+
+void
+PeerConnection::flushSendQueue()
+{
+  static const size_t MAX_IOV = 64;
+  struct iovec iov[MAX_IOV];
+
+  // data queued while connecting goes out once the connection is up
+  while (!m_sendQueue.empty() && !m_isClosed && !m_isConnecting) {
+    Chunk& front = m_sendQueue.front();
+
+    if (front.fileFd >= 0) {
+      off_t offset = front.fileOffset + m_sendOffset;
+      ssize_t res = sendfile(m_sockfd, front.fileFd, &offset, front.size - m_sendOffset);
+
+      if (res == -1) {
+        if (errno == EINTR)
+          continue;
+        if (errno == EINVAL || errno == ENOSYS) {
+          // this file cannot be spliced into a socket, send the rest from memory
+          readFileChunk(front);
+          continue;
+        }
+        return;
+      }
+
+      if (res == 0) {
+        // the file is shorter than promised, nothing more can be sent for this chunk
+        m_sendQueue.pop_front();
+        m_sendOffset = 0;
+        continue;
+      }
+
+      consumeSendQueue(res);
+      continue;
+    }
+
+    // gather queued memory chunks into one write, up to the next file chunk
+    size_t nIov = 0;
+    bool isFileNext = false;
+    for (auto it = m_sendQueue.begin(); it != m_sendQueue.end() && nIov < MAX_IOV; ++it, ++nIov) {
+      if (it->fileFd >= 0) {
+        isFileNext = true;
+        break;
+      }
+      size_t skip = (nIov == 0) ? m_sendOffset : 0;
+      iov[nIov].iov_base = const_cast<uint8_t*>(it->data + skip);
+      iov[nIov].iov_len = it->size - skip;
+    }
+
+    // a piece header followed by file data: let the kernel put both in one segment
+    ssize_t res = sendVector(m_sockfd, iov, nIov, isFileNext ? MSG_MORE : 0);
+    if (res == -1) {
+      // on EAGAIN the socket is registered for EPOLLOUT and the rest goes out from there;
+      // hard errors also surface on the read side, which closes the connection
+      return;
+    }
+
+    consumeSendQueue(res);
+  }
+}
+
+void
+PeerConnection::consumeSendQueue(size_t written)
+{
+  while (written > 0) {
+    size_t remaining = m_sendQueue.front().size - m_sendOffset;
+    if (written < remaining) {
+      m_sendOffset += written;
+      break;
+    }
+    written -= remaining;
+    m_sendQueue.pop_front();
+    m_sendOffset = 0;
+  }
+}
+
+void
+PeerConnection::readFileChunk(Chunk& chunk)
+{
+  size_t length = chunk.size - m_sendOffset;
+  auto data = make_shared<Buffer>(length);
+
+  ssize_t res = pread(chunk.fileFd, data->buf(), length, chunk.fileOffset + m_sendOffset);
+  data->resize(res > 0 ? res : 0);
+
+  chunk.owner = data;
+  chunk.data = data->empty() ? nullptr : data->buf();
+  chunk.size = data->size();
+  chunk.fileFd = -1;
+  chunk.holder.reset();
+  m_sendOffset = 0;
+
+  if (data->empty())
+    m_sendQueue.pop_front();
+}
+
+void
+PeerConnection::readAvailable()
+{
+  bool isEof = false;
+
+  while (!m_isClosed) {
+    reserveRecvSpace(MIN_RECV_SPACE);
+
+    ssize_t res = recv(m_sockfd, &m_recvBuffer[m_recvEnd], m_recvBuffer.size() - m_recvEnd, 0);
+    if (res > 0) {
+      m_recvEnd += res;
+      if (!processFrames()) {
+        isEof = true;
+        break;
+      }
+      continue;
+    }
+
+    if (res == -1 && errno == EINTR)
+      continue;
+    if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+
+    // orderly shutdown by the peer or a socket error
+    isEof = true;
+    break;
+  }
+
+  if (isEof && !m_isClosed && m_onClose)
+    m_onClose(*this);
+}
+
+bool
+PeerConnection::processFrames()
+{
+  while (!m_isClosed) {
+    size_t available = m_recvEnd - m_recvBegin;
+    const uint8_t* frame = &m_recvBuffer[m_recvBegin];
+
+    size_t frameLength;
+    if (m_waitingForHandshake) {
+      frameLength = HANDSHAKE_LENGTH;
+    }
+    else {
+      if (available < 4)
+        break;
+
+      frameLength = 4 + ntohl(*reinterpret_cast<const uint32_t*>(frame));
+      if (frameLength > MAX_MESSAGE_LENGTH)
+        return false;
+    }
+
+    if (available < frameLength) {
+      // let the next recv() complete the frame in one go
+      reserveRecvSpace(frameLength - available);
+      break;
+    }
+
+    // consume before dispatching, the callback may send but never reads
+    m_recvBegin += frameLength;
+
+    try {
+      if (m_waitingForHandshake) {
+        m_waitingForHandshake = false;
+        if (m_onHandshake)
+          m_onHandshake(*this, frame, frameLength);
+      }
+      else if (m_onMessage)
+        m_onMessage(*this, frame, frameLength);
+    }
+    catch (const msg::Error&) {
+      // a payload that does not decode: only this peer is dropped, with the rest of
+      // its stream
+      return false;
+    }
+  }
+
+  if (m_recvBegin == m_recvEnd)
+    m_recvBegin = m_recvEnd = 0;
+
+  return true;
+}
+
+void
+PeerConnection::reserveRecvSpace(size_t size)
+{
+  if (m_recvBuffer.size() - m_recvEnd >= size)
+    return;
+
+  // move the unread bytes to the front
+  if (m_recvBegin > 0) {
+    memmove(&m_recvBuffer.front(), &m_recvBuffer[m_recvBegin], m_recvEnd - m_recvBegin);
+    m_recvEnd -= m_recvBegin;
+    m_recvBegin = 0;
+  }
+
+  if (m_recvBuffer.size() - m_recvEnd < size)
+    m_recvBuffer.resize(std::max(m_recvBuffer.size() * 2, m_recvEnd + size));
+}
+
+} // namespace sbt
@@ -1,55 +1,422 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
 #ifndef SBT_PEERCONNECTION_HPP
 #define SBT_PEERCONNECTION_HPP
+
 #include "common.hpp"
-#include "tracker-response.hpp"
-#include <vector>
-#include "meta-info.hpp"
+#include "net/reactor.hpp"
+#include "download/block-scheduler.hpp"
+#include "util/bitset.hpp"
 #include "util/buffer.hpp"
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <sys/uio.h>
 
 namespace sbt {
 
-	class PeerConnection{
-	public:
-		PeerConnection() {}
-		PeerConnection(int sockfd, bool initiated, bool waitingForHandshake);
-		PeerConnection(int sockfd, bool initiated, bool waitingForHandshake, std::string peerId);  // sockfd is the unique identifier
-		void setPeerBitfield(const ConstBufferPtr& bitfield, int numPieces);
-		void setOneBit(int index) { peer_bitField[index] = 1; }
-		std::vector<int> getBitfield() { 
-			return peer_bitField; 
-		}
-		bool getInitiated() { 
-			return m_initiated; 
-		}
-		std::string getPeerId() { 
-			return m_peerId; 
-		}
-		void setPeerId(const int& peerId) {
-			m_peerId = peerId;
-		}
-		bool isWaitingHS() { 
-			return m_waitingForHandshake; 
-		}
-		void setNotWaitingHS(){  // indicates no longer waiting for handshake
-			m_waitingForHandshake = false;
-		}
-
-		void setLastReq(int index){
-			lastRequestedPiece = index;
-		}
-
-		int getLastReq(){
-			return lastRequestedPiece;
-		}
-	private:
-		int m_sockfd;  // peerConnection unique identifer
-		bool m_initiated;  // remember if I set up this connction or the other side did
-		bool m_waitingForHandshake;
-		std::string m_peerId;  // remember who I am talking with
-		std::vector<int> peer_bitField;  // remembers what the other side has
-		int lastRequestedPiece;
-	};
-
-}// namespace sbt
-
-#endif // SBT_PEERCONNECTION_HPP
\ No newline at end of file
+/**
+ * @brief State of one peer wire connection
+ *
+ * A PeerConnection is the reactor handler of its non-blocking socket.  Incoming bytes
+ * are appended to a per-connection receive buffer and split into frames (the 68-byte
+ * handshake first, then length-prefixed messages in MsgBase::decode format) no matter
+ * how the stream was segmented; every complete frame is handed to the client.  Outgoing
+ * data is queued and written as the socket accepts it.
+ */
+class PeerConnection : public net::Reactor::Handler
+                     , public enable_shared_from_this<PeerConnection>
+{
+public:
+  typedef function<void(PeerConnection&)> Callback;
+
+  /**
+   * @brief Receives one complete frame; @p frame is only valid during the call
+   *
+   * A msg::Error thrown by the callback closes the connection.
+   */
+  typedef function<void(PeerConnection&, const uint8_t* frame, size_t length)> FrameCallback;
+
+  static const size_t HANDSHAKE_LENGTH;
+  static const size_t MAX_MESSAGE_LENGTH;
+
+  // bounds of the number of outstanding block requests, see getPipelineDepth()
+  static const size_t MIN_PIPELINE_DEPTH;
+  static const size_t MAX_PIPELINE_DEPTH;
+
+public:
+  PeerConnection(int sockfd, bool initiated, bool waitingForHandshake);
+
+  PeerConnection(int sockfd, bool initiated, bool waitingForHandshake,
+                 const std::string& peerId); // sockfd is the unique identifier
+
+  PeerConnection(const PeerConnection&) = delete;
+
+  PeerConnection&
+  operator=(const PeerConnection&) = delete;
+
+  virtual void
+  handleEvent(uint32_t events);
+
+  void
+  setOnHandshake(const FrameCallback& onHandshake)
+  {
+    m_onHandshake = onHandshake;
+  }
+
+  void
+  setOnMessage(const FrameCallback& onMessage)
+  {
+    m_onMessage = onMessage;
+  }
+
+  void
+  setOnClose(const Callback& onClose)
+  {
+    m_onClose = onClose;
+  }
+
+  /**
+   * @brief Called once a connection set up with setConnecting() is established
+   */
+  void
+  setOnConnect(const Callback& onConnect)
+  {
+    m_onConnect = onConnect;
+  }
+
+  /**
+   * @brief The socket is in the middle of a non-blocking connect()
+   *
+   * Nothing is read or written until the socket becomes writable; then the outcome is
+   * taken from SO_ERROR, and the connection either continues with the connect callback
+   * or is closed.
+   */
+  void
+  setConnecting()
+  {
+    m_isConnecting = true;
+  }
+
+  bool
+  isConnecting() const
+  {
+    return m_isConnecting;
+  }
+
+  int
+  getSocket() const
+  {
+    return m_sockfd;
+  }
+
+  /**
+   * @brief Queue @p data for sending and write as much of it as the socket accepts
+   */
+  void
+  send(ConstBufferPtr data);
+
+  /**
+   * @brief Send the bytes described by @p iov with a single gathering write
+   *
+   * Parts that lie inside @p owner are referenced (and @p owner kept alive) if they
+   * cannot be written immediately; any other part is copied, so @p iov may point into
+   * short-lived objects such as an encoded message header.
+   */
+  void
+  send(const std::vector<struct iovec>& iov, ConstBufferPtr owner);
+
+  /**
+   * @brief Send @p header followed by @p length bytes of file @p fd at @p offset
+   *
+   * The file bytes go from the page cache to the socket with sendfile() and never enter
+   * user space.  If the kernel cannot sendfile() from this descriptor, the remaining
+   * bytes are read and sent from memory instead.  @p fd must stay open until the data
+   * has been written; if @p fileOwner is given, a reference to it is held until then.
+   */
+  void
+  sendFile(ConstBufferPtr header, int fd, off_t offset, size_t length,
+           shared_ptr<const void> fileOwner = nullptr);
+
+  /**
+   * @brief Send @p header followed by @p length bytes at @p data without copying them
+   *
+   * For memory that is not a Buffer, e.g. a mapped file.  @p holder is referenced until
+   * the data has been written and must keep @p data valid.
+   */
+  void
+  send(ConstBufferPtr header, const uint8_t* data, size_t length,
+       shared_ptr<const void> holder);
+
+  /**
+   * @brief Mark the connection as closed; no more frames are dispatched after this
+   */
+  void
+  setClosed()
+  {
+    m_isClosed = true;
+  }
+
+  bool
+  isClosed() const
+  {
+    return m_isClosed;
+  }
+
+  /**
+   * @brief Take the payload of the peer's bitfield message, for @p numPieces pieces
+   */
+  void
+  setPeerBitfield(const BufferView& bitfield, size_t numPieces)
+  {
+    m_peerBitfield = Bitset(bitfield, numPieces);
+  }
+
+  void
+  setOneBit(uint32_t index)
+  {
+    // a have message may come without a bitfield message before it
+    if (index >= m_peerBitfield.size())
+      m_peerBitfield.resize(index + 1);
+    m_peerBitfield.set(index);
+  }
+
+  const Bitset&
+  getBitfield() const
+  {
+    return m_peerBitfield;
+  }
+
+  bool
+  hasPiece(uint32_t index) const
+  {
+    return m_peerBitfield.test(index);
+  }
+
+  bool
+  getInitiated()
+  {
+    return m_initiated;
+  }
+
+  std::string
+  getPeerId()
+  {
+    return m_peerId;
+  }
+
+  void
+  setPeerId(const std::string& peerId)
+  {
+    m_peerId = peerId;
+  }
+
+  bool
+  isWaitingHS()
+  {
+    return m_waitingForHandshake;
+  }
+
+  void
+  setNotWaitingHS() // indicates no longer waiting for handshake
+  {
+    m_waitingForHandshake = false;
+  }
+
+  /**
+   * @brief Our bitfield message has been queued, after our handshake
+   *
+   * Until then the peer must not get have messages: they would come before the
+   * handshake or bitfield, and the bitfield sent later covers those pieces anyway.
+   */
+  void
+  setBitfieldSent()
+  {
+    m_hasSentBitfield = true;
+  }
+
+  bool
+  hasSentBitfield() const
+  {
+    return m_hasSentBitfield;
+  }
+
+  bool
+  isPeerChoking() const
+  {
+    return m_isPeerChoking;
+  }
+
+  void
+  setPeerChoking(bool isChoking)
+  {
+    m_isPeerChoking = isChoking;
+  }
+
+  /**
+   * @brief Remember that @p block has been requested from the peer
+   */
+  void
+  addRequest(const Block& block)
+  {
+    m_requests.push_back(block);
+  }
+
+  bool
+  hasRequest(const Block& block) const
+  {
+    return std::find(m_requests.begin(), m_requests.end(), block) != m_requests.end();
+  }
+
+  /**
+   * @brief Forget the request for @p block, as it has arrived
+   * @return false if @p block was not requested on this connection
+   */
+  bool
+  removeRequest(const Block& block);
+
+  /**
+   * @brief Forget all outstanding requests and return them, e.g. when the peer chokes us
+   */
+  std::deque<Block>
+  takeRequests();
+
+  size_t
+  getNumRequests() const
+  {
+    return m_requests.size();
+  }
+
+  /**
+   * @brief Account @p bytes of received block data for the download rate
+   */
+  void
+  recordDownload(size_t bytes);
+
+  /**
+   * @brief Download rate in bytes per second, averaged over the last few seconds
+   */
+  double
+  getDownloadRate() const
+  {
+    return m_downloadRate;
+  }
+
+  /**
+   * @brief Number of block requests to keep outstanding on this connection
+   *
+   * Enough requests to cover a few seconds at the measured download rate, so the link
+   * stays busy while requests make their round trip, within the pipeline limits.
+   */
+  size_t
+  getPipelineDepth() const;
+
+  void
+  setPipelineLimits(size_t minDepth, size_t maxDepth)
+  {
+    m_minPipelineDepth = minDepth;
+    m_maxPipelineDepth = std::max(minDepth, maxDepth);
+  }
+
+private:
+  /**
+   * @brief Read until the socket would block, dispatching frames as they complete
+   */
+  void
+  readAvailable();
+
+  /**
+   * @brief Dispatch every complete frame currently buffered
+   * @return false if the stream is malformed, or a handler could not decode a frame
+   *         (msg::Error)
+   */
+  bool
+  processFrames();
+
+  /**
+   * @brief Make room for at least @p size more bytes after the buffered data
+   */
+  void
+  reserveRecvSpace(size_t size);
+
+  void
+  flushSendQueue();
+
+  void
+  consumeSendQueue(size_t written);
+
+private:
+  int m_sockfd;  // peerConnection unique identifer
+  bool m_initiated;  // remember if I set up this connction or the other side did
+  bool m_waitingForHandshake;
+  std::string m_peerId;  // remember who I am talking with
+  Bitset m_peerBitfield;  // remembers what the other side has
+
+  bool m_isClosed;
+  bool m_isConnecting;
+  bool m_hasSentBitfield;
+  bool m_isPeerChoking;
+
+  std::deque<Block> m_requests;  // in flight, oldest first
+  size_t m_minPipelineDepth;
+  size_t m_maxPipelineDepth;
+  double m_downloadRate;
+  uint64_t m_rateWindowStart;
+  size_t m_rateWindowBytes;
+
+  // bytes [m_recvBegin, m_recvEnd) of m_recvBuffer are received but not yet dispatched;
+  // the unread part is moved back to the front once the head has been consumed, so a
+  // frame is always contiguous in memory
+  std::vector<uint8_t> m_recvBuffer;
+  size_t m_recvBegin;
+  size_t m_recvEnd;
+
+  // a chunk is either memory [data, data + size) kept alive by owner (or holder), or, if
+  // fileFd is valid, size bytes of that file starting at fileOffset, kept open by holder
+  struct Chunk
+  {
+    const uint8_t* data;
+    size_t size;
+    ConstBufferPtr owner;
+    int fileFd;
+    off_t fileOffset;
+    shared_ptr<const void> holder;
+  };
+
+  /**
+   * @brief Turn the (partially sent) file chunk @p chunk into a memory chunk
+   */
+  void
+  readFileChunk(Chunk& chunk);
+
+  std::deque<Chunk> m_sendQueue;
+  size_t m_sendOffset;  // bytes of m_sendQueue.front() already written
+
+  FrameCallback m_onHandshake;
+  FrameCallback m_onMessage;
+  Callback m_onClose;
+  Callback m_onConnect;
+};
+
+} // namespace sbt
+
+#endif // SBT_PEERCONNECTION_HPP
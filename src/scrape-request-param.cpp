@@ -0,0 +1,43 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "scrape-request-param.hpp"
+#include "http/url-encoding.hpp"
+#include <sstream>
+
+namespace sbt {
+
+std::string
+ScrapeRequestParam::encode() const
+{
+  if (m_infoHashes.empty())
+    throw Error("No info hash!");
+
+  std::stringstream ss;
+  char separator = '?';
+  for (const auto& infoHash : m_infoHashes) {
+    ss << separator << "info_hash=" << url::encode(infoHash->buf(), infoHash->size());
+    separator = '&';
+  }
+  return ss.str();
+}
+
+} // namespace sbt
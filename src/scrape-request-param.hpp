@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_SCRAPE_REQUEST_PARAM_HPP
+#define SBT_SCRAPE_REQUEST_PARAM_HPP
+
+#include "common.hpp"
+#include "util/buffer.hpp"
+
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Query of a scrape request, which may ask for many torrents at once
+ */
+class ScrapeRequestParam
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+public:
+  void
+  addInfoHash(ConstBufferPtr infoHash)
+  {
+    m_infoHashes.push_back(infoHash);
+  }
+
+  const std::vector<ConstBufferPtr>&
+  getInfoHashes() const
+  {
+    return m_infoHashes;
+  }
+
+  /**
+   * @brief Encode the query, one info_hash parameter per torrent
+   * @throw Error if there is no info hash
+   */
+  std::string
+  encode() const;
+
+private:
+  std::vector<ConstBufferPtr> m_infoHashes;
+};
+
+} // namespace sbt
+
+#endif // SBT_SCRAPE_REQUEST_PARAM_HPP
@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "scrape-response.hpp"
+
+namespace sbt {
+
+const std::string ScrapeResponse::FAILURE("failure");
+const std::string ScrapeResponse::FILES("files");
+const std::string ScrapeResponse::FLAGS("flags");
+const std::string ScrapeResponse::MIN_REQUEST_INTERVAL("min_request_interval");
+const std::string ScrapeResponse::COMPLETE("complete");
+const std::string ScrapeResponse::DOWNLOADED("downloaded");
+const std::string ScrapeResponse::INCOMPLETE("incomplete");
+
+static uint64_t
+getCount(const bencoding::Value& dict, const std::string& key)
+{
+  // a missing or negative count is read as 0
+  auto value = dict.get(key, bencoding::TYPE_INTEGER);
+  if (value == nullptr || value->getInteger() < 0)
+    return 0;
+  return value->getInteger();
+}
+
+ScrapeResponse::ScrapeResponse()
+  : m_isFailure(true)
+  , m_failure("response is not initialize")
+  , m_minRequestInterval(0)
+{
+}
+
+const ScrapeStats*
+ScrapeResponse::find(const BufferView& infoHash) const
+{
+  auto it = m_files.find(std::string(reinterpret_cast<const char*>(infoHash.buf()),
+                                     infoHash.size()));
+  if (it == m_files.end())
+    return nullptr;
+  return &it->second;
+}
+
+void
+ScrapeResponse::wireDecode(const BufferView& wire)
+{
+  bencoding::Document document(wire);
+  decode(document.getRoot());
+}
+
+void
+ScrapeResponse::decode(const bencoding::Value& response)
+{
+  m_files.clear();
+  m_minRequestInterval = 0;
+
+  auto failure = response.get(FAILURE, bencoding::TYPE_STRING);
+  if (failure != nullptr) {
+    m_isFailure = true;
+    m_failure = failure->toString();
+    return;
+  }
+  m_isFailure = false;
+
+  auto files = response.get(FILES, bencoding::TYPE_DICTIONARY);
+  if (files == nullptr)
+    throw ScrapeResponse::Error("No files in scrape response");
+
+  for (const auto& entry : files->getDictionary()) {
+    if (!entry.value.isDictionary())
+      throw ScrapeResponse::Error("Wrong type of file in scrape response");
+
+    ScrapeStats stats;
+    stats.complete = getCount(entry.value, COMPLETE);
+    stats.downloaded = getCount(entry.value, DOWNLOADED);
+    stats.incomplete = getCount(entry.value, INCOMPLETE);
+    m_files[std::string(reinterpret_cast<const char*>(entry.key.buf()), entry.key.size())] = stats;
+  }
+
+  auto flags = response.get(FLAGS, bencoding::TYPE_DICTIONARY);
+  if (flags != nullptr)
+    m_minRequestInterval = getCount(*flags, MIN_REQUEST_INTERVAL);
+}
+
+} // namespace sbt
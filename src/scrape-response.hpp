@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_SCRAPE_RESPONSE_HPP
+#define SBT_SCRAPE_RESPONSE_HPP
+
+#include "util/buffer.hpp"
+#include "util/bencoding.hpp"
+#include "util/bencoding-document.hpp"
+#include <map>
+
+namespace sbt {
+
+/**
+ * @brief Size of the swarm of one torrent as a tracker reports it
+ */
+struct ScrapeStats
+{
+  uint64_t complete;    // seeders
+  uint64_t downloaded;  // completed downloads ever reported
+  uint64_t incomplete;  // leechers
+};
+
+class ScrapeResponse
+{
+public:
+  class Error : public bencoding::Error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : bencoding::Error(what)
+    {
+    }
+  };
+
+public:
+  ScrapeResponse();
+
+  bool
+  isFailure() const
+  {
+    return m_isFailure;
+  }
+
+  std::string
+  getFailure() const
+  {
+    return m_failure;
+  }
+
+  /**
+   * @brief Stats of all torrents in the response, keyed by the raw 20-byte info hash
+   */
+  const std::map<std::string, ScrapeStats>&
+  getFiles() const
+  {
+    return m_files;
+  }
+
+  /**
+   * @brief Stats of the torrent @p infoHash
+   * @return nullptr if the tracker did not report it
+   */
+  const ScrapeStats*
+  find(const BufferView& infoHash) const;
+
+  /**
+   * @brief Seconds the tracker wants between scrapes (BEP 48 flags), 0 if it did not say
+   */
+  uint64_t
+  getMinRequestInterval() const
+  {
+    return m_minRequestInterval;
+  }
+
+  void
+  decode(const bencoding::Value& response);
+
+  /**
+   * @brief Parse the bencoded body of a scrape response
+   */
+  void
+  wireDecode(const BufferView& wire);
+
+private:
+  static const std::string FAILURE;
+  static const std::string FILES;
+  static const std::string FLAGS;
+  static const std::string MIN_REQUEST_INTERVAL;
+  static const std::string COMPLETE;
+  static const std::string DOWNLOADED;
+  static const std::string INCOMPLETE;
+
+  bool m_isFailure;
+  std::string m_failure;
+  uint64_t m_minRequestInterval;
+  std::map<std::string, ScrapeStats> m_files;
+};
+
+} // namespace sbt
+
+#endif // SBT_SCRAPE_RESPONSE_HPP
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "resume-data.hpp"
+#include "../util/bencoding.hpp"
+
+#include <fstream>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace sbt {
+
+static const std::string INFO_HASH("info-hash");
+static const std::string PIECES("pieces");
+static const std::string FILES("files");
+static const std::string PATH("path");
+static const std::string SIZE("size");
+static const std::string MTIME("mtime");
+
+template<class T>
+static shared_ptr<T>
+getField(const bencoding::Dictionary& dict, const std::string& key)
+{
+  auto field = dynamic_pointer_cast<T>(dict.get(key));
+  if (!static_cast<bool>(field))
+    throw ResumeData::Error("Missing or malformed " + key + " in resume data");
+  return field;
+}
+
+std::vector<ResumeData::FileState>
+ResumeData::statFiles(const std::vector<std::string>& paths)
+{
+  std::vector<FileState> files;
+  for (const auto& path : paths) {
+    FileState file = {path, -1, 0};
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+      file.size = st.st_size;
+      file.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    files.push_back(file);
+  }
+  return files;
+}
+
+void
+ResumeData::wireEncode(std::ostream& os) const
+{
+  bencoding::Dictionary dict;
+  dict.insert(INFO_HASH, make_shared<bencoding::String>(m_infoHash));
+
+  BufferPtr pieces = m_pieces.encode();
+  dict.insert(PIECES, make_shared<bencoding::String>(pieces->buf(), pieces->size()));
+
+  auto files = make_shared<bencoding::List>();
+  for (const auto& file : m_files) {
+    auto entry = make_shared<bencoding::Dictionary>();
+    entry->insert(PATH, make_shared<bencoding::String>(file.path));
+    entry->insert(SIZE, make_shared<bencoding::Integer>(file.size));
+    entry->insert(MTIME, make_shared<bencoding::Integer>(file.mtime));
+    files->append(entry);
+  }
+  dict.insert(FILES, files);
+
+  dict.wireEncode(os);
+}
+
+void
+ResumeData::wireDecode(std::istream& is, size_t numPieces)
+{
+  bencoding::Dictionary dict;
+  dict.wireDecode(is);
+
+  m_infoHash = getField<bencoding::String>(dict, INFO_HASH)->toString();
+
+  auto pieces = getField<bencoding::String>(dict, PIECES);
+  if (pieces->size() != (numPieces + 7) / 8)
+    throw Error("Resume data is for a different number of pieces");
+  m_pieces = Bitset(BufferView(pieces->value(), pieces->size()), numPieces);
+
+  m_files.clear();
+  for (const auto& item : *getField<bencoding::List>(dict, FILES)) {
+    auto entry = dynamic_pointer_cast<bencoding::Dictionary>(item);
+    if (!static_cast<bool>(entry))
+      throw Error("Malformed file entry in resume data");
+
+    FileState file;
+    file.path = getField<bencoding::String>(*entry, PATH)->toString();
+    file.size = getField<bencoding::Integer>(*entry, SIZE)->getValue();
+    file.mtime = getField<bencoding::Integer>(*entry, MTIME)->getValue();
+    m_files.push_back(file);
+  }
+}
+
+bool
+ResumeData::load(const std::string& path, size_t numPieces)
+{
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    return false;
+
+  try {
+    wireDecode(is, numPieces);
+  }
+  catch (const std::exception&) {
+    // corrupt or outdated, everything is checked again
+    return false;
+  }
+  return true;
+}
+
+void
+ResumeData::save(const std::string& path) const
+{
+  // a crash while writing must not leave a truncated file that claims nothing
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+    wireEncode(os);
+    os.flush();
+    if (!os)
+      throw Error("Cannot write " + tmpPath);
+  }
+
+  if (rename(tmpPath.c_str(), path.c_str()) == -1)
+    throw Error("Cannot replace " + path + ": " + strerror(errno));
+}
+
+} // namespace sbt
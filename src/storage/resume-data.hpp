@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_STORAGE_RESUME_DATA_HPP
+#define SBT_STORAGE_RESUME_DATA_HPP
+
+#include "../common.hpp"
+#include "../util/bitset.hpp"
+#include "../util/buffer.hpp"
+
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief What is known to be on disk, so a restart does not have to hash it again
+ *
+ * Stored as a bencoded dictionary next to the payload:
+ *
+ *     info-hash: 20-byte info hash of the torrent
+ *     pieces:    payload of a bitfield message, the pieces verified so far
+ *     files:     list of {path, size, mtime} of every payload file
+ *
+ * The pieces are only trusted if every payload file still has the recorded size and
+ * modification time (in nanoseconds); any change means something else touched the
+ * data and it has to be checked again.
+ */
+class ResumeData
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  struct FileState
+  {
+    std::string path;
+    int64_t size; // -1 if the file does not exist
+    int64_t mtime;
+
+    bool
+    operator==(const FileState& other) const
+    {
+      return path == other.path && size == other.size && mtime == other.mtime;
+    }
+  };
+
+public:
+  /**
+   * @brief Current size and modification time of @p paths
+   */
+  static std::vector<FileState>
+  statFiles(const std::vector<std::string>& paths);
+
+  void
+  setInfoHash(const std::string& infoHash)
+  {
+    m_infoHash = infoHash;
+  }
+
+  const std::string&
+  getInfoHash() const
+  {
+    return m_infoHash;
+  }
+
+  void
+  setPieces(const Bitset& pieces)
+  {
+    m_pieces = pieces;
+  }
+
+  const Bitset&
+  getPieces() const
+  {
+    return m_pieces;
+  }
+
+  void
+  setFiles(const std::vector<FileState>& files)
+  {
+    m_files = files;
+  }
+
+  const std::vector<FileState>&
+  getFiles() const
+  {
+    return m_files;
+  }
+
+  /**
+   * @brief Whether the data describes torrent @p infoHash and files still in @p files
+   */
+  bool
+  matches(const std::string& infoHash, const std::vector<FileState>& files) const
+  {
+    return m_infoHash == infoHash && m_files == files;
+  }
+
+  void
+  wireEncode(std::ostream& os) const;
+
+  /**
+   * @brief Decode resume data of a torrent with @p numPieces pieces
+   * @throw Error or bencoding::Error if the data is malformed
+   */
+  void
+  wireDecode(std::istream& is, size_t numPieces);
+
+  /**
+   * @brief Read resume data from @p path
+   * @return false if there is no usable resume data
+   */
+  bool
+  load(const std::string& path, size_t numPieces);
+
+  /**
+   * @brief Replace @p path atomically with the current data
+   */
+  void
+  save(const std::string& path) const;
+
+private:
+  std::string m_infoHash;
+  Bitset m_pieces;
+  std::vector<FileState> m_files;
+};
+
+} // namespace sbt
+
+#endif // SBT_STORAGE_RESUME_DATA_HPP
@@ -0,0 +1,415 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "storage.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sbt {
+
+const size_t Storage::MAX_OPEN_FILES = 256;
+
+Storage::FileHandle::~FileHandle()
+{
+  ::close(fd);
+}
+
+Storage::Mapping::~Mapping()
+{
+  munmap(addr, length);
+}
+
+Storage::Storage()
+  : m_mode(MODE_PREAD)
+  , m_hasExistingData(false)
+  , m_length(0)
+  , m_pieceLength(0)
+{
+}
+
+Storage::~Storage()
+{
+  close();
+}
+
+void
+Storage::open(const std::string& path, int64_t length, int64_t pieceLength, Mode mode)
+{
+  FileSpec spec;
+  spec.path = path;
+  spec.length = length;
+  open(std::vector<FileSpec>(1, spec), pieceLength, mode);
+}
+
+void
+Storage::open(const std::vector<FileSpec>& files, int64_t pieceLength, Mode mode)
+{
+  close();
+
+  if (files.empty() || pieceLength <= 0)
+    throw Error("Bad payload geometry");
+
+  int64_t offset = 0;
+  bool hasExistingData = false;
+  for (const auto& spec : files) {
+    if (spec.length < 0)
+      throw Error("Bad length of " + spec.path);
+
+    boost::filesystem::path path(spec.path);
+    for (const auto& component : path) {
+      if (component == "..")
+        throw Error("Unsafe file path " + spec.path);
+    }
+
+    if (path.has_parent_path())
+      boost::filesystem::create_directories(path.parent_path());
+
+    struct stat st;
+    if (stat(spec.path.c_str(), &st) == 0)
+      hasExistingData = true;
+
+    File file;
+    file.path = spec.path;
+    file.offset = offset;
+    file.length = spec.length;
+    file.lruPos = m_lru.end();
+    m_files.push_back(file);
+    m_fileOffsets.push_back(offset);
+
+    offset += spec.length;
+  }
+
+  m_mode = mode;
+  m_hasExistingData = hasExistingData;
+  m_length = offset;
+  m_pieceLength = pieceLength;
+
+  // create and preallocate every file now, so the layout is complete (including empty
+  // files, which block I/O never touches) and a full disk is reported up front
+  for (size_t i = 0; i < m_files.size(); ++i) {
+    if (m_mode == MODE_MMAP)
+      mapFile(m_files[i]);
+    else
+      getHandle(i);
+  }
+}
+
+static bool
+isSafeComponent(const std::string& component)
+{
+  return !component.empty() && component != "." && component != ".." &&
+         component.find('/') == std::string::npos &&
+         component.find('\0') == std::string::npos;
+}
+
+std::string
+Storage::makePayloadPath(const std::string& name, const std::vector<std::string>& components)
+{
+  if (!isSafeComponent(name))
+    throw Error("Unsafe torrent name " + name);
+
+  std::string path = name;
+  for (const auto& component : components) {
+    if (!isSafeComponent(component))
+      throw Error("Unsafe file path component " + component + " in " + name);
+    path += "/" + component;
+  }
+  return path;
+}
+
+void
+Storage::close()
+{
+  m_files.clear();
+  m_fileOffsets.clear();
+  m_lru.clear();
+  m_length = 0;
+}
+
+size_t
+Storage::findFile(int64_t offset) const
+{
+  // last file starting at or before offset; empty files share their start with the next one
+  auto it = std::upper_bound(m_fileOffsets.begin(), m_fileOffsets.end(), offset);
+  return (it - m_fileOffsets.begin()) - 1;
+}
+
+void
+Storage::mapFile(File& file)
+{
+  int fd = openFile(file);
+  bool isWritable = ((fcntl(fd, F_GETFL) & O_ACCMODE) == O_RDWR);
+
+  if (file.length > 0) {
+    // the mapping keeps the file referenced, the descriptor is not needed any more
+    int prot = isWritable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, file.length, prot, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED)
+      throw Error("Cannot map " + file.path + ": " + strerror(error));
+
+    file.mapping = make_shared<Mapping>(static_cast<uint8_t*>(addr), file.length, isWritable);
+  }
+  else
+    ::close(fd);
+}
+
+int
+Storage::openFile(const File& file)
+{
+  int fd = ::open(file.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1 && errno == EACCES) {
+    // read-only payload, we can still seed it
+    fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+      return fd;
+  }
+  if (fd == -1)
+    throw Error("Cannot open " + file.path + ": " + strerror(errno));
+
+  // reserve the whole file up front: no fragmentation, no ENOSPC halfway through
+  if (file.length > 0 && fallocate(fd, 0, 0, file.length) == -1) {
+    struct stat st;
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+      int error = errno;
+      ::close(fd);
+      throw Error("Cannot preallocate " + file.path + ": " + strerror(error));
+    }
+    if (fstat(fd, &st) == 0 && st.st_size < file.length && ftruncate(fd, file.length) == -1) {
+      int error = errno;
+      ::close(fd);
+      throw Error("Cannot resize " + file.path + ": " + strerror(error));
+    }
+  }
+
+  return fd;
+}
+
+shared_ptr<Storage::FileHandle>
+Storage::getHandle(size_t fileIndex)
+{
+  File& file = m_files[fileIndex];
+
+  if (file.handle != nullptr) {
+    m_lru.splice(m_lru.begin(), m_lru, file.lruPos);
+    return file.handle;
+  }
+
+  if (m_lru.size() >= MAX_OPEN_FILES) {
+    // segments still referencing the evicted handle keep its fd alive
+    m_files[m_lru.back()].handle.reset();
+    m_files[m_lru.back()].lruPos = m_lru.end();
+    m_lru.pop_back();
+  }
+
+  file.handle = make_shared<FileHandle>(openFile(file));
+  file.lruPos = m_lru.insert(m_lru.begin(), fileIndex);
+  return file.handle;
+}
+
+void
+Storage::locate(uint32_t index, uint32_t begin, size_t length, std::vector<Segment>& segments)
+{
+  segments.clear();
+
+  int64_t offset = getOffset(index, begin);
+  if (offset < 0 || offset >= m_length)
+    return;
+
+  if (static_cast<int64_t>(length) > m_length - offset)
+    length = m_length - offset;
+
+  for (size_t i = findFile(offset); length > 0; ++i) {
+    const File& file = m_files[i];
+    int64_t fileOffset = offset - file.offset;
+    if (fileOffset >= file.length)
+      continue; // empty file
+
+    Segment segment;
+    segment.offset = fileOffset;
+    segment.length = std::min<int64_t>(length, file.length - fileOffset);
+    if (m_mode == MODE_MMAP) {
+      segment.mapping = file.mapping;
+      segment.data = file.mapping->addr + fileOffset;
+    }
+    else {
+      segment.file = getHandle(i);
+      segment.data = nullptr;
+    }
+    segments.push_back(segment);
+
+    offset += segment.length;
+    length -= segment.length;
+  }
+}
+
+void
+Storage::writeBlock(uint32_t index, uint32_t begin, const BufferView& block)
+{
+  int64_t offset = getOffset(index, begin);
+  if (offset < 0 || offset + static_cast<int64_t>(block.size()) > m_length)
+    throw Error("Block is outside of the payload");
+
+  std::vector<Segment> segments;
+  locate(index, begin, block.size(), segments);
+
+  const uint8_t* data = block.buf();
+  for (const auto& segment : segments) {
+    if (m_mode == MODE_MMAP) {
+      if (!segment.mapping->isWritable)
+        throw Error("Cannot write block: payload file is read-only");
+      memcpy(segment.data, data, segment.length);
+      data += segment.length;
+      continue;
+    }
+
+    size_t written = 0;
+    while (written < segment.length) {
+      ssize_t res = pwrite(segment.file->fd, data + written, segment.length - written,
+                           segment.offset + written);
+      if (res == -1) {
+        if (errno == EINTR)
+          continue;
+        throw Error(std::string("Cannot write block: ") + strerror(errno));
+      }
+      written += res;
+    }
+    data += segment.length;
+  }
+}
+
+size_t
+Storage::readBlock(uint32_t index, uint32_t begin, uint8_t* buf, size_t length)
+{
+  std::vector<Segment> segments;
+  locate(index, begin, length, segments);
+
+  size_t total = 0;
+  for (const auto& segment : segments) {
+    if (m_mode == MODE_MMAP) {
+      memcpy(buf + total, segment.data, segment.length);
+      total += segment.length;
+      continue;
+    }
+
+    size_t nRead = 0;
+    while (nRead < segment.length) {
+      ssize_t res = pread(segment.file->fd, buf + total + nRead, segment.length - nRead,
+                          segment.offset + nRead);
+      if (res == -1) {
+        if (errno == EINTR)
+          continue;
+        throw Error(std::string("Cannot read block: ") + strerror(errno));
+      }
+      if (res == 0)
+        break;
+      nRead += res;
+    }
+    total += nRead;
+    if (nRead < segment.length)
+      break; // file is shorter than advertised
+  }
+
+  return total;
+}
+
+BufferPtr
+Storage::readBlock(uint32_t index, uint32_t begin, size_t length)
+{
+  auto block = make_shared<Buffer>(length);
+  if (length == 0)
+    return block;
+
+  block->resize(readBlock(index, begin, block->buf(), length));
+  return block;
+}
+
+BufferView
+Storage::getMappedBlock(uint32_t index, uint32_t begin, size_t length)
+{
+  std::vector<Segment> segments;
+  if (m_mode == MODE_MMAP)
+    locate(index, begin, length, segments);
+
+  if (segments.size() != 1)
+    return BufferView();
+
+  return BufferView(segments.front().data, segments.front().length);
+}
+
+void
+Storage::advise(Access access)
+{
+  for (const auto& file : m_files) {
+    if (static_cast<bool>(file.mapping))
+      madvise(file.mapping->addr, file.mapping->length,
+              access == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+    else if (static_cast<bool>(file.handle))
+      posix_fadvise(file.handle->fd, 0, 0,
+                    access == ACCESS_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+  }
+}
+
+void
+Storage::syncSegment(const Segment& segment)
+{
+  if (static_cast<bool>(segment.mapping)) {
+    // msync() wants a page aligned start
+    static const uintptr_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t start = reinterpret_cast<uintptr_t>(segment.data) & ~pageMask;
+    uintptr_t end = reinterpret_cast<uintptr_t>(segment.data) + segment.length;
+    msync(reinterpret_cast<void*>(start), end - start, MS_ASYNC);
+  }
+  else
+    sync_file_range(segment.file->fd, segment.offset, segment.length, SYNC_FILE_RANGE_WRITE);
+}
+
+void
+Storage::syncPiece(uint32_t index)
+{
+  std::vector<Segment> segments;
+  locate(index, 0, m_pieceLength, segments);
+
+  for (const auto& segment : segments)
+    syncSegment(segment);
+}
+
+void
+Storage::sync()
+{
+  for (const auto& file : m_files) {
+    if (static_cast<bool>(file.mapping))
+      msync(file.mapping->addr, file.mapping->length, MS_SYNC);
+    else if (static_cast<bool>(file.handle))
+      fdatasync(file.handle->fd);
+  }
+}
+
+} // namespace sbt
@@ -0,0 +1,362 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_STORAGE_STORAGE_HPP
+#define SBT_STORAGE_STORAGE_HPP
+
+#include "../common.hpp"
+#include "../util/buffer.hpp"
+
+#include <list>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Positional piece I/O on the torrent payload
+ *
+ * The payload is the concatenation of one or more files.  Each file is created (without
+ * truncation) and preallocated to its full length when the storage is opened, and every
+ * block is read or written with pread()/pwrite() at its position in the concatenation,
+ * so pieces can arrive in any order.
+ *
+ * A global offset is mapped to a file by binary search over the files' start offsets,
+ * and a block that crosses file boundaries is split into one segment per file, so the
+ * cost of an access does not depend on how many files the torrent has.  At most
+ * MAX_OPEN_FILES descriptors are kept open; the least recently used one is closed
+ * first and reopened on demand.
+ *
+ * In MODE_MMAP every file is mapped once at open instead: blocks are copied straight
+ * into and out of the page cache, and getMappedBlock() gives direct access to the
+ * mapped bytes, e.g. to hash a piece or send it without another copy.
+ */
+class Storage
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief An open payload file, closed when the last reference goes away
+   *
+   * Segments hold a reference, so a descriptor that is still being used (for instance
+   * by a queued sendfile()) survives being evicted from the open-file cache.
+   */
+  class FileHandle
+  {
+  public:
+    explicit
+    FileHandle(int fd)
+      : fd(fd)
+    {
+    }
+
+    ~FileHandle();
+
+    FileHandle(const FileHandle&) = delete;
+
+    FileHandle&
+    operator=(const FileHandle&) = delete;
+
+  public:
+    const int fd;
+  };
+
+  /**
+   * @brief A mapped payload file, unmapped when the last reference goes away
+   */
+  class Mapping
+  {
+  public:
+    Mapping(uint8_t* addr, size_t length, bool isWritable)
+      : addr(addr)
+      , length(length)
+      , isWritable(isWritable)
+    {
+    }
+
+    ~Mapping();
+
+    Mapping(const Mapping&) = delete;
+
+    Mapping&
+    operator=(const Mapping&) = delete;
+
+  public:
+    uint8_t* const addr;
+    const size_t length;
+    const bool isWritable; // false for a read-only payload
+  };
+
+  enum Mode {
+    MODE_PREAD, // pread()/pwrite() on lazily opened descriptors
+    MODE_MMAP   // memcpy() on files mapped for the lifetime of the storage
+  };
+
+  enum Access {
+    ACCESS_SEQUENTIAL, // e.g. while hashing the payload
+    ACCESS_RANDOM      // e.g. while seeding
+  };
+
+  /**
+   * @brief A file of the payload, in payload order
+   */
+  struct FileSpec
+  {
+    std::string path;
+    int64_t length;
+  };
+
+  /**
+   * @brief The part of a block that lies in a single file
+   *
+   * In MODE_PREAD @p file is set, in MODE_MMAP @p mapping and @p data are.
+   */
+  struct Segment
+  {
+    shared_ptr<FileHandle> file;
+    shared_ptr<Mapping> mapping;
+    uint8_t* data; // the segment in the mapping
+    int64_t offset; // offset within the file
+    size_t length;
+  };
+
+  static const size_t MAX_OPEN_FILES;
+
+public:
+  Storage();
+
+  ~Storage();
+
+  Storage(const Storage&) = delete;
+
+  Storage&
+  operator=(const Storage&) = delete;
+
+  /**
+   * @brief Open a single-file payload
+   * @param path payload file name
+   * @param length total payload length in bytes
+   * @param pieceLength nominal piece length from the meta info
+   */
+  void
+  open(const std::string& path, int64_t length, int64_t pieceLength,
+       Mode mode = MODE_PREAD);
+
+  /**
+   * @brief Open a payload made of @p files, creating missing directories
+   */
+  void
+  open(const std::vector<FileSpec>& files, int64_t pieceLength, Mode mode = MODE_PREAD);
+
+  /**
+   * @brief Build the path of a payload file from the names in the meta info
+   *
+   * The names come from the .torrent and must not lead out of the download directory:
+   * each of them has to be a single path component.
+   *
+   * @param name name of the torrent, the file of a single-file torrent
+   * @param components path of the file below @p name, empty for a single-file torrent
+   * @return relative path
+   * @throw Error if a name is empty, ".", "..", or contains '/' (which includes
+   *        absolute paths) or a NUL byte
+   */
+  static std::string
+  makePayloadPath(const std::string& name, const std::vector<std::string>& components);
+
+  void
+  close();
+
+  bool
+  isOpen() const
+  {
+    return !m_files.empty();
+  }
+
+  /**
+   * @brief Whether any payload file already existed when the storage was opened
+   */
+  bool
+  hasExistingData() const
+  {
+    return m_hasExistingData;
+  }
+
+  int64_t
+  getLength() const
+  {
+    return m_length;
+  }
+
+  Mode
+  getMode() const
+  {
+    return m_mode;
+  }
+
+  bool
+  isMapped() const
+  {
+    return m_mode == MODE_MMAP;
+  }
+
+  size_t
+  getNumFiles() const
+  {
+    return m_files.size();
+  }
+
+  const std::string&
+  getFilePath(size_t fileIndex) const
+  {
+    return m_files[fileIndex].path;
+  }
+
+  /**
+   * @brief Nominal piece length; the last piece may be shorter
+   */
+  int64_t
+  getPieceLength() const
+  {
+    return m_pieceLength;
+  }
+
+  /**
+   * @brief Write @p block at offset @p begin of piece @p index
+   */
+  void
+  writeBlock(uint32_t index, uint32_t begin, const BufferView& block);
+
+  /**
+   * @brief Read up to @p length bytes at offset @p begin of piece @p index into @p buf
+   * @return number of bytes read; less than @p length only at the end of the payload
+   */
+  size_t
+  readBlock(uint32_t index, uint32_t begin, uint8_t* buf, size_t length);
+
+  /**
+   * @brief Read a block into a new Buffer
+   */
+  BufferPtr
+  readBlock(uint32_t index, uint32_t begin, size_t length);
+
+  /**
+   * @brief Split the block at offset @p begin of piece @p index into per-file segments
+   *
+   * The block is clamped to the end of the payload.  Used e.g. to sendfile() a block.
+   */
+  void
+  locate(uint32_t index, uint32_t begin, size_t length, std::vector<Segment>& segments);
+
+  /**
+   * @brief The mapped bytes of a block, clamped to the end of the payload
+   *
+   * Empty unless the storage is mapped and the block lies within a single file; the
+   * view stays valid until the storage is closed.
+   */
+  BufferView
+  getMappedBlock(uint32_t index, uint32_t begin, size_t length);
+
+  /**
+   * @brief Tell the kernel how the payload is about to be accessed
+   *
+   * Sets the readahead policy with madvise() for mapped files, posix_fadvise() otherwise.
+   */
+  void
+  advise(Access access);
+
+  /**
+   * @brief Start writing back the bytes of piece @p index, without waiting for the disk
+   *
+   * msync(MS_ASYNC) of the piece's pages when mapped, sync_file_range() of its file
+   * ranges otherwise.  Only sync() makes the data durable.
+   */
+  void
+  syncPiece(uint32_t index);
+
+  /**
+   * @brief Payload offset of byte @p begin of piece @p index
+   */
+  int64_t
+  getOffset(uint32_t index, uint32_t begin) const
+  {
+    return static_cast<int64_t>(index) * m_pieceLength + begin;
+  }
+
+  /**
+   * @brief Flush written data of all files to disk
+   */
+  void
+  sync();
+
+private:
+  struct File
+  {
+    std::string path;
+    int64_t offset; // in the payload
+    int64_t length;
+    shared_ptr<FileHandle> handle;
+    std::list<size_t>::iterator lruPos;
+    shared_ptr<Mapping> mapping;
+  };
+
+  /**
+   * @brief Index of the file that holds payload offset @p offset
+   */
+  size_t
+  findFile(int64_t offset) const;
+
+  shared_ptr<FileHandle>
+  getHandle(size_t fileIndex);
+
+  /**
+   * @brief Open @p file, creating and preallocating it if necessary
+   */
+  int
+  openFile(const File& file);
+
+  void
+  mapFile(File& file);
+
+  void
+  syncSegment(const Segment& segment);
+
+private:
+  std::vector<File> m_files;
+  std::vector<int64_t> m_fileOffsets; // start offset of each file, for binary search
+  std::list<size_t> m_lru; // open files, most recently used first
+
+  Mode m_mode;
+  bool m_hasExistingData;
+  int64_t m_length;
+  int64_t m_pieceLength;
+};
+
+} // namespace sbt
+
+#endif // SBT_STORAGE_STORAGE_HPP
@@ -31,8 +31,17 @@ const std::string TrackerRequestParam::STARTED("started");
 const std::string TrackerRequestParam::STOPPED("stopped");
 const std::string TrackerRequestParam::COMPLETED("completed");
 
+TrackerRequestParam::TrackerRequestParam()
+  : m_port(0)
+  , m_uploaded(0)
+  , m_downloaded(0)
+  , m_left(0)
+  , m_isCompact(true)
+{
+}
+
 std::string
-TrackerRequestParam::encode()
+TrackerRequestParam::encode() const
 {
   std::stringstream ss;
 
@@ -63,6 +72,9 @@ TrackerRequestParam::encode()
   else if (!m_event.empty())
     throw Error("Wrong event");
 
+  if (m_isCompact)
+    ss << "&compact=1";
+
   return ss.str();
 }
 
@@ -72,6 +84,9 @@ TrackerRequestParam::decode(const std::string& input)
   if (input[0] != '?')
     throw Error("Wrong request param");
 
+  // a request without the key asks for the dictionary model
+  m_isCompact = false;
+
   std::string paramStr = input.substr(1);
   boost::tokenizer<boost::char_separator<char>> tokens(paramStr,
                                                        boost::char_separator<char>("&"));
@@ -108,6 +123,8 @@ TrackerRequestParam::decode(const std::string& input)
         else
           throw Error("Wrong event value");
     }
+    else if (key == "compact")
+      m_isCompact = (value == "1");
     else
       throw Error("Wrong param key");
   }
@@ -131,6 +148,7 @@ TrackerRequestParam::print(std::ostream& os)
   os << "downloaded: " << m_downloaded << std::endl;
   os << "left: " << m_left << std::endl;
   os << "event: " << m_event << std::endl;
+  os << "compact: " << m_isCompact << std::endl;
 }
 
 } // namespace sbt
@@ -41,6 +41,8 @@ public:
   };
 
 public:
+  TrackerRequestParam();
+
   void
   setInfoHash(ConstBufferPtr infoHash)
   {
@@ -137,8 +139,23 @@ public:
     return m_event;
   }
 
+  /**
+   * @brief Ask the tracker for the compact peer list (BEP 23), on by default
+   */
+  void
+  setCompact(bool isCompact)
+  {
+    m_isCompact = isCompact;
+  }
+
+  bool
+  isCompact() const
+  {
+    return m_isCompact;
+  }
+
   std::string
-  encode();
+  encode() const;
 
   void
   decode(const std::string& input);
@@ -160,6 +177,7 @@ private:
   uint64_t m_downloaded;
   uint64_t m_left;
   std::string m_event;
+  bool m_isCompact;
 };
 
 } // namespace sbt
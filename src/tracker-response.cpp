@@ -22,6 +22,9 @@
 #include "tracker-response.hpp"
 #include "util/buffer-stream.hpp"
 
+#include <arpa/inet.h>
+#include <cstring>
+
 namespace sbt {
 
 const std::string PeerInfo::PEER_ID("peer id");
@@ -31,6 +34,67 @@ const std::string PeerInfo::PORT("port");
 const std::string TrackerResponse::FAILURE("failure");
 const std::string TrackerResponse::INTERVAL("interval");
 const std::string TrackerResponse::PEERS("peers");
+const std::string TrackerResponse::PEERS6("peers6");
+const std::string TrackerResponse::COMPLETE("complete");
+const std::string TrackerResponse::INCOMPLETE("incomplete");
+
+bool
+PeerEndpoint::setIp(const std::string& ip)
+{
+  std::memset(address, 0, sizeof(address));
+  if (inet_pton(AF_INET, ip.c_str(), address) == 1)
+    family = AF_INET;
+  else if (inet_pton(AF_INET6, ip.c_str(), address) == 1)
+    family = AF_INET6;
+  else
+    return false;
+  return true;
+}
+
+std::string
+PeerEndpoint::getIp() const
+{
+  char ip[INET6_ADDRSTRLEN];
+  if (inet_ntop(family, address, ip, sizeof(ip)) == nullptr)
+    return "";
+  return ip;
+}
+
+socklen_t
+PeerEndpoint::toSockaddr(sockaddr_storage& addr) const
+{
+  std::memset(&addr, 0, sizeof(addr));
+  if (family == AF_INET6) {
+    sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(&addr);
+    in6->sin6_family = AF_INET6;
+    in6->sin6_port = htons(port);
+    std::memcpy(&in6->sin6_addr, address, 16);
+    return sizeof(sockaddr_in6);
+  }
+
+  sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&addr);
+  in->sin_family = AF_INET;
+  in->sin_port = htons(port);
+  std::memcpy(&in->sin_addr, address, 4);
+  return sizeof(sockaddr_in);
+}
+
+bool
+PeerEndpoint::operator==(const PeerEndpoint& other) const
+{
+  return family == other.family && port == other.port &&
+         std::memcmp(address, other.address, sizeof(address)) == 0;
+}
+
+bool
+PeerEndpoint::operator<(const PeerEndpoint& other) const
+{
+  if (family != other.family)
+    return family < other.family;
+  if (port != other.port)
+    return port < other.port;
+  return std::memcmp(address, other.address, sizeof(address)) < 0;
+}
 
 shared_ptr<bencoding::Dictionary>
 PeerInfo::encode()
@@ -46,21 +110,30 @@ PeerInfo::encode()
 void
 PeerInfo::decode(const bencoding::Dictionary& dict)
 {
-  auto idEntry = dict.get(PEER_ID);
-  if (static_cast<bool>(idEntry))
-    peerId = dynamic_pointer_cast<bencoding::String>(idEntry)->toString();
+  OBufferStream os;
+  dict.wireEncode(os);
+  bencoding::Document document(os.buf());
+  decode(document.getRoot());
+}
+
+void
+PeerInfo::decode(const bencoding::Value& dict)
+{
+  auto idEntry = dict.get(PEER_ID, bencoding::TYPE_STRING);
+  if (idEntry != nullptr)
+    peerId = idEntry->toString();
   else
     throw TrackerResponse::Error("No peer id in peer info");
 
-  auto ipEntry = dict.get(IP);
-  if (static_cast<bool>(ipEntry))
-    ip = dynamic_pointer_cast<bencoding::String>(ipEntry)->toString();
+  auto ipEntry = dict.get(IP, bencoding::TYPE_STRING);
+  if (ipEntry != nullptr)
+    ip = ipEntry->toString();
   else
     throw TrackerResponse::Error("No ip in peer info");
 
-  auto portEntry = dict.get(PORT);
-  if (static_cast<bool>(portEntry))
-    port = dynamic_pointer_cast<bencoding::Integer>(portEntry)->getValue();
+  auto portEntry = dict.get(PORT, bencoding::TYPE_INTEGER);
+  if (portEntry != nullptr)
+    port = portEntry->getInteger();
   else
     throw TrackerResponse::Error("No port in peer info");
 }
@@ -68,18 +141,26 @@ PeerInfo::decode(const bencoding::Dictionary& dict)
 TrackerResponse::TrackerResponse()
   : m_isFailure(true)
   , m_failure("response is not initialize")
+  , m_interval(0)
+  , m_complete(0)
+  , m_incomplete(0)
 {
 }
 
 TrackerResponse::TrackerResponse(uint64_t interval)
   : m_isFailure(false)
   , m_interval(interval)
+  , m_complete(0)
+  , m_incomplete(0)
 {
 }
 
 TrackerResponse::TrackerResponse(const std::string& failure)
   : m_isFailure(true)
   , m_failure(failure)
+  , m_interval(0)
+  , m_complete(0)
+  , m_incomplete(0)
 {
 }
 
@@ -90,6 +171,12 @@ TrackerResponse::addPeer(const PeerInfo& peer)
     throw Error("Cannot add peer in failure response");
 
   m_peers.push_back(peer);
+
+  PeerEndpoint endpoint;
+  if (endpoint.setIp(peer.ip)) {
+    endpoint.port = peer.port;
+    m_endpoints.push_back(endpoint);
+  }
 }
 
 shared_ptr<bencoding::Dictionary>
@@ -114,33 +201,91 @@ TrackerResponse::encode()
 
 void
 TrackerResponse::decode(const bencoding::Dictionary& response)
+{
+  OBufferStream os;
+  response.wireEncode(os);
+  bencoding::Document document(os.buf());
+  decode(document.getRoot());
+}
+
+void
+TrackerResponse::wireDecode(const BufferView& wire)
+{
+  bencoding::Document document(wire);
+  decode(document.getRoot());
+}
+
+void
+TrackerResponse::decode(const bencoding::Value& response)
 {
   m_peers.clear();
+  m_endpoints.clear();
 
-  auto failure = response.get(FAILURE);
-  if (static_cast<bool>(failure)) {
+  auto failure = response.get(FAILURE, bencoding::TYPE_STRING);
+  if (failure != nullptr) {
     m_isFailure = true;
-    m_failure = dynamic_pointer_cast<bencoding::String>(failure)->toString();
+    m_failure = failure->toString();
   }
   else {
     m_isFailure = false;
 
-    auto interval = response.get(INTERVAL);
-    if (static_cast<bool>(interval))
-      m_interval = dynamic_pointer_cast<bencoding::Integer>(interval)->getValue();
+    auto interval = response.get(INTERVAL, bencoding::TYPE_INTEGER);
+    if (interval != nullptr)
+      m_interval = interval->getInteger();
     else
       throw TrackerResponse::Error("No interval in positive tracker response ");
 
+    auto complete = response.get(COMPLETE, bencoding::TYPE_INTEGER);
+    m_complete = complete != nullptr ? complete->getInteger() : 0;
+    auto incomplete = response.get(INCOMPLETE, bencoding::TYPE_INTEGER);
+    m_incomplete = incomplete != nullptr ? incomplete->getInteger() : 0;
+
     auto peers = response.get(PEERS);
-    if (static_cast<bool>(peers)) {
-      for (auto peer : *dynamic_pointer_cast<bencoding::List>(peers)) {
+    auto peers6 = response.get(PEERS6, bencoding::TYPE_STRING);
+    if (peers == nullptr && peers6 == nullptr)
+      throw TrackerResponse::Error("No peers in positive tracker response");
+
+    if (peers != nullptr && peers->isString())
+      addCompactPeers(peers->getString(), AF_INET);
+    else if (peers != nullptr && peers->isList()) {
+      auto list = peers->getList();
+      m_peers.reserve(list.size());
+      m_endpoints.reserve(list.size());
+      for (const auto& peer : list) {
         PeerInfo info;
-        info.decode(*dynamic_pointer_cast<const bencoding::Dictionary>(peer));
-        m_peers.push_back(info);
+        info.decode(peer);
+        addPeer(info);
       }
     }
-    else
-      throw TrackerResponse::Error("No peers in positive tracker response");
+    else if (peers != nullptr)
+      throw TrackerResponse::Error("Wrong type of peers in positive tracker response");
+
+    if (peers6 != nullptr)
+      addCompactPeers(peers6->getString(), AF_INET6);
+  }
+}
+
+void
+TrackerResponse::addCompactPeers(const BufferView& peers, uint8_t family)
+{
+  // 4 or 16 address bytes followed by a big-endian port
+  size_t addressLength = family == AF_INET6 ? 16 : 4;
+  size_t entryLength = addressLength + 2;
+  if (peers.size() % entryLength != 0)
+    throw TrackerResponse::Error("Compact peer list is not a multiple of " +
+                                 std::to_string(entryLength) + " bytes");
+
+  size_t nPeers = peers.size() / entryLength;
+  size_t offset = m_endpoints.size();
+  m_endpoints.resize(offset + nPeers);
+
+  const uint8_t* entry = peers.buf();
+  for (size_t i = 0; i < nPeers; i++, entry += entryLength) {
+    PeerEndpoint& endpoint = m_endpoints[offset + i];
+    endpoint.family = family;
+    std::memcpy(endpoint.address, entry, addressLength);
+    std::memset(endpoint.address + addressLength, 0, sizeof(endpoint.address) - addressLength);
+    endpoint.port = (static_cast<uint16_t>(entry[addressLength]) << 8) | entry[addressLength + 1];
   }
 }
 
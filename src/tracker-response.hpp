@@ -24,10 +24,49 @@
 
 #include "util/buffer.hpp"
 #include "util/bencoding.hpp"
+#include "util/bencoding-document.hpp"
 #include <vector>
 
+#include <netinet/in.h>
+
 namespace sbt {
 
+/**
+ * @brief Address of a peer in the form a compact tracker response carries it (BEP 23)
+ *
+ * The struct is trivially copyable, so a list of thousands of peers decodes into one flat
+ * array without per-peer allocations.
+ */
+struct PeerEndpoint
+{
+  uint8_t family;       // AF_INET or AF_INET6
+  uint16_t port;        // host byte order
+  uint8_t address[16];  // network byte order, an IPv4 address uses the first 4 bytes
+
+  /**
+   * @brief Parse a textual IPv4 or IPv6 address
+   * @return false if @p ip is not an address literal
+   */
+  bool
+  setIp(const std::string& ip);
+
+  std::string
+  getIp() const;
+
+  /**
+   * @brief Fill @p addr for connect()
+   * @return the length of the filled address
+   */
+  socklen_t
+  toSockaddr(sockaddr_storage& addr) const;
+
+  bool
+  operator==(const PeerEndpoint& other) const;
+
+  bool
+  operator<(const PeerEndpoint& other) const;
+};
+
 class PeerInfo
 {
 public:
@@ -37,6 +76,9 @@ public:
   void
   decode(const bencoding::Dictionary& dict);
 
+  void
+  decode(const bencoding::Value& dict);
+
 public:
   std::string peerId;
   std::string ip;
@@ -69,19 +111,19 @@ public:
   TrackerResponse(const std::string& failure);
 
   bool
-  isFailure()
+  isFailure() const
   {
     return m_isFailure;
   }
 
   std::string
-  getFailure()
+  getFailure() const
   {
     return m_failure;
   }
 
   uint64_t
-  getInterval()
+  getInterval() const
   {
     return m_interval;
   }
@@ -95,21 +137,79 @@ public:
     return m_peers;
   }
 
+  /**
+   * @brief Get the addresses of all peers in the response
+   *
+   * Compact responses only fill this list, the peer infos of a dictionary model response
+   * are also listed here.
+   */
+  const std::vector<PeerEndpoint>&
+  getEndpoints() const
+  {
+    return m_endpoints;
+  }
+
+  /**
+   * @brief Append peers in compact form, 6 (IPv4) or 18 (IPv6) bytes each
+   */
+  void
+  addCompactPeers(const BufferView& peers, uint8_t family);
+
+  /**
+   * @brief Number of seeders in the swarm, 0 if the tracker did not say
+   */
+  uint64_t
+  getComplete() const
+  {
+    return m_complete;
+  }
+
+  /**
+   * @brief Number of leechers in the swarm, 0 if the tracker did not say
+   */
+  uint64_t
+  getIncomplete() const
+  {
+    return m_incomplete;
+  }
+
+  void
+  setSwarmSize(uint64_t complete, uint64_t incomplete)
+  {
+    m_complete = complete;
+    m_incomplete = incomplete;
+  }
+
   shared_ptr<bencoding::Dictionary>
   encode();
 
   void
   decode(const bencoding::Dictionary& response);
 
+  void
+  decode(const bencoding::Value& response);
+
+  /**
+   * @brief Parse the bencoded body of a tracker response
+   */
+  void
+  wireDecode(const BufferView& wire);
+
 private:
   static const std::string FAILURE;
   static const std::string INTERVAL;
   static const std::string PEERS;
+  static const std::string PEERS6;
+  static const std::string COMPLETE;
+  static const std::string INCOMPLETE;
 
   bool m_isFailure;
   std::string m_failure;
   uint64_t m_interval; // seconds
+  uint64_t m_complete;
+  uint64_t m_incomplete;
   std::vector<PeerInfo> m_peers;
+  std::vector<PeerEndpoint> m_endpoints;
 };
 
 } // namespace sbt
@@ -0,0 +1,550 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "http-tracker.hpp"
+#include "../http/http-request.hpp"
+#include "../http/http-response.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace sbt {
+
+const uint64_t HttpTracker::DEFAULT_TIMEOUT_MS = 30000;
+const size_t HttpTracker::MAX_RESPONSE_LENGTH = 4 * 1024 * 1024;
+
+HttpTracker::HttpTracker(net::Reactor& reactor, net::Resolver& resolver)
+  : m_reactor(reactor)
+  , m_resolver(resolver)
+  , m_timeoutMs(DEFAULT_TIMEOUT_MS)
+  , m_addressIndex(0)
+  , m_state(STATE_IDLE)
+  , m_sock(-1)
+  , m_timer(0)
+  , m_generation(0)
+  , m_token(make_shared<int>(0))
+  , m_nRequestsSent(0)
+  , m_nSent(0)
+  , m_nScanned(0)
+  , m_headerLength(0)
+  , m_framing(FRAMING_CLOSE)
+  , m_contentLength(0)
+  , m_nDecoded(0)
+  , m_responseLength(0)
+{
+}
+
+HttpTracker::~HttpTracker()
+{
+  cancel();
+}
+
+void
+HttpTracker::setTarget(const std::string& host, const std::string& port, const std::string& path)
+{
+  cancel();
+
+  m_host = host;
+  m_port = port;
+  m_path = path;
+  m_addresses.clear();
+}
+
+void
+HttpTracker::announce(const TrackerRequestParam& param,
+                      const ResponseCallback& onResponse, const ErrorCallback& onError)
+{
+  std::string host = m_host;
+  request(m_path, param.encode(),
+          [onResponse, onError, host] (const BufferView& body) {
+            TrackerResponse response;
+            try {
+              response.wireDecode(body);
+            }
+            catch (const std::exception& e) {
+              if (onError)
+                onError("Malformed response of tracker " + host + ": " + e.what());
+              return;
+            }
+            if (onResponse)
+              onResponse(response);
+          },
+          onError);
+}
+
+void
+HttpTracker::scrape(const ScrapeRequestParam& param,
+                    const ScrapeCallback& onResponse, const ErrorCallback& onError)
+{
+  std::string path = getScrapePath(m_path);
+  if (path.empty())
+    throw Error("Tracker " + m_host + " does not support scrape");
+
+  std::string host = m_host;
+  request(path, param.encode(),
+          [onResponse, onError, host] (const BufferView& body) {
+            ScrapeResponse response;
+            try {
+              response.wireDecode(body);
+            }
+            catch (const std::exception& e) {
+              if (onError)
+                onError("Malformed scrape response of tracker " + host + ": " + e.what());
+              return;
+            }
+            if (onResponse)
+              onResponse(response);
+          },
+          onError);
+}
+
+std::string
+HttpTracker::getScrapePath(const std::string& announcePath)
+{
+  // the last segment is searched before the query, which is kept as it is
+  size_t queryPos = announcePath.find('?');
+  size_t slashPos = announcePath.rfind('/', queryPos);
+  if (slashPos == std::string::npos || announcePath.compare(slashPos + 1, 8, "announce") != 0)
+    return "";
+
+  return announcePath.substr(0, slashPos + 1) + "scrape" + announcePath.substr(slashPos + 9);
+}
+
+void
+HttpTracker::cancel()
+{
+  m_transactions.clear();
+  disconnect();
+
+  stopTimer();
+}
+
+void
+HttpTracker::request(const std::string& path, const std::string& query,
+                     const BodyCallback& onBody, const ErrorCallback& onError)
+{
+  // the announce URL may already carry a query, e.g. a passkey
+  std::string target = path + query;
+  if (path.find('?') != std::string::npos)
+    target[path.size()] = '&';
+
+  HttpRequest request;
+  request.setMethod(HttpRequest::GET);
+  request.setHost(m_host);
+  request.setPort(boost::lexical_cast<uint16_t>(m_port));
+  request.setPath(target);
+  request.setVersion("1.1");
+
+  Transaction transaction;
+  transaction.request.resize(request.getTotalLength());
+  request.formatRequest(reinterpret_cast<char*>(transaction.request.buf()));
+  transaction.onBody = onBody;
+  transaction.onError = onError;
+  transaction.isRetry = false;
+  m_transactions.push_back(std::move(transaction));
+
+  if (m_transactions.size() == 1)
+    startTimer();
+
+  if (m_state == STATE_IDLE)
+    open();
+  else if (m_state == STATE_CONNECTED)
+    sendRequests();
+}
+
+void
+HttpTracker::startTimer()
+{
+  stopTimer();
+
+  // bounds the wait for the oldest request, resolving and connecting included
+  m_timer = m_reactor.schedule(m_timeoutMs, [this] {
+      m_timer = 0;
+      failAll("Tracker " + m_host + " timed out");
+    });
+}
+
+void
+HttpTracker::stopTimer()
+{
+  if (m_timer != 0) {
+    m_reactor.cancel(m_timer);
+    m_timer = 0;
+  }
+}
+
+void
+HttpTracker::open()
+{
+  m_nRequestsSent = 0;
+  m_nSent = 0;
+
+  if (!m_addresses.empty()) {
+    m_addressIndex = 0;
+    connect();
+    return;
+  }
+
+  m_state = STATE_RESOLVING;
+  uint64_t generation = m_generation;
+  weak_ptr<int> token = m_token;
+  m_resolver.resolve(m_host, m_port,
+                     [this, token, generation] (const std::vector<net::Address>& addresses,
+                                                const std::string& error) {
+      if (token.expired() || generation != m_generation)
+        return;
+      handleResolved(addresses, error);
+    });
+}
+
+void
+HttpTracker::handleResolved(const std::vector<net::Address>& addresses, const std::string& error)
+{
+  if (addresses.empty()) {
+    failAll(error);
+    return;
+  }
+
+  m_addresses = addresses;
+  m_addressIndex = 0;
+  connect();
+}
+
+void
+HttpTracker::connect()
+{
+  // try the addresses in turn until one accepts
+  while (m_addressIndex < m_addresses.size()) {
+    const net::Address& address = m_addresses[m_addressIndex++];
+
+    m_sock = socket(address.getFamily(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_sock == -1)
+      continue;
+    net::Reactor::setNonBlocking(m_sock);
+
+    if (::connect(m_sock, address.get(), address.length) == 0 || errno == EINPROGRESS) {
+      m_state = STATE_CONNECTING;
+      m_reactor.add(m_sock, net::Reactor::EVENT_READ | net::Reactor::EVENT_WRITE,
+                    bind(&HttpTracker::handleEvent, this, std::placeholders::_1));
+      return;
+    }
+
+    close(m_sock);
+    m_sock = -1;
+  }
+
+  m_addresses.clear();
+  failAll("Cannot connect to tracker " + m_host);
+}
+
+void
+HttpTracker::handleEvent(uint32_t events)
+{
+  if (m_state == STATE_CONNECTING) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(m_sock, SOL_SOCKET, SO_ERROR, &error, &length) == -1)
+      error = errno;
+    if (error == 0 && (events & net::Reactor::EVENT_WRITE) == 0)
+      return;
+
+    if (error != 0) {
+      m_reactor.remove(m_sock);
+      close(m_sock);
+      m_sock = -1;
+      connect();
+      return;
+    }
+
+    m_state = STATE_CONNECTED;
+  }
+
+  uint64_t generation = m_generation;
+  sendRequests();
+  if (generation == m_generation)
+    receiveResponses();
+}
+
+void
+HttpTracker::sendRequests()
+{
+  // pipelined: everything queued goes out without waiting for the answers
+  while (m_nRequestsSent < m_transactions.size()) {
+    const Buffer& request = m_transactions[m_nRequestsSent].request;
+    ssize_t res = send(m_sock, request.buf() + m_nSent, request.size() - m_nSent, MSG_NOSIGNAL);
+    if (res > 0) {
+      m_nSent += res;
+      if (m_nSent == request.size()) {
+        ++m_nRequestsSent;
+        m_nSent = 0;
+      }
+    }
+    else if (res == -1 && errno == EINTR)
+      continue;
+    else if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+    else {
+      handleDisconnect("Cannot send to tracker " + m_host + ": " + strerror(errno));
+      return;
+    }
+  }
+}
+
+void
+HttpTracker::receiveResponses()
+{
+  uint8_t buf[16 * 1024];
+  bool isClosed = false;
+
+  while (true) {
+    ssize_t res = recv(m_sock, buf, sizeof(buf), 0);
+    if (res > 0) {
+      m_input.insert(m_input.end(), buf, buf + res);
+      if (m_input.size() > MAX_RESPONSE_LENGTH) {
+        failAll("Response of tracker " + m_host + " is too long");
+        return;
+      }
+    }
+    else if (res == 0) {
+      isClosed = true;
+      break;
+    }
+    else if (errno == EINTR)
+      continue;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else {
+      handleDisconnect("Cannot receive from tracker " + m_host + ": " + strerror(errno));
+      return;
+    }
+  }
+
+  uint64_t generation = m_generation;
+  while (true) {
+    if (m_nRequestsSent == 0) {
+      if (!m_input.empty()) {
+        handleDisconnect("Unexpected data from tracker " + m_host);
+        return;
+      }
+      break;
+    }
+    if (m_input.empty() && !isClosed)
+      break;
+
+    bool isComplete = false;
+    try {
+      isComplete = parseResponse(isClosed);
+    }
+    catch (const std::exception& e) {
+      // the stream is out of step, only a new connection can recover
+      Transaction transaction = std::move(m_transactions.front());
+      m_transactions.pop_front();
+      disconnect();
+      if (!m_transactions.empty()) {
+        startTimer();
+        open();
+      }
+      if (transaction.onError)
+        transaction.onError("Malformed response of tracker " + m_host + ": " + e.what());
+      return;
+    }
+
+    if (!isComplete)
+      break;
+
+    completeRequest();
+    if (generation != m_generation)
+      return;
+  }
+
+  if (isClosed)
+    handleDisconnect("Tracker " + m_host + " closed the connection early");
+}
+
+bool
+HttpTracker::parseResponse(bool isClosed)
+{
+  if (m_headerLength == 0) {
+    if (m_input.empty())
+      return false;
+
+    // resume the search where the last one stopped, a terminator may straddle reads
+    size_t from = m_nScanned < 3 ? 0 : m_nScanned - 3;
+    const void* end = memmem(m_input.buf() + from, m_input.size() - from, "\r\n\r\n", 4);
+    m_nScanned = m_input.size();
+    if (end == nullptr)
+      return false;
+
+    m_headerLength = static_cast<const uint8_t*>(end) - m_input.buf() + 4;
+    m_header = HttpResponse();
+    m_header.parseResponse(reinterpret_cast<const char*>(m_input.buf()), m_headerLength);
+    m_body.clear();
+
+    const std::string& code = m_header.getStatusCode();
+    std::string contentLength = m_header.findHeader("Content-Length");
+    if (code == "204" || code == "304") {
+      m_framing = FRAMING_LENGTH;
+      m_contentLength = 0;
+    }
+    else if (m_header.isChunked()) {
+      m_framing = FRAMING_CHUNKED;
+      m_chunked.reset();
+      m_nDecoded = m_headerLength;
+    }
+    else if (!contentLength.empty()) {
+      m_framing = FRAMING_LENGTH;
+      m_contentLength = boost::lexical_cast<size_t>(contentLength);
+    }
+    else
+      m_framing = FRAMING_CLOSE;  // HTTP/1.0 style, the body ends with the connection
+  }
+
+  switch (m_framing) {
+  case FRAMING_LENGTH:
+    if (m_input.size() - m_headerLength < m_contentLength)
+      return false;
+    m_body.assign(m_input.begin() + m_headerLength,
+                  m_input.begin() + m_headerLength + m_contentLength);
+    m_responseLength = m_headerLength + m_contentLength;
+    return true;
+
+  case FRAMING_CHUNKED:
+    m_nDecoded += m_chunked.decode(m_input.buf() + m_nDecoded, m_input.size() - m_nDecoded,
+                                   m_body);
+    if (!m_chunked.isComplete())
+      return false;
+    m_responseLength = m_nDecoded;
+    return true;
+
+  default:
+    if (!isClosed)
+      return false;
+    m_body.assign(m_input.begin() + m_headerLength, m_input.end());
+    m_responseLength = m_input.size();
+    return true;
+  }
+}
+
+void
+HttpTracker::completeRequest()
+{
+  Transaction transaction = std::move(m_transactions.front());
+  m_transactions.pop_front();
+  --m_nRequestsSent;
+
+  bool isKeepAlive = m_header.isKeepAlive() && m_framing != FRAMING_CLOSE;
+  std::string status = m_header.getStatusCode();
+  std::string reason = "Tracker " + m_host + " replied " + status + " " + m_header.getStatusMsg();
+
+  Buffer body;
+  body.swap(m_body);
+  m_input.erase(m_input.begin(), m_input.begin() + m_responseLength);
+  m_nScanned = 0;
+  m_headerLength = 0;
+
+  if (!isKeepAlive)
+    disconnect();
+
+  if (m_transactions.empty())
+    stopTimer();
+  else {
+    startTimer();
+    // requests the tracker did not answer before closing go out on a new connection
+    if (!isKeepAlive)
+      open();
+  }
+
+  // the state is consistent again, the callbacks may queue the next request
+  if (status != "200") {
+    if (transaction.onError)
+      transaction.onError(reason);
+  }
+  else if (transaction.onBody)
+    transaction.onBody(body);
+}
+
+void
+HttpTracker::handleDisconnect(const std::string& reason)
+{
+  size_t nRequestsSent = m_nRequestsSent;
+  disconnect();
+
+  if (m_transactions.empty())
+    return;
+
+  // an idle keep-alive connection may have been closed just as requests were sent on it,
+  // they get one more chance
+  if (!m_transactions.front().isRetry) {
+    m_transactions.front().isRetry = true;
+    for (size_t i = 0; i < nRequestsSent; ++i)
+      m_transactions[i].isRetry = true;
+    open();
+    return;
+  }
+
+  Transaction transaction = std::move(m_transactions.front());
+  m_transactions.pop_front();
+  if (!m_transactions.empty()) {
+    startTimer();
+    open();
+  }
+  else
+    stopTimer();
+
+  if (transaction.onError)
+    transaction.onError(reason);
+}
+
+void
+HttpTracker::failAll(const std::string& reason)
+{
+  std::deque<Transaction> transactions;
+  transactions.swap(m_transactions);
+  cancel();
+
+  for (auto& transaction : transactions) {
+    if (transaction.onError)
+      transaction.onError(reason);
+  }
+}
+
+void
+HttpTracker::disconnect()
+{
+  if (m_sock != -1) {
+    m_reactor.remove(m_sock);
+    close(m_sock);
+    m_sock = -1;
+  }
+
+  m_state = STATE_IDLE;
+  ++m_generation;
+
+  m_input.clear();
+  m_nScanned = 0;
+  m_headerLength = 0;
+  m_body.clear();
+}
+
+} // namespace sbt
@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TRACKER_HTTP_TRACKER_HPP
+#define SBT_TRACKER_HTTP_TRACKER_HPP
+
+#include "../common.hpp"
+#include "../net/reactor.hpp"
+#include "../net/resolver.hpp"
+#include "../http/http-response.hpp"
+#include "tracker.hpp"
+#include "../scrape-request-param.hpp"
+#include "../scrape-response.hpp"
+#include "../util/buffer.hpp"
+
+#include <deque>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Announces to an HTTP tracker without ever blocking the reactor
+ *
+ * An announce walks through name resolution (on the net::Resolver worker), a
+ * non-blocking connect, sending the request and reading the response as it trickles in.
+ * Every step is driven by readiness events of the same reactor that serves the peer
+ * sockets, so a slow or dead tracker only delays its own answer.
+ *
+ * The tracker is spoken to in HTTP/1.1 over one persistent connection: requests are
+ * pipelined behind each other and answered in order, and the connection is kept for the
+ * next announce as long as the tracker keeps it open.  Requests that were in flight when
+ * the tracker closed the connection are sent again once on a new one.
+ *
+ * Resolved addresses are kept for the next connection and dropped when none of them can
+ * be connected to.
+ */
+class HttpTracker : public Tracker
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  typedef function<void(const ScrapeResponse& response)> ScrapeCallback;
+
+  static const uint64_t DEFAULT_TIMEOUT_MS;
+  static const size_t MAX_RESPONSE_LENGTH;
+
+public:
+  HttpTracker(net::Reactor& reactor, net::Resolver& resolver);
+
+  /**
+   * @brief Abort the queued requests, their callbacks are not called
+   */
+  virtual
+  ~HttpTracker();
+
+  HttpTracker(const HttpTracker&) = delete;
+
+  HttpTracker&
+  operator=(const HttpTracker&) = delete;
+
+  /**
+   * @brief Set the tracker to announce to
+   * @param path path of the announce URL, may carry a query of its own
+   */
+  void
+  setTarget(const std::string& host, const std::string& port, const std::string& path);
+
+  /**
+   * @brief Give up on a request that has not been answered within @p timeoutMs
+   */
+  void
+  setTimeout(uint64_t timeoutMs)
+  {
+    m_timeoutMs = timeoutMs;
+  }
+
+  virtual void
+  announce(const TrackerRequestParam& param,
+           const ResponseCallback& onResponse, const ErrorCallback& onError);
+
+  /**
+   * @brief Ask for the swarm sizes of the torrents in @p param
+   *
+   * The request is queued on the same connection as the announces.
+   *
+   * @throw Error if the tracker does not support scrape
+   */
+  void
+  scrape(const ScrapeRequestParam& param,
+         const ScrapeCallback& onResponse, const ErrorCallback& onError);
+
+  /**
+   * @brief Derive the scrape path from an announce path (BEP 48)
+   * @return empty if the last segment of @p announcePath does not start with "announce"
+   */
+  static std::string
+  getScrapePath(const std::string& announcePath);
+
+  /**
+   * @brief Abort all queued requests without calling their callbacks and disconnect
+   */
+  virtual void
+  cancel();
+
+  virtual bool
+  isBusy() const
+  {
+    return !m_transactions.empty();
+  }
+
+  bool
+  isConnected() const
+  {
+    return m_state == STATE_CONNECTED;
+  }
+
+private:
+  typedef function<void(const BufferView& body)> BodyCallback;
+
+  /**
+   * @brief Queue a GET of @p path extended by @p query
+   * @param query parameters starting with '?'
+   */
+  void
+  request(const std::string& path, const std::string& query,
+          const BodyCallback& onBody, const ErrorCallback& onError);
+
+  void
+  open();
+
+  void
+  connect();
+
+  void
+  handleResolved(const std::vector<net::Address>& addresses, const std::string& error);
+
+  void
+  handleEvent(uint32_t events);
+
+  void
+  sendRequests();
+
+  void
+  receiveResponses();
+
+  /**
+   * @brief Parse the response at the front of the input
+   * @return true if it is complete
+   */
+  bool
+  parseResponse(bool isClosed);
+
+  /**
+   * @brief Hand the parsed response to the oldest request
+   */
+  void
+  completeRequest();
+
+  /**
+   * @brief The connection is gone, send the unanswered requests again on a new one
+   */
+  void
+  handleDisconnect(const std::string& reason);
+
+  void
+  failAll(const std::string& reason);
+
+  void
+  startTimer();
+
+  void
+  stopTimer();
+
+  /**
+   * @brief Close the socket and forget the partial response, the state is idle afterwards
+   */
+  void
+  disconnect();
+
+private:
+  enum State {
+    STATE_IDLE,
+    STATE_RESOLVING,
+    STATE_CONNECTING,
+    STATE_CONNECTED
+  };
+
+  enum Framing {
+    FRAMING_LENGTH,
+    FRAMING_CHUNKED,
+    FRAMING_CLOSE
+  };
+
+  struct Transaction
+  {
+    Buffer request;
+    BodyCallback onBody;
+    ErrorCallback onError;
+    bool isRetry;
+  };
+
+  net::Reactor& m_reactor;
+  net::Resolver& m_resolver;
+
+  std::string m_host;
+  std::string m_port;
+  std::string m_path;
+  uint64_t m_timeoutMs;
+
+  std::vector<net::Address> m_addresses;
+  size_t m_addressIndex;
+
+  State m_state;
+  int m_sock;
+  net::Reactor::TimerId m_timer;
+  // bumped whenever the connection goes away, so that late events are recognized as stale
+  uint64_t m_generation;
+  // expires with this object, resolver answers posted after that are dropped
+  shared_ptr<int> m_token;
+
+  std::deque<Transaction> m_transactions;
+  size_t m_nRequestsSent;  // of m_transactions, on the current connection
+  size_t m_nSent;          // bytes of the next request
+
+  Buffer m_input;
+  size_t m_nScanned;      // bytes searched for the end of the header
+  size_t m_headerLength;  // 0 until the header is complete
+  HttpResponse m_header;
+  Framing m_framing;
+  size_t m_contentLength;
+  ChunkedDecoder m_chunked;
+  size_t m_nDecoded;      // input consumed by the chunked decoder
+  Buffer m_body;
+  size_t m_responseLength;
+};
+
+} // namespace sbt
+
+#endif // SBT_TRACKER_HTTP_TRACKER_HPP
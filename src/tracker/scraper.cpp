@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "scraper.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+const uint64_t Scraper::DEFAULT_TTL_MS = 15 * 60 * 1000;
+// keeps the request line well below the limits of common HTTP servers
+const size_t Scraper::MAX_BATCH_SIZE = 64;
+
+static std::string
+toKey(const BufferView& infoHash)
+{
+  return std::string(reinterpret_cast<const char*>(infoHash.buf()), infoHash.size());
+}
+
+Scraper::Scraper(net::Reactor& reactor, net::Resolver& resolver)
+  : m_reactor(reactor)
+  , m_resolver(resolver)
+  , m_ttlMs(DEFAULT_TTL_MS)
+  , m_token(make_shared<int>(0))
+{
+}
+
+std::string
+Scraper::getSiteKey(const TrackerUrl& url)
+{
+  if (url.scheme == "udp")
+    throw Tracker::Error("Scrape of UDP tracker " + url.host + " is not supported");
+
+  std::string path = HttpTracker::getScrapePath(url.path);
+  if (path.empty())
+    throw Tracker::Error("Tracker " + url.host + " does not support scrape");
+
+  return url.scheme + "://" + url.host + ":" + url.port + path;
+}
+
+void
+Scraper::scrape(const std::string& announceUrl, ConstBufferPtr infoHash,
+                const StatsCallback& onStats, const ErrorCallback& onError)
+{
+  TrackerUrl url = TrackerUrl::parse(announceUrl);
+  std::string key = getSiteKey(url);
+
+  Site& site = m_sites[key];
+  if (site.tracker == nullptr) {
+    site.host = url.host;
+    site.tracker.reset(new HttpTracker(m_reactor, m_resolver));
+    site.tracker->setTarget(url.host, url.port, url.path);
+    site.isFlushPosted = false;
+  }
+
+  std::string hash = toKey(*infoHash);
+  weak_ptr<int> token = m_token;
+
+  auto cached = site.cache.find(hash);
+  if (cached != site.cache.end() && cached->second.expiry > net::Reactor::now()) {
+    ScrapeStats stats = cached->second.stats;
+    m_reactor.post([token, onStats, stats] {
+        if (!token.expired() && onStats)
+          onStats(stats);
+      });
+    return;
+  }
+
+  // a torrent already on its way to the tracker is not asked for again
+  std::vector<Waiter>& waiters = site.waiters[hash];
+  Waiter waiter = {onStats, onError};
+  waiters.push_back(waiter);
+  if (waiters.size() > 1)
+    return;
+
+  site.pending.push_back(infoHash);
+  if (!site.isFlushPosted) {
+    // whatever else is asked for in this turn goes into the same request
+    site.isFlushPosted = true;
+    m_reactor.post([this, token, key] {
+        if (!token.expired())
+          flush(key);
+      });
+  }
+}
+
+bool
+Scraper::getStats(const std::string& announceUrl, const BufferView& infoHash,
+                  ScrapeStats& stats) const
+{
+  auto site = m_sites.find(getSiteKey(TrackerUrl::parse(announceUrl)));
+  if (site == m_sites.end())
+    return false;
+
+  auto cached = site->second.cache.find(toKey(infoHash));
+  if (cached == site->second.cache.end() || cached->second.expiry <= net::Reactor::now())
+    return false;
+
+  stats = cached->second.stats;
+  return true;
+}
+
+void
+Scraper::flush(const std::string& key)
+{
+  Site& site = m_sites[key];
+  site.isFlushPosted = false;
+
+  std::vector<ConstBufferPtr> pending;
+  pending.swap(site.pending);
+
+  for (size_t begin = 0; begin < pending.size(); begin += MAX_BATCH_SIZE) {
+    size_t end = std::min(begin + MAX_BATCH_SIZE, pending.size());
+
+    ScrapeRequestParam param;
+    std::vector<std::string> hashes;
+    for (size_t i = begin; i < end; ++i) {
+      param.addInfoHash(pending[i]);
+      hashes.push_back(toKey(*pending[i]));
+    }
+
+    site.tracker->scrape(param,
+                         [this, key, hashes] (const ScrapeResponse& response) {
+                           handleResponse(key, hashes, response);
+                         },
+                         [this, key, hashes] (const std::string& reason) {
+                           handleError(key, hashes, reason);
+                         });
+  }
+}
+
+void
+Scraper::handleResponse(const std::string& key, const std::vector<std::string>& hashes,
+                        const ScrapeResponse& response)
+{
+  if (response.isFailure()) {
+    handleError(key, hashes, response.getFailure());
+    return;
+  }
+
+  Site& site = m_sites[key];
+  uint64_t now = net::Reactor::now();
+  uint64_t ttl = std::max(m_ttlMs, response.getMinRequestInterval() * 1000);
+
+  // expired entries go whenever the tracker answers, the cache stays as large as the
+  // set of torrents that are still asked for
+  for (auto it = site.cache.begin(); it != site.cache.end(); ) {
+    if (it->second.expiry <= now)
+      it = site.cache.erase(it);
+    else
+      ++it;
+  }
+
+  std::vector<function<void()>> calls;
+  for (const auto& hash : hashes) {
+    std::vector<Waiter> waiters;
+    auto it = site.waiters.find(hash);
+    if (it != site.waiters.end()) {
+      waiters.swap(it->second);
+      site.waiters.erase(it);
+    }
+
+    const ScrapeStats* stats = response.find(BufferView(hash.data(), hash.size()));
+    if (stats != nullptr) {
+      CacheEntry entry = {*stats, now + ttl};
+      site.cache[hash] = entry;
+      for (const auto& waiter : waiters) {
+        if (waiter.onStats)
+          calls.push_back(bind(waiter.onStats, *stats));
+      }
+    }
+    else {
+      for (const auto& waiter : waiters) {
+        if (waiter.onError)
+          calls.push_back(bind(waiter.onError, "Tracker " + site.host +
+                               " does not know the torrent"));
+      }
+    }
+  }
+
+  // the state is consistent again, the callbacks may scrape again
+  for (const auto& call : calls)
+    call();
+}
+
+void
+Scraper::handleError(const std::string& key, const std::vector<std::string>& hashes,
+                     const std::string& reason)
+{
+  Site& site = m_sites[key];
+
+  std::vector<Waiter> failed;
+  for (const auto& hash : hashes) {
+    auto it = site.waiters.find(hash);
+    if (it == site.waiters.end())
+      continue;
+    failed.insert(failed.end(), it->second.begin(), it->second.end());
+    site.waiters.erase(it);
+  }
+
+  for (const auto& waiter : failed) {
+    if (waiter.onError)
+      waiter.onError(reason);
+  }
+}
+
+} // namespace sbt
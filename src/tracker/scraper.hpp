@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TRACKER_SCRAPER_HPP
+#define SBT_TRACKER_SCRAPER_HPP
+
+#include "../common.hpp"
+#include "../net/reactor.hpp"
+#include "../net/resolver.hpp"
+#include "http-tracker.hpp"
+
+#include <map>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Swarm sizes of many torrents, scraped from their trackers in batches and cached
+ *
+ * Scrapes of the same tracker that are asked for within one turn of the reactor go out as
+ * one request carrying an info_hash parameter per torrent, at most MAX_BATCH_SIZE of them.
+ * A torrent that is already being scraped is not asked for twice.  Answers are cached for
+ * the TTL, or for the min_request_interval of the tracker if that is longer, so asking
+ * again before then costs nothing.
+ *
+ * Only HTTP trackers are scraped, the scrape URL is derived from the announce URL.
+ */
+class Scraper
+{
+public:
+  typedef function<void(const ScrapeStats& stats)> StatsCallback;
+  typedef Tracker::ErrorCallback ErrorCallback;
+
+  static const uint64_t DEFAULT_TTL_MS;
+  static const size_t MAX_BATCH_SIZE;
+
+public:
+  Scraper(net::Reactor& reactor, net::Resolver& resolver);
+
+  Scraper(const Scraper&) = delete;
+
+  Scraper&
+  operator=(const Scraper&) = delete;
+
+  /**
+   * @brief Keep answers for at least @p ttlMs
+   */
+  void
+  setTtl(uint64_t ttlMs)
+  {
+    m_ttlMs = ttlMs;
+  }
+
+  /**
+   * @brief Get the swarm size of @p infoHash from the tracker of @p announceUrl
+   *
+   * The callbacks are always called from the reactor, also for a cached answer.
+   *
+   * @throw Tracker::Error if the URL cannot be parsed or the tracker cannot be scraped
+   */
+  void
+  scrape(const std::string& announceUrl, ConstBufferPtr infoHash,
+         const StatsCallback& onStats, const ErrorCallback& onError);
+
+  /**
+   * @brief Look up a cached answer that has not expired yet
+   * @return false if there is none
+   */
+  bool
+  getStats(const std::string& announceUrl, const BufferView& infoHash, ScrapeStats& stats) const;
+
+private:
+  /**
+   * @brief Name the scrape URL of @p url, trackers are shared by it
+   * @throw Tracker::Error if @p url cannot be scraped
+   */
+  static std::string
+  getSiteKey(const TrackerUrl& url);
+
+  /**
+   * @brief Send the torrents queued for the tracker @p key in batches
+   */
+  void
+  flush(const std::string& key);
+
+  void
+  handleResponse(const std::string& key, const std::vector<std::string>& hashes,
+                 const ScrapeResponse& response);
+
+  void
+  handleError(const std::string& key, const std::vector<std::string>& hashes,
+              const std::string& reason);
+
+private:
+  struct Waiter
+  {
+    StatsCallback onStats;
+    ErrorCallback onError;
+  };
+
+  struct CacheEntry
+  {
+    ScrapeStats stats;
+    uint64_t expiry;
+  };
+
+  struct Site
+  {
+    std::string host;
+    unique_ptr<HttpTracker> tracker;
+    std::vector<ConstBufferPtr> pending;  // not requested yet
+    // by raw info hash, of torrents pending or in flight
+    std::map<std::string, std::vector<Waiter>> waiters;
+    std::map<std::string, CacheEntry> cache;
+    bool isFlushPosted;
+  };
+
+  net::Reactor& m_reactor;
+  net::Resolver& m_resolver;
+  uint64_t m_ttlMs;
+  std::map<std::string, Site> m_sites;
+  // expires with this object, posted tasks that run after that are dropped
+  shared_ptr<int> m_token;
+};
+
+} // namespace sbt
+
+#endif // SBT_TRACKER_SCRAPER_HPP
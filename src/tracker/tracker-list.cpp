@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "tracker-list.hpp"
+#include "http-tracker.hpp"
+#include "udp-tracker.hpp"
+
+#include <algorithm>
+
+namespace sbt {
+
+TrackerList::TrackerList(net::Reactor& reactor, net::Resolver& resolver)
+  : m_reactor(reactor)
+  , m_resolver(resolver)
+  , m_round(0)
+  , m_tier(0)
+  , m_nPending(0)
+  , m_hasAnswer(false)
+  , m_interval(0)
+{
+}
+
+unique_ptr<Tracker>
+TrackerList::makeTracker(const TrackerUrl& url, net::Reactor& reactor, net::Resolver& resolver)
+{
+  if (url.scheme == "udp") {
+    unique_ptr<UdpTracker> tracker(new UdpTracker(reactor, resolver));
+    tracker->setTarget(url.host, url.port);
+    return std::move(tracker);
+  }
+
+  unique_ptr<HttpTracker> tracker(new HttpTracker(reactor, resolver));
+  tracker->setTarget(url.host, url.port, url.path);
+  return std::move(tracker);
+}
+
+size_t
+TrackerList::addTier(const std::vector<std::string>& urls)
+{
+  std::vector<Entry> tier;
+  for (const auto& url : urls) {
+    try {
+      Entry entry = {url, shared_ptr<Tracker>(makeTracker(TrackerUrl::parse(url),
+                                                          m_reactor, m_resolver))};
+      tier.push_back(entry);
+    }
+    catch (const Tracker::Error&) {
+      // a client is expected to skip the URLs it does not understand
+    }
+  }
+
+  if (!tier.empty())
+    m_tiers.push_back(tier);
+  return tier.size();
+}
+
+std::vector<std::string>
+TrackerList::getTier(size_t index) const
+{
+  std::vector<std::string> urls;
+  for (const auto& entry : m_tiers.at(index))
+    urls.push_back(entry.url);
+  return urls;
+}
+
+void
+TrackerList::announce(const TrackerRequestParam& param, const PeersCallback& onPeers,
+                      const DoneCallback& onDone, const ErrorCallback& onError)
+{
+  cancel();
+
+  m_param = param;
+  m_onPeers = onPeers;
+  m_onDone = onDone;
+  m_onError = onError;
+  m_tier = 0;
+  m_hasAnswer = false;
+  m_seen.clear();
+  m_lastError = "No tracker to announce to";
+
+  if (m_tiers.empty()) {
+    finishOne();
+    return;
+  }
+  announceTier();
+}
+
+void
+TrackerList::cancel()
+{
+  ++m_round;
+  m_nPending = 0;
+
+  // idle trackers are left alone, they may hold a connection worth keeping
+  for (auto& tier : m_tiers) {
+    for (auto& entry : tier) {
+      if (entry.tracker->isBusy())
+        entry.tracker->cancel();
+    }
+  }
+}
+
+void
+TrackerList::announceTier()
+{
+  // the callbacks may reorder the tier while it is being walked
+  std::vector<Entry> tier = m_tiers[m_tier];
+  m_nPending = tier.size();
+  m_hasAnswer = false;
+  m_interval = 0;
+
+  uint64_t round = m_round;
+  for (const auto& entry : tier) {
+    Tracker* tracker = entry.tracker.get();
+    tracker->announce(m_param,
+                      [this, round, tracker] (const TrackerResponse& response) {
+                        handleResponse(round, tracker, response);
+                      },
+                      [this, round] (const std::string& reason) {
+                        handleError(round, reason);
+                      });
+    if (round != m_round)
+      return;
+  }
+}
+
+void
+TrackerList::handleResponse(uint64_t round, Tracker* tracker, const TrackerResponse& response)
+{
+  if (round != m_round)
+    return;
+
+  if (response.isFailure()) {
+    handleError(round, response.getFailure());
+    return;
+  }
+
+  if (!m_hasAnswer) {
+    m_hasAnswer = true;
+    m_interval = response.getInterval();
+
+    // the fastest tracker is asked first from now on
+    auto& tier = m_tiers[m_tier];
+    auto it = std::find_if(tier.begin(), tier.end(),
+                           [tracker] (const Entry& entry) { return entry.tracker.get() == tracker; });
+    if (it != tier.end())
+      std::rotate(tier.begin(), it, it + 1);
+  }
+
+  std::vector<PeerEndpoint> peers;
+  for (const auto& endpoint : response.getEndpoints()) {
+    if (m_seen.insert(endpoint).second)
+      peers.push_back(endpoint);
+  }
+
+  if (!peers.empty() && m_onPeers) {
+    PeersCallback onPeers = m_onPeers;
+    onPeers(peers);
+    if (round != m_round)
+      return;
+  }
+
+  finishOne();
+}
+
+void
+TrackerList::handleError(uint64_t round, const std::string& reason)
+{
+  if (round != m_round)
+    return;
+
+  m_lastError = reason;
+  finishOne();
+}
+
+void
+TrackerList::finishOne()
+{
+  if (m_nPending > 0 && --m_nPending > 0)
+    return;
+
+  if (m_hasAnswer) {
+    DoneCallback onDone = m_onDone;
+    if (onDone)
+      onDone(m_interval);
+    return;
+  }
+
+  if (m_tier + 1 < m_tiers.size()) {
+    ++m_tier;
+    announceTier();
+    return;
+  }
+
+  ErrorCallback onError = m_onError;
+  if (onError)
+    onError(m_lastError);
+}
+
+} // namespace sbt
@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TRACKER_TRACKER_LIST_HPP
+#define SBT_TRACKER_TRACKER_LIST_HPP
+
+#include "../common.hpp"
+#include "../net/reactor.hpp"
+#include "../net/resolver.hpp"
+#include "tracker.hpp"
+
+#include <set>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief The trackers of a torrent, in tiers (BEP 12)
+ *
+ * An announce goes to all trackers of the first tier at once; only if none of them
+ * answers is the next tier tried.  The tracker that answers first is moved to the front
+ * of its tier, and the peers of all answers are merged into one set, so the first
+ * candidates arrive as soon as the fastest tracker has answered.
+ */
+class TrackerList
+{
+public:
+  /**
+   * @brief Receives the peers of one tracker answer that no earlier answer listed
+   */
+  typedef function<void(const std::vector<PeerEndpoint>& peers)> PeersCallback;
+
+  /**
+   * @brief Called when all trackers of the tier have answered or failed
+   * @param interval re-announce interval of the tracker that answered first, in seconds
+   */
+  typedef function<void(uint64_t interval)> DoneCallback;
+
+  typedef Tracker::ErrorCallback ErrorCallback;
+
+public:
+  TrackerList(net::Reactor& reactor, net::Resolver& resolver);
+
+  /**
+   * @brief Append a tier; URLs that cannot be parsed are skipped
+   * @return number of trackers added
+   */
+  size_t
+  addTier(const std::vector<std::string>& urls);
+
+  size_t
+  getNumTiers() const
+  {
+    return m_tiers.size();
+  }
+
+  /**
+   * @brief The URLs of tier @p index, in the order they are preferred
+   */
+  std::vector<std::string>
+  getTier(size_t index) const;
+
+  /**
+   * @brief Announce to the first tier that answers
+   *
+   * @p onPeers is called for every answer that brings new peers.  The announce ends with
+   * @p onDone once a tier is through and at least one of its trackers answered, or with
+   * @p onError if no tracker of any tier did.
+   */
+  void
+  announce(const TrackerRequestParam& param, const PeersCallback& onPeers,
+           const DoneCallback& onDone, const ErrorCallback& onError);
+
+  /**
+   * @brief Abort the announce in progress without calling its callbacks
+   */
+  void
+  cancel();
+
+  bool
+  isBusy() const
+  {
+    return m_nPending > 0;
+  }
+
+  /**
+   * @brief Create the tracker for @p url by its scheme
+   * @throw Tracker::Error
+   */
+  static unique_ptr<Tracker>
+  makeTracker(const TrackerUrl& url, net::Reactor& reactor, net::Resolver& resolver);
+
+private:
+  void
+  announceTier();
+
+  void
+  handleResponse(uint64_t round, Tracker* tracker, const TrackerResponse& response);
+
+  void
+  handleError(uint64_t round, const std::string& reason);
+
+  /**
+   * @brief One more tracker of the tier is done, move on when it was the last one
+   */
+  void
+  finishOne();
+
+private:
+  struct Entry
+  {
+    std::string url;
+    shared_ptr<Tracker> tracker;
+  };
+
+  net::Reactor& m_reactor;
+  net::Resolver& m_resolver;
+  std::vector<std::vector<Entry>> m_tiers;
+
+  TrackerRequestParam m_param;
+  PeersCallback m_onPeers;
+  DoneCallback m_onDone;
+  ErrorCallback m_onError;
+
+  // bumped by every announce, answers of an earlier one are dropped
+  uint64_t m_round;
+  size_t m_tier;
+  size_t m_nPending;
+  bool m_hasAnswer;
+  uint64_t m_interval;
+  std::string m_lastError;
+  std::set<PeerEndpoint> m_seen;
+};
+
+} // namespace sbt
+
+#endif // SBT_TRACKER_TRACKER_LIST_HPP
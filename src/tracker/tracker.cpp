@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "tracker.hpp"
+
+namespace sbt {
+
+TrackerUrl
+TrackerUrl::parse(const std::string& url)
+{
+  TrackerUrl result;
+
+  size_t schemeEnd = url.find("://");
+  if (schemeEnd == std::string::npos)
+    throw Tracker::Error("Wrong tracker url, no scheme: " + url);
+  result.scheme = url.substr(0, schemeEnd);
+
+  std::string defaultPort;
+  if (result.scheme == "https")
+    defaultPort = "443";
+  else if (result.scheme == "http")
+    defaultPort = "80";
+  else if (result.scheme != "udp")
+    throw Tracker::Error("Wrong tracker url, wrong scheme: " + url);
+
+  std::string rest = url.substr(schemeEnd + 3);
+  size_t slashPos = rest.find('/');
+  if (slashPos == std::string::npos) {
+    if (result.scheme != "udp")
+      throw Tracker::Error("Wrong tracker url, no file: " + url);
+    // the path of a UDP tracker URL is optional
+    result.path = "/";
+  }
+  else
+    result.path = rest.substr(slashPos);
+
+  std::string host = rest.substr(0, slashPos);
+  size_t colonPos = host.rfind(':');
+  if (colonPos == std::string::npos || host.find(']', colonPos) != std::string::npos) {
+    result.host = host;
+    result.port = defaultPort;
+  }
+  else {
+    result.host = host.substr(0, colonPos);
+    result.port = host.substr(colonPos + 1);
+  }
+
+  // IPv6 literal
+  if (result.host.size() > 1 && result.host.front() == '[' && result.host.back() == ']')
+    result.host = result.host.substr(1, result.host.size() - 2);
+
+  if (result.host.empty())
+    throw Tracker::Error("Wrong tracker url, no host: " + url);
+  if (result.port.empty())
+    throw Tracker::Error("Wrong tracker url, no port: " + url);
+
+  return result;
+}
+
+Tracker::~Tracker()
+{
+}
+
+} // namespace sbt
@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TRACKER_TRACKER_HPP
+#define SBT_TRACKER_TRACKER_HPP
+
+#include "../common.hpp"
+#include "../tracker-request-param.hpp"
+#include "../tracker-response.hpp"
+
+namespace sbt {
+
+/**
+ * @brief The parts of a tracker URL
+ */
+struct TrackerUrl
+{
+  std::string scheme;  // "http", "https" or "udp"
+  std::string host;
+  std::string port;
+  std::string path;    // starts with '/'
+
+  /**
+   * @throw Tracker::Error the URL is malformed or of an unsupported scheme
+   */
+  static TrackerUrl
+  parse(const std::string& url);
+};
+
+/**
+ * @brief A tracker the client announces to, whatever protocol it speaks
+ */
+class Tracker
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  typedef function<void(const TrackerResponse& response)> ResponseCallback;
+  typedef function<void(const std::string& reason)> ErrorCallback;
+
+public:
+  virtual
+  ~Tracker();
+
+  /**
+   * @brief Queue an announce behind the ones already queued
+   *
+   * Exactly one of the callbacks is called, on the reactor thread.  A tracker that
+   * answers with a failure reason is a response, not an error.
+   */
+  virtual void
+  announce(const TrackerRequestParam& param,
+           const ResponseCallback& onResponse, const ErrorCallback& onError) = 0;
+
+  /**
+   * @brief Abort all queued announces without calling their callbacks
+   */
+  virtual void
+  cancel() = 0;
+
+  virtual bool
+  isBusy() const = 0;
+};
+
+} // namespace sbt
+
+#endif // SBT_TRACKER_TRACKER_HPP
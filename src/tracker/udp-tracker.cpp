@@ -0,0 +1,391 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "udp-tracker.hpp"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace sbt {
+
+const uint64_t UdpTracker::PROTOCOL_ID = 0x41727101980;
+const uint64_t UdpTracker::CONNECTION_ID_LIFETIME_MS = 60 * 1000;
+const uint64_t UdpTracker::DEFAULT_RETRANSMIT_TIMEOUT_MS = 15 * 1000;
+const size_t UdpTracker::DEFAULT_MAX_RETRANSMISSIONS = 3;
+
+const size_t UdpTracker::CONNECT_LENGTH = 16;
+const size_t UdpTracker::ANNOUNCE_LENGTH = 98;
+const size_t UdpTracker::ANNOUNCE_RESPONSE_HEADER_LENGTH = 20;
+
+static void
+writeUint64(uint8_t* buf, uint64_t value)
+{
+  value = htobe64(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+static void
+writeUint32(uint8_t* buf, uint32_t value)
+{
+  value = htonl(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+static void
+writeUint16(uint8_t* buf, uint16_t value)
+{
+  value = htons(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+static uint64_t
+readUint64(const uint8_t* buf)
+{
+  uint64_t value;
+  memcpy(&value, buf, sizeof(value));
+  return be64toh(value);
+}
+
+static uint32_t
+readUint32(const uint8_t* buf)
+{
+  uint32_t value;
+  memcpy(&value, buf, sizeof(value));
+  return ntohl(value);
+}
+
+UdpTracker::UdpTracker(net::Reactor& reactor, net::Resolver& resolver)
+  : m_reactor(reactor)
+  , m_resolver(resolver)
+  , m_retransmitTimeoutMs(DEFAULT_RETRANSMIT_TIMEOUT_MS)
+  , m_maxRetransmissions(DEFAULT_MAX_RETRANSMISSIONS)
+  , m_sock(-1)
+  , m_family(AF_INET)
+  , m_state(STATE_IDLE)
+  , m_connectionId(0)
+  , m_connectionTime(0)
+  , m_random(std::random_device()())
+  , m_transactionId(0)
+  , m_nRetransmissions(0)
+  , m_timer(0)
+  , m_generation(0)
+  , m_token(make_shared<int>(0))
+{
+  m_key = m_random();
+}
+
+UdpTracker::~UdpTracker()
+{
+  cancel();
+  closeSocket();
+}
+
+void
+UdpTracker::setTarget(const std::string& host, const std::string& port)
+{
+  cancel();
+  closeSocket();
+
+  m_host = host;
+  m_port = port;
+}
+
+bool
+UdpTracker::hasConnectionId() const
+{
+  return m_connectionTime != 0 &&
+         net::Reactor::now() - m_connectionTime < CONNECTION_ID_LIFETIME_MS;
+}
+
+void
+UdpTracker::announce(const TrackerRequestParam& param,
+                     const ResponseCallback& onResponse, const ErrorCallback& onError)
+{
+  if (!param.getInfoHash() || param.getInfoHash()->size() != 20)
+    throw Error("Info hash must be 20 bytes long");
+
+  Announce announce = {param, onResponse, onError};
+  m_announces.push_back(announce);
+
+  if (m_state == STATE_IDLE)
+    start();
+}
+
+void
+UdpTracker::cancel()
+{
+  m_announces.clear();
+
+  if (m_timer != 0) {
+    m_reactor.cancel(m_timer);
+    m_timer = 0;
+  }
+
+  if (m_state == STATE_RESOLVING)
+    ++m_generation;
+  m_state = STATE_IDLE;
+}
+
+void
+UdpTracker::closeSocket()
+{
+  if (m_sock != -1) {
+    m_reactor.remove(m_sock);
+    close(m_sock);
+    m_sock = -1;
+  }
+  m_connectionTime = 0;
+}
+
+void
+UdpTracker::start()
+{
+  if (m_sock != -1) {
+    if (hasConnectionId())
+      sendAnnounce();
+    else
+      sendConnect();
+    return;
+  }
+
+  m_state = STATE_RESOLVING;
+  uint64_t generation = m_generation;
+  weak_ptr<int> token = m_token;
+  m_resolver.resolve(m_host, m_port,
+                     [this, token, generation] (const std::vector<net::Address>& addresses,
+                                                const std::string& error) {
+      if (token.expired() || generation != m_generation)
+        return;
+      handleResolved(addresses, error);
+    });
+}
+
+void
+UdpTracker::handleResolved(const std::vector<net::Address>& addresses, const std::string& error)
+{
+  for (const auto& address : addresses) {
+    // a connected datagram socket only hears from the tracker, and learns about ICMP errors
+    m_sock = socket(address.getFamily(), SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_sock == -1)
+      continue;
+    net::Reactor::setNonBlocking(m_sock);
+
+    if (::connect(m_sock, address.get(), address.length) == 0) {
+      m_family = address.getFamily();
+      m_reactor.add(m_sock, net::Reactor::EVENT_READ,
+                    bind(&UdpTracker::handleEvent, this, std::placeholders::_1));
+      sendConnect();
+      return;
+    }
+
+    close(m_sock);
+    m_sock = -1;
+  }
+
+  complete(nullptr, addresses.empty() ? error : "Cannot connect to tracker " + m_host);
+}
+
+void
+UdpTracker::sendConnect()
+{
+  m_state = STATE_CONNECTING;
+  m_transactionId = m_random();
+  m_nRetransmissions = 0;
+
+  m_request.resize(CONNECT_LENGTH);
+  writeUint64(&m_request[0], PROTOCOL_ID);
+  writeUint32(&m_request[8], ACTION_CONNECT);
+  writeUint32(&m_request[12], m_transactionId);
+
+  transmit();
+}
+
+void
+UdpTracker::sendAnnounce()
+{
+  const TrackerRequestParam& param = m_announces.front().param;
+
+  m_state = STATE_ANNOUNCING;
+  m_transactionId = m_random();
+  m_nRetransmissions = 0;
+
+  uint32_t event = EVENT_NONE;
+  if (param.getEvent() == TrackerRequestParam::STARTED)
+    event = EVENT_STARTED;
+  else if (param.getEvent() == TrackerRequestParam::COMPLETED)
+    event = EVENT_COMPLETED;
+  else if (param.getEvent() == TrackerRequestParam::STOPPED)
+    event = EVENT_STOPPED;
+
+  m_request.assign(ANNOUNCE_LENGTH, 0);
+  writeUint64(&m_request[0], m_connectionId);
+  writeUint32(&m_request[8], ACTION_ANNOUNCE);
+  writeUint32(&m_request[12], m_transactionId);
+  memcpy(&m_request[16], param.getInfoHash()->buf(), 20);
+  std::string peerId = param.getPeerId();
+  memcpy(&m_request[36], peerId.data(), std::min<size_t>(peerId.size(), 20));
+  writeUint64(&m_request[56], param.getDownloaded());
+  writeUint64(&m_request[64], param.getLeft());
+  writeUint64(&m_request[72], param.getUploaded());
+  writeUint32(&m_request[80], event);
+  // the address the tracker sees is used unless we name an IPv4 one; a loopback address
+  // would have the tracker hand us out to the swarm as localhost, so it is left at 0
+  in_addr ip;
+  if (inet_pton(AF_INET, param.getIp().c_str(), &ip) == 1 && (ntohl(ip.s_addr) >> 24) != 127)
+    memcpy(&m_request[84], &ip, sizeof(ip));
+  writeUint32(&m_request[88], m_key);
+  writeUint32(&m_request[92], static_cast<uint32_t>(-1));  // as many peers as the tracker likes
+  writeUint16(&m_request[96], param.getPort());
+
+  transmit();
+}
+
+void
+UdpTracker::transmit()
+{
+  // a datagram that could not be sent is as good as lost, the retransmission covers both
+  send(m_sock, m_request.buf(), m_request.size(), 0);
+
+  if (m_timer != 0)
+    m_reactor.cancel(m_timer);
+  m_timer = m_reactor.schedule(m_retransmitTimeoutMs << m_nRetransmissions, [this] {
+      m_timer = 0;
+      handleTimeout();
+    });
+}
+
+void
+UdpTracker::handleTimeout()
+{
+  if (m_nRetransmissions >= m_maxRetransmissions) {
+    complete(nullptr, "Tracker " + m_host + " timed out");
+    return;
+  }
+
+  ++m_nRetransmissions;
+
+  // the connection id may have run out while we waited
+  if (m_state == STATE_ANNOUNCING && !hasConnectionId()) {
+    size_t nRetransmissions = m_nRetransmissions;
+    sendConnect();
+    m_nRetransmissions = nRetransmissions;
+    return;
+  }
+
+  transmit();
+}
+
+void
+UdpTracker::handleEvent(uint32_t events)
+{
+  uint8_t buf[64 * 1024];
+
+  while (m_sock != -1) {
+    ssize_t res = recv(m_sock, buf, sizeof(buf), 0);
+    if (res >= 0)
+      handleDatagram(buf, res);
+    else if (errno == EINTR)
+      continue;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else if (errno == ECONNREFUSED) {
+      // nobody listens on the tracker port, retransmissions will tell if it comes back
+      continue;
+    }
+    else
+      break;
+  }
+}
+
+void
+UdpTracker::handleDatagram(const uint8_t* datagram, size_t length)
+{
+  if (length < 8 || m_announces.empty())
+    return;
+
+  uint32_t action = readUint32(datagram);
+  uint32_t transactionId = readUint32(datagram + 4);
+  if (transactionId != m_transactionId)
+    return;  // late answer to a retransmitted request
+
+  if (action == ACTION_ERROR) {
+    complete(nullptr, "Tracker " + m_host + " failed: " +
+             std::string(reinterpret_cast<const char*>(datagram + 8), length - 8));
+    return;
+  }
+
+  if (m_state == STATE_CONNECTING && action == ACTION_CONNECT && length >= CONNECT_LENGTH) {
+    m_connectionId = readUint64(datagram + 8);
+    m_connectionTime = net::Reactor::now();
+    sendAnnounce();
+    return;
+  }
+
+  if (m_state == STATE_ANNOUNCING && action == ACTION_ANNOUNCE &&
+      length >= ANNOUNCE_RESPONSE_HEADER_LENGTH) {
+    TrackerResponse response(readUint32(datagram + 8));
+    uint32_t leechers = readUint32(datagram + 12);
+    uint32_t seeders = readUint32(datagram + 16);
+    response.setSwarmSize(seeders, leechers);
+
+    // peers come in the address family of the tracker
+    try {
+      response.addCompactPeers(BufferView(datagram + ANNOUNCE_RESPONSE_HEADER_LENGTH,
+                                          length - ANNOUNCE_RESPONSE_HEADER_LENGTH),
+                               m_family == AF_INET6 ? AF_INET6 : AF_INET);
+    }
+    catch (const TrackerResponse::Error& e) {
+      complete(nullptr, "Malformed response of tracker " + m_host + ": " + e.what());
+      return;
+    }
+
+    complete(&response, "");
+  }
+}
+
+void
+UdpTracker::complete(const TrackerResponse* response, const std::string& reason)
+{
+  Announce announce = m_announces.front();
+  m_announces.pop_front();
+
+  if (m_timer != 0) {
+    m_reactor.cancel(m_timer);
+    m_timer = 0;
+  }
+  m_state = STATE_IDLE;
+  m_transactionId = 0;
+
+  if (!m_announces.empty())
+    start();
+
+  if (response != nullptr) {
+    if (announce.onResponse)
+      announce.onResponse(*response);
+  }
+  else if (announce.onError)
+    announce.onError(reason);
+}
+
+} // namespace sbt
@@ -0,0 +1,221 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TRACKER_UDP_TRACKER_HPP
+#define SBT_TRACKER_UDP_TRACKER_HPP
+
+#include "../common.hpp"
+#include "../net/reactor.hpp"
+#include "../net/resolver.hpp"
+#include "../util/buffer.hpp"
+#include "tracker.hpp"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Announces to a UDP tracker (BEP 15)
+ *
+ * An announce is two datagram round-trips: a connect that yields a connection id, and
+ * the announce proper.  The connection id stays valid for a minute, so announces in
+ * quick succession skip the first round-trip.  A request that is not answered is sent
+ * again after 15 * 2^n seconds, n counting the retransmissions.
+ *
+ * Announces are handled one at a time, in the order they were queued, on the reactor.
+ */
+class UdpTracker : public Tracker
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  enum Action {
+    ACTION_CONNECT = 0,
+    ACTION_ANNOUNCE = 1,
+    ACTION_SCRAPE = 2,
+    ACTION_ERROR = 3
+  };
+
+  enum Event {
+    EVENT_NONE = 0,
+    EVENT_COMPLETED = 1,
+    EVENT_STARTED = 2,
+    EVENT_STOPPED = 3
+  };
+
+  static const uint64_t PROTOCOL_ID;
+  static const uint64_t CONNECTION_ID_LIFETIME_MS;
+  static const uint64_t DEFAULT_RETRANSMIT_TIMEOUT_MS;
+  static const size_t DEFAULT_MAX_RETRANSMISSIONS;
+
+  static const size_t CONNECT_LENGTH;
+  static const size_t ANNOUNCE_LENGTH;
+  static const size_t ANNOUNCE_RESPONSE_HEADER_LENGTH;
+
+public:
+  UdpTracker(net::Reactor& reactor, net::Resolver& resolver);
+
+  /**
+   * @brief Abort the queued announces, their callbacks are not called
+   */
+  virtual
+  ~UdpTracker();
+
+  UdpTracker(const UdpTracker&) = delete;
+
+  UdpTracker&
+  operator=(const UdpTracker&) = delete;
+
+  void
+  setTarget(const std::string& host, const std::string& port);
+
+  /**
+   * @brief Set the wait before the first retransmission, it doubles with every one after
+   */
+  void
+  setRetransmitTimeout(uint64_t timeoutMs)
+  {
+    m_retransmitTimeoutMs = timeoutMs;
+  }
+
+  /**
+   * @brief Give up on a request after @p nRetransmissions unanswered retransmissions
+   */
+  void
+  setMaxRetransmissions(size_t nRetransmissions)
+  {
+    m_maxRetransmissions = nRetransmissions;
+  }
+
+  virtual void
+  announce(const TrackerRequestParam& param,
+           const ResponseCallback& onResponse, const ErrorCallback& onError);
+
+  virtual void
+  cancel();
+
+  virtual bool
+  isBusy() const
+  {
+    return !m_announces.empty();
+  }
+
+  /**
+   * @brief Check whether a connection id is cached that is still valid
+   */
+  bool
+  hasConnectionId() const;
+
+private:
+  void
+  start();
+
+  void
+  handleResolved(const std::vector<net::Address>& addresses, const std::string& error);
+
+  void
+  sendConnect();
+
+  void
+  sendAnnounce();
+
+  /**
+   * @brief Send the current request and schedule its retransmission
+   */
+  void
+  transmit();
+
+  void
+  handleTimeout();
+
+  void
+  handleEvent(uint32_t events);
+
+  void
+  handleDatagram(const uint8_t* datagram, size_t length);
+
+  /**
+   * @brief Finish the oldest announce and start the next one
+   */
+  void
+  complete(const TrackerResponse* response, const std::string& reason);
+
+  void
+  closeSocket();
+
+private:
+  enum State {
+    STATE_IDLE,
+    STATE_RESOLVING,
+    STATE_CONNECTING,
+    STATE_ANNOUNCING
+  };
+
+  struct Announce
+  {
+    TrackerRequestParam param;
+    ResponseCallback onResponse;
+    ErrorCallback onError;
+  };
+
+  net::Reactor& m_reactor;
+  net::Resolver& m_resolver;
+
+  std::string m_host;
+  std::string m_port;
+  uint64_t m_retransmitTimeoutMs;
+  size_t m_maxRetransmissions;
+
+  std::vector<net::Address> m_addresses;
+  int m_sock;
+  int m_family;
+
+  State m_state;
+  uint64_t m_connectionId;
+  uint64_t m_connectionTime;  // when the connection id was obtained, 0 if there is none
+  uint32_t m_key;
+  std::mt19937 m_random;
+
+  Buffer m_request;
+  uint32_t m_transactionId;
+  size_t m_nRetransmissions;
+  net::Reactor::TimerId m_timer;
+  // bumped whenever the pending request is abandoned, late resolver answers are dropped
+  uint64_t m_generation;
+  // expires with this object, resolver answers posted after that are dropped
+  shared_ptr<int> m_token;
+
+  std::deque<Announce> m_announces;
+};
+
+} // namespace sbt
+
+#endif // SBT_TRACKER_UDP_TRACKER_HPP
@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "bencoding-document.hpp"
+#include "bencoding-reader.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string.h>
+
+namespace sbt {
+namespace bencoding {
+
+static const size_t MIN_BLOCK_SIZE = 16 * 1024;
+
+// byte-wise order of the keys, as bencoding sorts them
+static int
+compareKeys(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength)
+{
+  int result = memcmp(a, b, std::min(aLength, bLength));
+  if (result != 0)
+    return result;
+  return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+static bool
+isKeyLess(const Entry& lhs, const Entry& rhs)
+{
+  return compareKeys(lhs.key.buf(), lhs.key.size(), rhs.key.buf(), rhs.key.size()) < 0;
+}
+
+Value::Value()
+  : m_type(TYPE_STRING)
+  , m_size(0)
+  , m_string(nullptr)
+  , m_wire(nullptr)
+  , m_wireLength(0)
+{
+}
+
+void
+Value::expect(Type type) const
+{
+  static const char* names[] = {"", "string", "integer", "list", "dictionary"};
+  if (m_type != type)
+    throw Error(std::string("Value is not a ") + names[type]);
+}
+
+BufferView
+Value::getString() const
+{
+  expect(TYPE_STRING);
+  return BufferView(m_string, m_size);
+}
+
+std::string
+Value::toString() const
+{
+  expect(TYPE_STRING);
+  return std::string(reinterpret_cast<const char*>(m_string), m_size);
+}
+
+int64_t
+Value::getInteger() const
+{
+  expect(TYPE_INTEGER);
+  return m_integer;
+}
+
+Range<Value>
+Value::getList() const
+{
+  expect(TYPE_LIST);
+  return Range<Value>(m_items, m_items + m_size);
+}
+
+Range<Entry>
+Value::getDictionary() const
+{
+  expect(TYPE_DICTIONARY);
+  return Range<Entry>(m_entries, m_entries + m_size);
+}
+
+const Value*
+Value::get(const std::string& key, int type) const
+{
+  if (m_type != TYPE_DICTIONARY)
+    return nullptr;
+
+  const uint8_t* keyBytes = reinterpret_cast<const uint8_t*>(key.data());
+  const Entry* entry = std::lower_bound(m_entries, m_entries + m_size, key,
+    [keyBytes] (const Entry& lhs, const std::string& rhs) {
+      return compareKeys(lhs.key.buf(), lhs.key.size(), keyBytes, rhs.size()) < 0;
+    });
+
+  if (entry == m_entries + m_size ||
+      compareKeys(entry->key.buf(), entry->key.size(), keyBytes, key.size()) != 0)
+    return nullptr;
+  if (type != 0 && entry->value.m_type != type)
+    return nullptr;
+  return &entry->value;
+}
+
+size_t
+Value::size() const
+{
+  return m_type == TYPE_INTEGER ? 0 : m_size;
+}
+
+Document::Document(const BufferView& input, shared_ptr<const void> holder)
+  : m_holder(holder)
+  , m_blockSize(0)
+  , m_blockUsed(0)
+  , m_arenaSize(0)
+{
+  parse(input);
+}
+
+Document::Document(ConstBufferPtr input)
+  : m_holder(input)
+  , m_blockSize(0)
+  , m_blockUsed(0)
+  , m_arenaSize(0)
+{
+  parse(*input);
+}
+
+size_t
+Document::getArenaSize() const
+{
+  return m_arenaSize;
+}
+
+template<class T>
+const T*
+Document::store(const T* objects, size_t n)
+{
+  if (n == 0)
+    return nullptr;
+
+  static_assert(alignof(T) <= alignof(std::max_align_t), "arena blocks are not aligned enough");
+  size_t offset = (m_blockUsed + alignof(T) - 1) / alignof(T) * alignof(T);
+  size_t length = n * sizeof(T);
+  if (m_blocks.empty() || offset + length > m_blockSize) {
+    // blocks grow with the document, so there are few of them
+    m_blockSize = std::max(std::max(MIN_BLOCK_SIZE, m_arenaSize), length);
+    m_blocks.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[m_blockSize]));
+    offset = 0;
+  }
+
+  T* destination = reinterpret_cast<T*>(m_blocks.back().get() + offset);
+  std::uninitialized_copy(objects, objects + n, destination);
+  m_blockUsed = offset + length;
+  m_arenaSize += length;
+  return destination;
+}
+
+void
+Document::parse(const BufferView& input)
+{
+  struct Frame
+  {
+    Type type;
+    size_t first;  // of its items or entries on the stacks below
+    size_t offset; // of its encoding
+    BufferView key; // in a dictionary, the key waiting for its value
+    bool hasKey;
+  };
+
+  // children of the open containers, moved to the arena when their container ends
+  std::vector<Value> items;
+  std::vector<Entry> entries;
+  Frame frames[Reader::MAX_DEPTH];
+  size_t depth = 0;
+
+  Reader reader(input);
+  Reader::Token token;
+  while (reader.next(token)) {
+    Value value;
+    value.m_wire = input.buf() + token.offset;
+
+    switch (token.type) {
+    case Reader::TOKEN_STRING:
+      value.m_type = TYPE_STRING;
+      value.m_string = token.string.buf();
+      value.m_size = token.string.size();
+      break;
+    case Reader::TOKEN_INTEGER:
+      value.m_type = TYPE_INTEGER;
+      value.m_integer = token.integer;
+      break;
+    case Reader::TOKEN_LIST:
+    case Reader::TOKEN_DICTIONARY:
+      {
+        Frame& frame = frames[depth++];
+        frame.type = token.type == Reader::TOKEN_LIST ? TYPE_LIST : TYPE_DICTIONARY;
+        frame.first = frame.type == TYPE_LIST ? items.size() : entries.size();
+        frame.offset = token.offset;
+        frame.hasKey = false;
+        continue;
+      }
+    case Reader::TOKEN_END:
+      {
+        Frame& frame = frames[--depth];
+        value.m_type = frame.type;
+        value.m_wire = input.buf() + frame.offset;
+        if (frame.type == TYPE_LIST) {
+          value.m_size = items.size() - frame.first;
+          value.m_items = store(items.data() + frame.first, value.m_size);
+          items.resize(frame.first);
+        }
+        else {
+          value.m_size = entries.size() - frame.first;
+          Entry* first = entries.data() + frame.first;
+          // keys are sorted on the wire, but not every encoder gets it right
+          if (!std::is_sorted(first, first + value.m_size, &isKeyLess))
+            std::sort(first, first + value.m_size, &isKeyLess);
+          value.m_entries = store(first, value.m_size);
+          entries.resize(frame.first);
+        }
+        break;
+      }
+    }
+    value.m_wireLength = reader.getOffset() - (value.m_wire - input.buf());
+
+    if (depth == 0) {
+      m_root = value;
+      continue;
+    }
+
+    Frame& parent = frames[depth - 1];
+    if (parent.type == TYPE_LIST)
+      items.push_back(value);
+    else if (!parent.hasKey) {
+      parent.key = value.getString(); // the reader only accepts string keys
+      parent.hasKey = true;
+    }
+    else {
+      entries.push_back(Entry{parent.key, value});
+      parent.hasKey = false;
+    }
+  }
+}
+
+} // namespace bencoding
+} // namespace sbt
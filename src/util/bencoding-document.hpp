@@ -0,0 +1,259 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_BENCODING_DOCUMENT_HPP
+#define SBT_BENCODING_DOCUMENT_HPP
+
+#include "bencoding.hpp"
+
+#include <memory>
+
+namespace sbt {
+namespace bencoding {
+
+class Value;
+
+/**
+ * @brief A key and its value in a dictionary Value
+ */
+struct Entry;
+
+/**
+ * @brief A contiguous run of list items or dictionary entries
+ */
+template<class T>
+class Range
+{
+public:
+  Range(const T* begin, const T* end)
+    : m_begin(begin)
+    , m_end(end)
+  {
+  }
+
+  const T*
+  begin() const
+  {
+    return m_begin;
+  }
+
+  const T*
+  end() const
+  {
+    return m_end;
+  }
+
+  size_t
+  size() const
+  {
+    return m_end - m_begin;
+  }
+
+  bool
+  empty() const
+  {
+    return m_begin == m_end;
+  }
+
+private:
+  const T* m_begin;
+  const T* m_end;
+};
+
+/**
+ * @brief A read-only node of a Document: a string, integer, list or dictionary
+ *
+ * Strings are views into the document's input.  List items and dictionary entries are
+ * flat arrays; dictionary entries are sorted by key, so get() is a binary search.  Every
+ * value also knows its own encoding in the input, e.g. to hash the info dictionary.
+ *
+ * Accessors for a type the value does not have throw Error.
+ */
+class Value
+{
+public:
+  Value();
+
+  Type
+  getType() const
+  {
+    return m_type;
+  }
+
+  bool
+  isString() const
+  {
+    return m_type == TYPE_STRING;
+  }
+
+  bool
+  isInteger() const
+  {
+    return m_type == TYPE_INTEGER;
+  }
+
+  bool
+  isList() const
+  {
+    return m_type == TYPE_LIST;
+  }
+
+  bool
+  isDictionary() const
+  {
+    return m_type == TYPE_DICTIONARY;
+  }
+
+  /**
+   * @brief The bytes of a string, a view into the input
+   */
+  BufferView
+  getString() const;
+
+  std::string
+  toString() const;
+
+  int64_t
+  getInteger() const;
+
+  Range<Value>
+  getList() const;
+
+  Range<Entry>
+  getDictionary() const;
+
+  /**
+   * @brief Value of @p key in a dictionary
+   * @return nullptr if this is not a dictionary, if @p key is missing, or if its value
+   *         is not of type @p type (any type if 0)
+   */
+  const Value*
+  get(const std::string& key, int type = 0) const;
+
+  /**
+   * @brief Length of a string, or number of items or entries
+   */
+  size_t
+  size() const;
+
+  /**
+   * @brief This value as it is encoded in the input
+   */
+  BufferView
+  getWire() const
+  {
+    return BufferView(m_wire, m_wireLength);
+  }
+
+private:
+  void
+  expect(Type type) const;
+
+private:
+  Type m_type;
+  size_t m_size;
+  union {
+    const uint8_t* m_string;
+    int64_t m_integer;
+    const Value* m_items;
+    const Entry* m_entries;
+  };
+  const uint8_t* m_wire;
+  size_t m_wireLength;
+
+  friend class Document;
+};
+
+struct Entry
+{
+  BufferView key;
+  Value value;
+};
+
+/**
+ * @brief Bencoded data parsed into a tree of Values
+ *
+ * An alternative to Base and its subclasses for data that is only read, such as a
+ * .torrent file or a tracker response: all Values live in a few large blocks owned by the
+ * document, and strings are not copied out of the input, so parsing takes a handful of
+ * allocations however many values there are.  The input must not change and must
+ * outlive the document.
+ */
+class Document
+{
+public:
+  /**
+   * @brief Parse @p input
+   * @param holder kept referenced as long as the document, e.g. the buffer of @p input
+   * @throw Error the input is malformed
+   */
+  explicit
+  Document(const BufferView& input, shared_ptr<const void> holder = nullptr);
+
+  /**
+   * @brief Parse @p input, which the document keeps alive
+   */
+  explicit
+  Document(ConstBufferPtr input);
+
+  Document(const Document&) = delete;
+
+  Document&
+  operator=(const Document&) = delete;
+
+  const Value&
+  getRoot() const
+  {
+    return m_root;
+  }
+
+  /**
+   * @brief Number of bytes taken by the values
+   */
+  size_t
+  getArenaSize() const;
+
+private:
+  void
+  parse(const BufferView& input);
+
+  /**
+   * @brief Copy @p n objects to the arena
+   */
+  template<class T>
+  const T*
+  store(const T* objects, size_t n);
+
+private:
+  shared_ptr<const void> m_holder;
+
+  std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+  size_t m_blockSize;
+  size_t m_blockUsed;
+  size_t m_arenaSize;
+
+  Value m_root;
+};
+
+} // namespace bencoding
+} // namespace sbt
+
+#endif // SBT_BENCODING_DOCUMENT_HPP
@@ -0,0 +1,166 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "bencoding-reader.hpp"
+
+#include <limits>
+#include <boost/lexical_cast.hpp>
+
+namespace sbt {
+namespace bencoding {
+
+const size_t Reader::MAX_DEPTH;
+
+Reader::Reader(const BufferView& input)
+  : m_begin(input.buf())
+  , m_pos(input.buf())
+  , m_end(input.buf() + input.size())
+  , m_depth(0)
+  , m_isDone(false)
+{
+}
+
+void
+Reader::fail(const std::string& what, const uint8_t* at) const
+{
+  throw Error(what + " at offset " + boost::lexical_cast<std::string>(at - m_begin));
+}
+
+uint64_t
+Reader::readNumber(uint8_t terminator, bool isNegative)
+{
+  // up to 2^63 - 1, or 2^63 for a negative integer
+  const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) +
+                         (isNegative ? 1 : 0);
+
+  const uint8_t* start = m_pos;
+  uint64_t value = 0;
+  for (; m_pos < m_end; ++m_pos) {
+    unsigned digit = *m_pos - '0';
+    if (digit > 9)
+      break;
+    if (value > (limit - digit) / 10)
+      fail("Number too large", start);
+    value = value * 10 + digit;
+  }
+
+  if (m_pos == start)
+    fail("Missing digits", start);
+  if (m_pos == m_end || *m_pos != terminator)
+    fail("Bad number terminator", m_pos);
+  // no leading zeros, and no "-0"
+  if (*start == '0' && (m_pos - start > 1 || isNegative))
+    fail("Bad number", start);
+
+  ++m_pos;
+  return value;
+}
+
+bool
+Reader::next(Token& token)
+{
+  if (m_isDone)
+    return false;
+  if (m_pos == m_end)
+    fail("Truncated input", m_pos);
+
+  token.offset = m_pos - m_begin;
+  Frame* frame = m_depth > 0 ? &m_frames[m_depth - 1] : nullptr;
+
+  uint8_t c = *m_pos;
+  if (c == 'e') {
+    if (frame == nullptr || *frame == FRAME_VALUE)
+      fail("Unexpected end", m_pos);
+    ++m_pos;
+    token.type = TOKEN_END;
+    --m_depth;
+    m_isDone = m_depth == 0;
+    return true;
+  }
+
+  if (frame != nullptr && *frame == FRAME_KEY && (c < '0' || c > '9'))
+    fail("Dictionary key is not a string", m_pos);
+
+  switch (c) {
+  case 'i':
+    {
+      ++m_pos;
+      bool isNegative = m_pos < m_end && *m_pos == '-';
+      if (isNegative)
+        ++m_pos;
+      uint64_t value = readNumber('e', isNegative);
+      token.type = TOKEN_INTEGER;
+      token.integer = isNegative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+      break;
+    }
+  case 'l':
+  case 'd':
+    if (m_depth == MAX_DEPTH)
+      fail("Nesting too deep", m_pos);
+    ++m_pos;
+    token.type = c == 'l' ? TOKEN_LIST : TOKEN_DICTIONARY;
+    m_frames[m_depth++] = c == 'l' ? FRAME_LIST : FRAME_KEY;
+    // the container is the value of the enclosing dictionary
+    if (frame != nullptr && *frame == FRAME_VALUE)
+      *frame = FRAME_KEY;
+    return true;
+  default:
+    {
+      if (c < '0' || c > '9')
+        fail("Unknown token", m_pos);
+      uint64_t length = readNumber(':', false);
+      if (length > static_cast<uint64_t>(m_end - m_pos))
+        fail("Truncated string", m_pos);
+      token.type = TOKEN_STRING;
+      token.string = BufferView(m_pos, length);
+      m_pos += length;
+      break;
+    }
+  }
+
+  // a scalar completes a key, a value, or the whole input
+  if (frame == nullptr)
+    m_isDone = true;
+  else if (*frame != FRAME_LIST)
+    *frame = *frame == FRAME_KEY ? FRAME_VALUE : FRAME_KEY;
+  return true;
+}
+
+BufferView
+Reader::skipValue()
+{
+  const uint8_t* start = m_pos;
+  size_t depth = m_depth;
+
+  Token token;
+  if (!next(token))
+    fail("No value to skip", m_pos);
+  if (token.type == TOKEN_END)
+    fail("No value to skip", start);
+
+  while (m_depth > depth)
+    next(token);
+
+  return BufferView(start, m_pos - start);
+}
+
+} // namespace bencoding
+} // namespace sbt
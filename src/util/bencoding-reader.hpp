@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_BENCODING_READER_HPP
+#define SBT_BENCODING_READER_HPP
+
+#include "bencoding.hpp"
+
+namespace sbt {
+namespace bencoding {
+
+/**
+ * @brief Pull parser for bencoding over a contiguous buffer
+ *
+ * Walks the input in a single pass and returns one token per call of next(): a string,
+ * an integer, the start of a list or dictionary, or the end of the innermost one.
+ * Strings are views into the input, which must outlive them; nothing is copied and
+ * nothing is allocated, so the reader suits large inputs such as a mapped .torrent file
+ * or a tracker response body.
+ *
+ * Inside a dictionary, tokens alternate between a key (always a string) and its value.
+ * Malformed input throws Error, with the offset of the offending byte.
+ */
+class Reader
+{
+public:
+  enum TokenType {
+    TOKEN_STRING,
+    TOKEN_INTEGER,
+    TOKEN_LIST,
+    TOKEN_DICTIONARY,
+    TOKEN_END
+  };
+
+  struct Token
+  {
+    TokenType type;
+    BufferView string; // TOKEN_STRING
+    int64_t integer;   // TOKEN_INTEGER
+    size_t offset;     // of the token in the input
+  };
+
+  /**
+   * @brief Deepest nesting of lists and dictionaries accepted
+   */
+  static const size_t MAX_DEPTH = 64;
+
+public:
+  explicit
+  Reader(const BufferView& input);
+
+  /**
+   * @brief Read the next token
+   * @return false once the top-level value is complete; trailing bytes are not read
+   */
+  bool
+  next(Token& token);
+
+  /**
+   * @brief Skip the next value, including everything inside a list or dictionary
+   * @return the encoding of the skipped value, a view into the input
+   */
+  BufferView
+  skipValue();
+
+  /**
+   * @brief Number of lists and dictionaries that are open
+   */
+  size_t
+  getDepth() const
+  {
+    return m_depth;
+  }
+
+  /**
+   * @brief Whether the next token is a dictionary key
+   */
+  bool
+  isKeyNext() const
+  {
+    return m_depth > 0 && m_frames[m_depth - 1] == FRAME_KEY;
+  }
+
+  /**
+   * @brief Offset of the next token in the input
+   */
+  size_t
+  getOffset() const
+  {
+    return m_pos - m_begin;
+  }
+
+  bool
+  isDone() const
+  {
+    return m_isDone;
+  }
+
+private:
+  enum Frame : uint8_t {
+    FRAME_LIST,
+    FRAME_KEY,  // in a dictionary, before a key
+    FRAME_VALUE // in a dictionary, before a value
+  };
+
+  void
+  fail(const std::string& what, const uint8_t* at) const;
+
+  /**
+   * @brief Parse the digits of a string length or integer up to @p terminator
+   */
+  uint64_t
+  readNumber(uint8_t terminator, bool isNegative);
+
+private:
+  const uint8_t* m_begin;
+  const uint8_t* m_pos;
+  const uint8_t* m_end;
+
+  Frame m_frames[MAX_DEPTH];
+  size_t m_depth;
+  bool m_isDone;
+};
+
+} // namespace bencoding
+} // namespace sbt
+
+#endif // SBT_BENCODING_READER_HPP
@@ -170,9 +170,9 @@ Integer::wireDecode(std::istream& is)
   if (!hasEnd)
     throw Error("Bad integer encoding 1");
 
-  int s = 0;
+  int64_t s = 0;
   try {
-    s = boost::lexical_cast<int>(size);
+    s = boost::lexical_cast<int64_t>(size);
   }
   catch(const boost::bad_lexical_cast &) {
     throw Error("Bad integer: " + size);
@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "bitset.hpp"
+
+#include <algorithm>
+#include <endian.h>
+
+namespace sbt {
+
+const size_t Bitset::npos = static_cast<size_t>(-1);
+
+static size_t
+numWords(size_t size)
+{
+  return (size + 63) / 64;
+}
+
+Bitset::Bitset()
+  : m_size(0)
+{
+}
+
+Bitset::Bitset(size_t size)
+  : m_size(size)
+  , m_words(numWords(size), 0)
+{
+}
+
+Bitset::Bitset(const BufferView& wire, size_t size)
+  : m_size(size)
+  , m_words(numWords(size), 0)
+{
+  size_t length = std::min(wire.size(), (size + 7) / 8);
+  size_t fullWords = length / 8;
+  for (size_t i = 0; i < fullWords; ++i) {
+    uint64_t word;
+    memcpy(&word, wire.buf() + i * 8, sizeof(word));
+    m_words[i] = be64toh(word);
+  }
+  for (size_t i = fullWords * 8; i < length; ++i)
+    m_words[i / 8] |= uint64_t(wire[i]) << (56 - (i % 8) * 8);
+
+  clearSpareBits();
+}
+
+void
+Bitset::resize(size_t size)
+{
+  m_words.resize(numWords(size), 0);
+  m_size = size;
+  clearSpareBits();
+}
+
+void
+Bitset::clearSpareBits()
+{
+  if (m_size % 64 != 0)
+    m_words.back() &= ~uint64_t(0) << (64 - m_size % 64);
+}
+
+void
+Bitset::setAll()
+{
+  std::fill(m_words.begin(), m_words.end(), ~uint64_t(0));
+  clearSpareBits();
+}
+
+size_t
+Bitset::count() const
+{
+  size_t n = 0;
+  for (uint64_t word : m_words)
+    n += __builtin_popcountll(word);
+  return n;
+}
+
+size_t
+Bitset::findFirst(size_t from) const
+{
+  if (from >= m_size)
+    return npos;
+
+  size_t i = from / 64;
+  uint64_t word = m_words[i] & (~uint64_t(0) >> (from % 64));
+  while (word == 0) {
+    if (++i == m_words.size())
+      return npos;
+    word = m_words[i];
+  }
+  return i * 64 + __builtin_clzll(word);
+}
+
+Bitset&
+Bitset::andNot(const Bitset& other)
+{
+  size_t n = std::min(m_words.size(), other.m_words.size());
+  uint64_t* __restrict__ words = m_words.data();
+  const uint64_t* __restrict__ otherWords = other.m_words.data();
+  for (size_t i = 0; i < n; ++i)
+    words[i] &= ~otherWords[i];
+  return *this;
+}
+
+size_t
+Bitset::countAndNot(const Bitset& other) const
+{
+  size_t n = std::min(m_words.size(), other.m_words.size());
+  size_t result = 0;
+  for (size_t i = 0; i < n; ++i)
+    result += __builtin_popcountll(m_words[i] & ~other.m_words[i]);
+  for (size_t i = n; i < m_words.size(); ++i)
+    result += __builtin_popcountll(m_words[i]);
+  return result;
+}
+
+size_t
+Bitset::findFirstAndNot(const Bitset& other, size_t from) const
+{
+  if (from >= m_size)
+    return npos;
+
+  auto wordAt = [this, &other] (size_t i) {
+    return i < other.m_words.size() ? m_words[i] & ~other.m_words[i] : m_words[i];
+  };
+
+  size_t i = from / 64;
+  uint64_t word = wordAt(i) & (~uint64_t(0) >> (from % 64));
+  while (word == 0) {
+    if (++i == m_words.size())
+      return npos;
+    word = wordAt(i);
+  }
+  return i * 64 + __builtin_clzll(word);
+}
+
+BufferPtr
+Bitset::encode() const
+{
+  auto wire = make_shared<Buffer>(m_words.size() * 8);
+  for (size_t i = 0; i < m_words.size(); ++i) {
+    uint64_t word = htobe64(m_words[i]);
+    memcpy(wire->buf() + i * 8, &word, sizeof(word));
+  }
+  wire->resize((m_size + 7) / 8);
+  return wire;
+}
+
+} // namespace sbt
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_UTIL_BITSET_HPP
+#define SBT_UTIL_BITSET_HPP
+
+#include "../common.hpp"
+#include "buffer.hpp"
+
+#include <vector>
+
+namespace sbt {
+
+/**
+ * @brief Packed set of piece indices, in the bit order of the bitfield message
+ *
+ * Bits are stored 64 to a word, with piece 0 in the most significant bit of the first
+ * word, so a word written in big-endian byte order is exactly eight bytes of the
+ * bitfield message payload.  Bits beyond size() are always zero.
+ *
+ * The set operations work on whole words in plain loops over contiguous arrays, which
+ * the compiler turns into vector instructions: "pieces the peer has that we still
+ * need" is one pass of AND-NOT over numPieces / 64 words, and finding the first such
+ * piece skips 64 pieces per step.
+ */
+class Bitset
+{
+public:
+  static const size_t npos;
+
+public:
+  Bitset();
+
+  explicit
+  Bitset(size_t size);
+
+  /**
+   * @brief Decode the payload of a bitfield message for @p size pieces
+   *
+   * Missing trailing bytes read as zero, spare bits after the last piece are ignored.
+   */
+  Bitset(const BufferView& wire, size_t size);
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  /**
+   * @brief Change the number of bits; new bits are zero
+   */
+  void
+  resize(size_t size);
+
+  bool
+  test(size_t index) const
+  {
+    return index < m_size && (m_words[index / 64] & mask(index)) != 0;
+  }
+
+  void
+  set(size_t index)
+  {
+    m_words[index / 64] |= mask(index);
+  }
+
+  void
+  reset(size_t index)
+  {
+    m_words[index / 64] &= ~mask(index);
+  }
+
+  /**
+   * @brief Set all size() bits
+   */
+  void
+  setAll();
+
+  /**
+   * @brief Number of bits set
+   */
+  size_t
+  count() const;
+
+  bool
+  none() const
+  {
+    return findFirst() == npos;
+  }
+
+  bool
+  all() const
+  {
+    return count() == m_size;
+  }
+
+  /**
+   * @brief First set bit at or after @p from, or npos
+   */
+  size_t
+  findFirst(size_t from = 0) const;
+
+  /**
+   * @brief this &= ~other; bits beyond other.size() are kept
+   */
+  Bitset&
+  andNot(const Bitset& other);
+
+  /**
+   * @brief Number of bits set here and not in @p other
+   */
+  size_t
+  countAndNot(const Bitset& other) const;
+
+  /**
+   * @brief First bit at or after @p from that is set here and not in @p other, or npos
+   */
+  size_t
+  findFirstAndNot(const Bitset& other, size_t from = 0) const;
+
+  /**
+   * @brief The payload of a bitfield message, (size() + 7) / 8 bytes
+   */
+  BufferPtr
+  encode() const;
+
+  bool
+  operator==(const Bitset& other) const
+  {
+    return m_size == other.m_size && m_words == other.m_words;
+  }
+
+  bool
+  operator!=(const Bitset& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+  static uint64_t
+  mask(size_t index)
+  {
+    return uint64_t(1) << (63 - index % 64);
+  }
+
+  /**
+   * @brief Zero the bits beyond m_size in the last word
+   */
+  void
+  clearSpareBits();
+
+private:
+  size_t m_size;
+  std::vector<uint64_t> m_words;
+};
+
+} // namespace sbt
+
+#endif // SBT_UTIL_BITSET_HPP
@@ -28,6 +28,7 @@
 namespace sbt {
 
 class Buffer;
+class BufferView;
 typedef std::shared_ptr<const Buffer> ConstBufferPtr;
 typedef std::shared_ptr<Buffer> BufferPtr;
 
@@ -128,6 +129,120 @@ public:
   print(std::ostream& os) const;
 };
 
+/**
+ * @brief Non-owning, read-only view of a contiguous byte range
+ *
+ * A view is as cheap to copy as a pointer and never allocates.  Whoever creates it
+ * must keep the underlying bytes (a Buffer, a connection's receive buffer, ...) alive
+ * and unmodified for as long as the view is used.
+ */
+class BufferView
+{
+public:
+  typedef const uint8_t* const_iterator;
+
+  static const size_t npos = static_cast<size_t>(-1);
+
+public:
+  /** @brief Creates an empty view
+   */
+  BufferView()
+    : m_buf(nullptr)
+    , m_size(0)
+  {
+  }
+
+  /** @brief Creates a view of [buf, buf + size)
+   */
+  BufferView(const void* buf, size_t size)
+    : m_buf(reinterpret_cast<const uint8_t*>(buf))
+    , m_size(size)
+  {
+  }
+
+  /** @brief Creates a view of the whole buffer
+   */
+  BufferView(const Buffer& buffer)
+    : m_buf(buffer.empty() ? nullptr : buffer.get())
+    , m_size(buffer.size())
+  {
+  }
+
+  /** @return pointer to the first byte of the view
+   */
+  const uint8_t*
+  buf() const
+  {
+    return m_buf;
+  }
+
+  /** @return pointer to the first byte of the view
+   *
+   *  This is same as \p .buf()
+   */
+  const uint8_t*
+  get() const
+  {
+    return m_buf;
+  }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_size == 0;
+  }
+
+  const_iterator
+  begin() const
+  {
+    return m_buf;
+  }
+
+  const_iterator
+  end() const
+  {
+    return m_buf + m_size;
+  }
+
+  uint8_t
+  operator[](size_t i) const
+  {
+    return m_buf[i];
+  }
+
+  /** @brief Creates a view of @p length bytes starting at @p offset
+   *
+   *  The range is clamped to the end of this view.
+   */
+  BufferView
+  slice(size_t offset, size_t length = npos) const
+  {
+    if (offset > m_size)
+      offset = m_size;
+    if (length > m_size - offset)
+      length = m_size - offset;
+    return BufferView(m_buf + offset, length);
+  }
+
+  /** @brief Copies the viewed bytes into a new Buffer
+   */
+  BufferPtr
+  copy() const
+  {
+    return std::make_shared<Buffer>(m_buf, m_size);
+  }
+
+private:
+  const uint8_t* m_buf;
+  size_t m_size;
+};
+
 } // namespace sbt
 
 #endif // SBT_UTIL_BUFFER_HPP
@@ -20,53 +20,559 @@
  */
 
 #include "hash.hpp"
+#include "sha1-lanes.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
 #include <iostream>
 #include <string>
+#include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SBT_HAVE_SHA_NI 1
+#define SBT_SHA_NI_TARGET __attribute__((target("sha,sse4.1")))
+#endif
 
 namespace sbt {
 namespace util {
 
-std::string
-sha1(const std::string& input)
+const size_t Sha1::DIGEST_LENGTH;
+const size_t Sha1::BLOCK_LENGTH;
+
+typedef void (*Sha1Compress)(uint32_t* state, const uint8_t* data, size_t numBlocks);
+
+static inline uint32_t
+rotl(uint32_t x, int n)
 {
-  using namespace CryptoPP;
+  return (x << n) | (x >> (32 - n));
+}
 
-  std::string result;
-  SHA1 hash;
+static void
+compressPortable(uint32_t* state, const uint8_t* data, size_t numBlocks)
+{
+  for (; numBlocks > 0; --numBlocks, data += Sha1::BLOCK_LENGTH) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+      w[i] = (static_cast<uint32_t>(data[4 * i]) << 24) | (data[4 * i + 1] << 16) |
+             (data[4 * i + 2] << 8) | data[4 * i + 3];
+    for (int i = 16; i < 80; ++i)
+      w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
 
-  StringSource(input, true, new HashFilter(hash, new StringSink(result)));
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      }
+      else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      }
+      else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      }
+      else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
 
-  return result;
+      uint32_t t = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
 }
 
-std::vector<uint8_t>
-sha1(const std::vector<uint8_t>& input)
+#ifdef SBT_HAVE_SHA_NI
+
+static bool
+hasShaNi()
 {
-  using namespace CryptoPP;
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  bool hasSse41 = (ecx & bit_SSE4_1) != 0;
+  bool hasSsse3 = (ecx & bit_SSSE3) != 0;
 
-  std::vector<uint8_t> result(20, 0);
-  SHA1 hash;
+  if (__get_cpuid_max(0, nullptr) < 7)
+    return false;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return hasSse41 && hasSsse3 && (ebx & bit_SHA) != 0;
+}
 
-  StringSource(&input.front(), input.size(),
-               true, new HashFilter(hash, new ArraySink(&result.front(), 20)));
+SBT_SHA_NI_TARGET static inline __m128i
+loadWords(const uint8_t* data, __m128i mask)
+{
+  return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), mask);
+}
 
-  return result;
+/**
+ * The four rounds of an sha1rnds4 share one message vector; the message schedule is
+ * interleaved with the rounds so that sha1msg1/sha1msg2 latencies overlap.
+ */
+SBT_SHA_NI_TARGET static void
+compressShaNi(uint32_t* state, const uint8_t* data, size_t numBlocks)
+{
+  const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)),
+                                   0x1b);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+  __m128i e1, msg0, msg1, msg2, msg3;
+
+  for (; numBlocks > 0; --numBlocks, data += Sha1::BLOCK_LENGTH) {
+    __m128i abcdSaved = abcd;
+    __m128i eSaved = e0;
+
+    // rounds 0-3
+    msg0 = loadWords(data, mask);
+    e0 = _mm_add_epi32(e0, msg0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    // rounds 4-7
+    msg1 = loadWords(data + 16, mask);
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+    // rounds 8-11
+    msg2 = loadWords(data + 32, mask);
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    // rounds 12-15
+    msg3 = loadWords(data + 48, mask);
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    // rounds 16-19
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    // rounds 20-23
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    // rounds 24-27
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    // rounds 28-31
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    // rounds 32-35
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    // rounds 36-39
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    // rounds 40-43
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    // rounds 44-47
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    // rounds 48-51
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    // rounds 52-55
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    // rounds 56-59
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    // rounds 60-63
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    // rounds 64-67
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    // rounds 68-71
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    // rounds 72-75
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+    // rounds 76-79
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, eSaved);
+    abcd = _mm_add_epi32(abcd, abcdSaved);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1b));
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#endif // SBT_HAVE_SHA_NI
+
+static Sha1Compress
+getCompress(Sha1::Backend backend)
+{
+#ifdef SBT_HAVE_SHA_NI
+  if (backend == Sha1::BACKEND_SHA_NI)
+    return &compressShaNi;
+#endif
+  return &compressPortable;
+}
+
+static std::atomic<Sha1Compress>&
+compressFunction()
+{
+  static std::atomic<Sha1Compress> compress(getCompress(Sha1::isSupported(Sha1::BACKEND_SHA_NI) ?
+                                                        Sha1::BACKEND_SHA_NI :
+                                                        Sha1::BACKEND_PORTABLE));
+  return compress;
+}
+
+Sha1::Sha1()
+{
+  reset();
+}
+
+void
+Sha1::reset()
+{
+  m_state[0] = 0x67452301;
+  m_state[1] = 0xefcdab89;
+  m_state[2] = 0x98badcfe;
+  m_state[3] = 0x10325476;
+  m_state[4] = 0xc3d2e1f0;
+  m_length = 0;
+}
+
+Sha1&
+Sha1::update(const uint8_t* data, size_t length)
+{
+  if (length == 0)
+    return *this;
+
+  Sha1Compress compress = compressFunction().load(std::memory_order_relaxed);
+
+  size_t buffered = m_length % BLOCK_LENGTH;
+  m_length += length;
+
+  if (buffered > 0) {
+    size_t n = std::min(length, BLOCK_LENGTH - buffered);
+    memcpy(m_buffer + buffered, data, n);
+    data += n;
+    length -= n;
+    if (buffered + n < BLOCK_LENGTH)
+      return *this;
+    compress(m_state, m_buffer, 1);
+  }
+
+  // whole blocks straight from the input, no copy
+  compress(m_state, data, length / BLOCK_LENGTH);
+  memcpy(m_buffer, data + length / BLOCK_LENGTH * BLOCK_LENGTH, length % BLOCK_LENGTH);
+  return *this;
+}
+
+Sha1&
+Sha1::update(const BufferView& data)
+{
+  return update(data.buf(), data.size());
+}
+
+void
+Sha1::final(uint8_t* digest)
+{
+  uint64_t bitLength = m_length * 8;
+
+  uint8_t padding[BLOCK_LENGTH + 8] = {0x80};
+  size_t buffered = m_length % BLOCK_LENGTH;
+  size_t padLength = (buffered < 56 ? 56 : 120) - buffered;
+  for (int i = 0; i < 8; ++i)
+    padding[padLength + i] = bitLength >> (56 - 8 * i);
+  update(padding, padLength + 8);
+
+  for (int i = 0; i < 5; ++i) {
+    digest[4 * i] = m_state[i] >> 24;
+    digest[4 * i + 1] = m_state[i] >> 16;
+    digest[4 * i + 2] = m_state[i] >> 8;
+    digest[4 * i + 3] = m_state[i];
+  }
+
+  reset();
 }
 
 ConstBufferPtr
-sha1(ConstBufferPtr input)
+Sha1::final()
 {
-  using namespace CryptoPP;
+  auto result = make_shared<Buffer>(DIGEST_LENGTH);
+  final(result->buf());
+  return result;
+}
 
-  auto result = make_shared<Buffer>(20, 0);
-  SHA1 hash;
+Sha1::Backend
+Sha1::getBackend()
+{
+  return compressFunction().load() == getCompress(BACKEND_SHA_NI) ? BACKEND_SHA_NI
+                                                                  : BACKEND_PORTABLE;
+}
+
+bool
+Sha1::isSupported(Backend backend)
+{
+#ifdef SBT_HAVE_SHA_NI
+  static const bool hasSha = hasShaNi();
+  if (backend == BACKEND_SHA_NI)
+    return hasSha;
+#else
+  if (backend == BACKEND_SHA_NI)
+    return false;
+#endif
+  return true;
+}
+
+bool
+Sha1::setBackend(Backend backend)
+{
+  if (!isSupported(backend))
+    return false;
+  compressFunction().store(getCompress(backend));
+  return true;
+}
 
-  StringSource(input->buf(), input->size(),
-               true, new HashFilter(hash, new ArraySink(result->buf(), 20)));
+typedef void (*Sha1LanesKernel)(const uint8_t* const* inputs, size_t length,
+                                uint8_t* const* digests);
+
+static size_t
+getBatchWidth(Sha1Batch::Backend backend)
+{
+  switch (backend) {
+  case Sha1Batch::BACKEND_AVX512:
+    return 16;
+  case Sha1Batch::BACKEND_AVX2:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+static Sha1LanesKernel
+getBatchKernel(Sha1Batch::Backend backend)
+{
+#ifdef SBT_HAVE_SHA1_LANES
+  if (backend == Sha1Batch::BACKEND_AVX512)
+    return &detail::sha1LanesAvx512;
+  if (backend == Sha1Batch::BACKEND_AVX2)
+    return &detail::sha1LanesAvx2;
+#endif
+  return nullptr;
+}
+
+static std::atomic<int>&
+batchBackend()
+{
+  static std::atomic<int> backend(Sha1Batch::isSupported(Sha1Batch::BACKEND_AVX512) ?
+                                        Sha1Batch::BACKEND_AVX512 :
+                                        Sha1Batch::isSupported(Sha1Batch::BACKEND_AVX2) ?
+                                        Sha1Batch::BACKEND_AVX2 :
+                                        Sha1Batch::BACKEND_SEQUENTIAL);
+  return backend;
+}
+
+void
+Sha1Batch::hash(const BufferView* inputs, size_t count, uint8_t* digests)
+{
+  Backend backend = getBackend();
+  Sha1LanesKernel kernel = getBatchKernel(backend);
+  size_t width = getBatchWidth(backend);
+
+  bool isSameLength = true;
+  for (size_t i = 1; i < count && isSameLength; ++i)
+    isSameLength = inputs[i].size() == inputs[0].size();
+
+  size_t i = 0;
+  if (kernel != nullptr && isSameLength) {
+    const uint8_t* lanes[16];
+    uint8_t* laneDigests[16];
+    uint8_t scratch[Sha1::DIGEST_LENGTH];
+
+    // a pass costs the same however many lanes are used: about as much as hashing half
+    // as many inputs one by one on the SHA extensions, but less than two without them
+    size_t minLanes = Sha1::getBackend() == Sha1::BACKEND_SHA_NI ? width / 2 : 2;
+    while (i < count && count - i >= minLanes) {
+      for (size_t lane = 0; lane < width; ++lane) {
+        bool isUsed = i + lane < count;
+        lanes[lane] = inputs[isUsed ? i + lane : i].buf();
+        laneDigests[lane] = isUsed ? digests + (i + lane) * Sha1::DIGEST_LENGTH : scratch;
+      }
+      kernel(lanes, inputs[i].size(), laneDigests);
+      i += std::min(width, count - i);
+    }
+  }
+
+  for (; i < count; ++i)
+    Sha1().update(inputs[i]).final(digests + i * Sha1::DIGEST_LENGTH);
+}
 
+size_t
+Sha1Batch::getWidth()
+{
+  return getBatchWidth(getBackend());
+}
+
+Sha1Batch::Backend
+Sha1Batch::getBackend()
+{
+  return static_cast<Backend>(batchBackend().load(std::memory_order_relaxed));
+}
+
+bool
+Sha1Batch::isSupported(Backend backend)
+{
+#ifdef SBT_HAVE_SHA1_LANES
+  if (backend == BACKEND_AVX512)
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+  if (backend == BACKEND_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+  if (backend != BACKEND_SEQUENTIAL)
+    return false;
+#endif
+  return true;
+}
+
+bool
+Sha1Batch::setBackend(Backend backend)
+{
+  if (!isSupported(backend))
+    return false;
+  batchBackend().store(backend);
+  return true;
+}
+
+DigestTable::DigestTable(const BufferView& digests, shared_ptr<const void> holder)
+  : m_digests(digests)
+  , m_holder(holder)
+{
+  if (digests.size() % Sha1::DIGEST_LENGTH != 0)
+    throw std::invalid_argument("Digest table length is not a multiple of " +
+                                std::to_string(Sha1::DIGEST_LENGTH));
+}
+
+std::string
+sha1(const std::string& input)
+{
+  uint8_t digest[Sha1::DIGEST_LENGTH];
+  Sha1().update(reinterpret_cast<const uint8_t*>(input.data()), input.size()).final(digest);
+  return std::string(digest, digest + sizeof(digest));
+}
+
+std::vector<uint8_t>
+sha1(const std::vector<uint8_t>& input)
+{
+  std::vector<uint8_t> result(Sha1::DIGEST_LENGTH, 0);
+  Sha1().update(input.data(), input.size()).final(&result.front());
   return result;
 }
 
+ConstBufferPtr
+sha1(ConstBufferPtr input)
+{
+  return Sha1().update(input->buf(), input->size()).final();
+}
+
+ConstBufferPtr
+sha1(const BufferView& input)
+{
+  return Sha1().update(input).final();
+}
+
 } // namespace util
 } // namespace sbt
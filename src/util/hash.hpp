@@ -25,9 +25,173 @@
 #include "cryptopp.hpp"
 #include "buffer.hpp"
 
+#include <string.h>
+
 namespace sbt {
 namespace util {
 
+/**
+ * @brief Incremental SHA-1: feed the input in any number of update() calls, then final()
+ *
+ * Lets a piece be hashed block by block while it downloads, so that its digest is ready
+ * when the last block arrives.  The compression function runs on the x86 SHA extensions
+ * when the CPU has them, otherwise on portable code; the backend is picked at runtime,
+ * the first time a hasher is used.
+ */
+class Sha1
+{
+public:
+  static const size_t DIGEST_LENGTH = 20;
+  static const size_t BLOCK_LENGTH = 64;
+
+  enum Backend {
+    BACKEND_PORTABLE,
+    BACKEND_SHA_NI
+  };
+
+public:
+  Sha1();
+
+  /**
+   * @brief Start over with an empty input
+   */
+  void
+  reset();
+
+  Sha1&
+  update(const uint8_t* data, size_t length);
+
+  Sha1&
+  update(const BufferView& data);
+
+  /**
+   * @brief Write the DIGEST_LENGTH byte digest of everything fed so far to @p digest
+   *
+   * The hasher is reset afterwards.
+   */
+  void
+  final(uint8_t* digest);
+
+  ConstBufferPtr
+  final();
+
+  /**
+   * @brief Number of bytes fed since the last reset
+   */
+  uint64_t
+  getLength() const
+  {
+    return m_length;
+  }
+
+  static Backend
+  getBackend();
+
+  static bool
+  isSupported(Backend backend);
+
+  /**
+   * @brief Force @p backend for all hashers, e.g. to test or benchmark the portable one
+   * @return false (and nothing changes) if the CPU cannot run @p backend
+   */
+  static bool
+  setBackend(Backend backend);
+
+private:
+  uint32_t m_state[5];
+  uint8_t m_buffer[BLOCK_LENGTH];
+  uint64_t m_length;
+};
+
+/**
+ * @brief SHA-1 of many independent inputs of the same length at once
+ *
+ * Inputs are hashed side by side, one per 32-bit lane of AVX-512 (16 at a time) or AVX2
+ * (8 at a time) registers, which pays off when many pieces are verified together, e.g.
+ * during a recheck.  The backend is picked at runtime; without a vector unit, or for
+ * inputs of different lengths, they are hashed one after the other with Sha1.
+ */
+class Sha1Batch
+{
+public:
+  enum Backend {
+    BACKEND_SEQUENTIAL,
+    BACKEND_AVX2,
+    BACKEND_AVX512
+  };
+
+public:
+  /**
+   * @brief Write the Sha1::DIGEST_LENGTH byte digest of inputs[i] to digests + i * 20
+   */
+  static void
+  hash(const BufferView* inputs, size_t count, uint8_t* digests);
+
+  /**
+   * @brief Number of inputs hashed per pass; batches of fewer inputs waste lanes
+   */
+  static size_t
+  getWidth();
+
+  static Backend
+  getBackend();
+
+  static bool
+  isSupported(Backend backend);
+
+  /**
+   * @brief Force @p backend, e.g. to test or benchmark it
+   * @return false (and nothing changes) if the CPU cannot run @p backend
+   */
+  static bool
+  setBackend(Backend backend);
+};
+
+/**
+ * @brief A read-only array of SHA-1 digests stored back to back, e.g. the piece hashes
+ *        of a torrent
+ *
+ * The table is a view; it keeps whatever holds the digests alive through @p holder.
+ */
+class DigestTable
+{
+public:
+  DigestTable()
+  {
+  }
+
+  /**
+   * @throw std::invalid_argument the length of @p digests is not a multiple of
+   *        Sha1::DIGEST_LENGTH
+   */
+  DigestTable(const BufferView& digests, shared_ptr<const void> holder);
+
+  size_t
+  size() const
+  {
+    return m_digests.size() / Sha1::DIGEST_LENGTH;
+  }
+
+  /**
+   * @brief The Sha1::DIGEST_LENGTH bytes of digest @p index
+   */
+  const uint8_t*
+  operator[](size_t index) const
+  {
+    return m_digests.buf() + index * Sha1::DIGEST_LENGTH;
+  }
+
+  bool
+  matches(size_t index, const uint8_t* digest) const
+  {
+    return memcmp((*this)[index], digest, Sha1::DIGEST_LENGTH) == 0;
+  }
+
+private:
+  BufferView m_digests;
+  shared_ptr<const void> m_holder;
+};
+
 std::string
 sha1(const std::string& input);
 
@@ -37,6 +201,9 @@ sha1(const std::vector<uint8_t>& input);
 ConstBufferPtr
 sha1(ConstBufferPtr input);
 
+ConstBufferPtr
+sha1(const BufferView& input);
+
 } // namespace util
 } // namespace sbt
 
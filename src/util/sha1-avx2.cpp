@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Everything in this file, the lane template included, may use AVX2; it is called only
+// after Sha1Batch checked that the CPU has it.  Nothing from C++ headers is compiled in
+// here, so no inline function with AVX2 code can leak into the rest of the program.
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+#include "sha1-lanes.hpp"
+
+namespace sbt {
+namespace util {
+namespace detail {
+
+namespace {
+
+struct Avx2Ops
+{
+  typedef __m256i Vector;
+  static const size_t WIDTH = 8;
+
+  static Vector
+  set1(uint32_t x)
+  {
+    return _mm256_set1_epi32(x);
+  }
+
+  static Vector
+  add(Vector a, Vector b)
+  {
+    return _mm256_add_epi32(a, b);
+  }
+
+  template<int N>
+  static Vector
+  rotl(Vector x)
+  {
+    return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N));
+  }
+
+  static Vector
+  choose(Vector b, Vector c, Vector d)
+  {
+    return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+  }
+
+  static Vector
+  parity(Vector b, Vector c, Vector d)
+  {
+    return _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+  }
+
+  static Vector
+  majority(Vector b, Vector c, Vector d)
+  {
+    return _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+  }
+
+  static Vector
+  xor4(Vector a, Vector b, Vector c, Vector d)
+  {
+    return _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d));
+  }
+
+  /**
+   * Two 8x8 transposes of 32-byte rows, one per half block
+   */
+  static void
+  loadBlock(const uint8_t* const* lanes, size_t offset, Vector* words)
+  {
+    const Vector swap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    for (size_t half = 0; half < 2; ++half) {
+      Vector r[8];
+      for (int i = 0; i < 8; ++i)
+        r[i] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const Vector*>(
+                                     lanes[i] + offset + half * 32)), swap);
+
+      Vector t[8];
+      for (int i = 0; i < 4; ++i) {
+        t[2 * i] = _mm256_unpacklo_epi32(r[2 * i], r[2 * i + 1]);
+        t[2 * i + 1] = _mm256_unpackhi_epi32(r[2 * i], r[2 * i + 1]);
+      }
+
+      // u[4i + j] holds column j of each 128-bit half, for rows 4i .. 4i + 3
+      Vector u[8];
+      for (int i = 0; i < 2; ++i) {
+        u[4 * i] = _mm256_unpacklo_epi64(t[4 * i], t[4 * i + 2]);
+        u[4 * i + 1] = _mm256_unpackhi_epi64(t[4 * i], t[4 * i + 2]);
+        u[4 * i + 2] = _mm256_unpacklo_epi64(t[4 * i + 1], t[4 * i + 3]);
+        u[4 * i + 3] = _mm256_unpackhi_epi64(t[4 * i + 1], t[4 * i + 3]);
+      }
+
+      Vector* out = words + half * 8;
+      for (int j = 0; j < 4; ++j) {
+        out[j] = _mm256_permute2x128_si256(u[j], u[4 + j], 0x20);
+        out[4 + j] = _mm256_permute2x128_si256(u[j], u[4 + j], 0x31);
+      }
+    }
+  }
+
+  static void
+  store(uint32_t* out, Vector x)
+  {
+    _mm256_storeu_si256(reinterpret_cast<Vector*>(out), x);
+  }
+};
+
+} // namespace
+
+void
+sha1LanesAvx2(const uint8_t* const* inputs, size_t length, uint8_t* const* digests)
+{
+  sha1Lanes<Avx2Ops>(inputs, length, digests);
+}
+
+} // namespace detail
+} // namespace util
+} // namespace sbt
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // __x86_64__ || __i386__
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// As in sha1-avx2.cpp: everything in this file may use AVX-512 and runs only after
+// Sha1Batch checked that the CPU has AVX-512F and AVX-512BW.
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#else
+#pragma GCC target("avx512f,avx512bw")
+#endif
+
+#include <immintrin.h>
+#include "sha1-lanes.hpp"
+
+namespace sbt {
+namespace util {
+namespace detail {
+
+namespace {
+
+struct Avx512Ops
+{
+  typedef __m512i Vector;
+  static const size_t WIDTH = 16;
+
+  // The plain forms of some intrinsics pass an undefined vector as the merge source,
+  // which GCC 12 reports as maybe uninitialized.  Their zero-masking forms take a zero
+  // vector instead; with every lane selected they compile to the same instructions.
+  static const __mmask16 ALL = 0xffff;
+  static const __mmask8 ALL_QWORDS = 0xff;
+
+  static Vector
+  set1(uint32_t x)
+  {
+    return _mm512_set1_epi32(x);
+  }
+
+  static Vector
+  add(Vector a, Vector b)
+  {
+    return _mm512_add_epi32(a, b);
+  }
+
+  template<int N>
+  static Vector
+  rotl(Vector x)
+  {
+    return _mm512_maskz_rol_epi32(ALL, x, N);
+  }
+
+  // three-input boolean functions are a single ternary logic instruction each
+  static Vector
+  choose(Vector b, Vector c, Vector d)
+  {
+    return _mm512_ternarylogic_epi32(b, c, d, 0xca);
+  }
+
+  static Vector
+  parity(Vector b, Vector c, Vector d)
+  {
+    return _mm512_ternarylogic_epi32(b, c, d, 0x96);
+  }
+
+  static Vector
+  majority(Vector b, Vector c, Vector d)
+  {
+    return _mm512_ternarylogic_epi32(b, c, d, 0xe8);
+  }
+
+  static Vector
+  xor4(Vector a, Vector b, Vector c, Vector d)
+  {
+    return _mm512_xor_si512(_mm512_ternarylogic_epi32(a, b, c, 0x96), d);
+  }
+
+  /**
+   * 16x16 transpose: a whole block from every lane, one 64-byte row each
+   */
+  static void
+  loadBlock(const uint8_t* const* lanes, size_t offset, Vector* words)
+  {
+    const Vector swap = _mm512_set4_epi32(0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203);
+
+    Vector r[16];
+    for (int i = 0; i < 16; ++i)
+      r[i] = _mm512_shuffle_epi8(_mm512_loadu_si512(lanes[i] + offset), swap);
+
+    Vector t[16];
+    for (int i = 0; i < 8; ++i) {
+      t[2 * i] = _mm512_maskz_unpacklo_epi32(ALL, r[2 * i], r[2 * i + 1]);
+      t[2 * i + 1] = _mm512_maskz_unpackhi_epi32(ALL, r[2 * i], r[2 * i + 1]);
+    }
+
+    // u[4i + j] holds column j of each 128-bit quarter, for rows 4i .. 4i + 3
+    Vector u[16];
+    for (int i = 0; i < 4; ++i) {
+      u[4 * i] = _mm512_maskz_unpacklo_epi64(ALL_QWORDS, t[4 * i], t[4 * i + 2]);
+      u[4 * i + 1] = _mm512_maskz_unpackhi_epi64(ALL_QWORDS, t[4 * i], t[4 * i + 2]);
+      u[4 * i + 2] = _mm512_maskz_unpacklo_epi64(ALL_QWORDS, t[4 * i + 1], t[4 * i + 3]);
+      u[4 * i + 3] = _mm512_maskz_unpackhi_epi64(ALL_QWORDS, t[4 * i + 1], t[4 * i + 3]);
+    }
+
+    for (int j = 0; j < 4; ++j) {
+      Vector lo1 = _mm512_maskz_shuffle_i32x4(ALL, u[j], u[4 + j], 0x44);
+      Vector hi1 = _mm512_maskz_shuffle_i32x4(ALL, u[j], u[4 + j], 0xee);
+      Vector lo2 = _mm512_maskz_shuffle_i32x4(ALL, u[8 + j], u[12 + j], 0x44);
+      Vector hi2 = _mm512_maskz_shuffle_i32x4(ALL, u[8 + j], u[12 + j], 0xee);
+      words[j] = _mm512_maskz_shuffle_i32x4(ALL, lo1, lo2, 0x88);
+      words[4 + j] = _mm512_maskz_shuffle_i32x4(ALL, lo1, lo2, 0xdd);
+      words[8 + j] = _mm512_maskz_shuffle_i32x4(ALL, hi1, hi2, 0x88);
+      words[12 + j] = _mm512_maskz_shuffle_i32x4(ALL, hi1, hi2, 0xdd);
+    }
+  }
+
+  static void
+  store(uint32_t* out, Vector x)
+  {
+    _mm512_storeu_si512(out, x);
+  }
+};
+
+} // namespace
+
+void
+sha1LanesAvx512(const uint8_t* const* inputs, size_t length, uint8_t* const* digests)
+{
+  sha1Lanes<Avx512Ops>(inputs, length, digests);
+}
+
+} // namespace detail
+} // namespace util
+} // namespace sbt
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // __x86_64__ || __i386__
@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_UTIL_SHA1_LANES_HPP
+#define SBT_UTIL_SHA1_LANES_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SBT_HAVE_SHA1_LANES 1
+#endif
+
+namespace sbt {
+namespace util {
+namespace detail {
+
+/**
+ * @brief Multi-buffer SHA-1 kernels, used by Sha1Batch
+ *
+ * Each hashes Ops::WIDTH inputs of @p length bytes, one per 32-bit lane, and writes
+ * the digest of input i to digests[i].  They may be called only if the CPU has the
+ * instruction set.
+ */
+void
+sha1LanesAvx2(const uint8_t* const* inputs, size_t length, uint8_t* const* digests);
+
+void
+sha1LanesAvx512(const uint8_t* const* inputs, size_t length, uint8_t* const* digests);
+
+/**
+ * Everything below is instantiated only in the translation units that define the
+ * kernels, after they switched the instruction set on; Ops supplies the vector type and
+ * its operations:
+ *
+ *   typedef ... Vector;
+ *   static const size_t WIDTH;
+ *   static Vector set1(uint32_t);
+ *   static Vector add(Vector, Vector);
+ *   template<int N> static Vector rotl(Vector);
+ *   static Vector choose(Vector, Vector, Vector);   // (b & c) | (~b & d)
+ *   static Vector parity(Vector, Vector, Vector);   // b ^ c ^ d
+ *   static Vector majority(Vector, Vector, Vector); // (b & c) | (b & d) | (c & d)
+ *   static Vector xor4(Vector, Vector, Vector, Vector);
+ *   static void loadBlock(const uint8_t* const* lanes, size_t offset, Vector* words);
+ *   static void store(uint32_t* out, Vector);
+ *
+ * loadBlock() reads 64 bytes at @p offset of every lane and transposes them into the 16
+ * big-endian message words.
+ */
+template<class Ops>
+static inline void
+sha1LaneRound(typename Ops::Vector* v, typename Ops::Vector f, typename Ops::Vector k,
+              typename Ops::Vector w)
+{
+  // v = {a, b, c, d, e}
+  typename Ops::Vector t = Ops::add(Ops::add(Ops::template rotl<5>(v[0]), f),
+                                    Ops::add(Ops::add(v[4], k), w));
+  v[4] = v[3];
+  v[3] = v[2];
+  v[2] = Ops::template rotl<30>(v[1]);
+  v[1] = v[0];
+  v[0] = t;
+}
+
+template<class Ops>
+static inline typename Ops::Vector
+sha1LaneSchedule(typename Ops::Vector* w, int t)
+{
+  if (t >= 16)
+    w[t & 15] = Ops::template rotl<1>(Ops::xor4(w[(t - 3) & 15], w[(t - 8) & 15],
+                                                w[(t - 14) & 15], w[t & 15]));
+  return w[t & 15];
+}
+
+template<class Ops>
+static void
+sha1LaneCompress(typename Ops::Vector* state, const uint8_t* const* lanes, size_t offset,
+                 size_t numBlocks)
+{
+  typedef typename Ops::Vector Vector;
+
+  const Vector k0 = Ops::set1(0x5a827999);
+  const Vector k1 = Ops::set1(0x6ed9eba1);
+  const Vector k2 = Ops::set1(0x8f1bbcdc);
+  const Vector k3 = Ops::set1(0xca62c1d6);
+
+  for (; numBlocks > 0; --numBlocks, offset += 64) {
+    Vector w[16];
+    Ops::loadBlock(lanes, offset, w);
+
+    Vector v[5] = {state[0], state[1], state[2], state[3], state[4]};
+    int t = 0;
+    for (; t < 20; ++t)
+      sha1LaneRound<Ops>(v, Ops::choose(v[1], v[2], v[3]), k0, sha1LaneSchedule<Ops>(w, t));
+    for (; t < 40; ++t)
+      sha1LaneRound<Ops>(v, Ops::parity(v[1], v[2], v[3]), k1, sha1LaneSchedule<Ops>(w, t));
+    for (; t < 60; ++t)
+      sha1LaneRound<Ops>(v, Ops::majority(v[1], v[2], v[3]), k2, sha1LaneSchedule<Ops>(w, t));
+    for (; t < 80; ++t)
+      sha1LaneRound<Ops>(v, Ops::parity(v[1], v[2], v[3]), k3, sha1LaneSchedule<Ops>(w, t));
+
+    for (int i = 0; i < 5; ++i)
+      state[i] = Ops::add(state[i], v[i]);
+  }
+}
+
+template<class Ops>
+static void
+sha1Lanes(const uint8_t* const* inputs, size_t length, uint8_t* const* digests)
+{
+  typedef typename Ops::Vector Vector;
+  const size_t width = Ops::WIDTH;
+
+  Vector state[5] = {Ops::set1(0x67452301), Ops::set1(0xefcdab89), Ops::set1(0x98badcfe),
+                     Ops::set1(0x10325476), Ops::set1(0xc3d2e1f0)};
+
+  // whole blocks are read in place, the rest goes through a padded copy
+  size_t numBlocks = length / 64;
+  sha1LaneCompress<Ops>(state, inputs, 0, numBlocks);
+
+  size_t rest = length % 64;
+  size_t tailLength = rest < 56 ? 64 : 128;
+  uint64_t bitLength = static_cast<uint64_t>(length) * 8;
+
+  uint8_t tails[width][128];
+  const uint8_t* tailLanes[width];
+  for (size_t lane = 0; lane < width; ++lane) {
+    uint8_t* tail = tails[lane];
+    memcpy(tail, inputs[lane] + numBlocks * 64, rest);
+    memset(tail + rest, 0, tailLength - rest);
+    tail[rest] = 0x80;
+    for (int i = 0; i < 8; ++i)
+      tail[tailLength - 8 + i] = bitLength >> (56 - 8 * i);
+    tailLanes[lane] = tail;
+  }
+  sha1LaneCompress<Ops>(state, tailLanes, 0, tailLength / 64);
+
+  uint32_t words[5][width];
+  for (int i = 0; i < 5; ++i)
+    Ops::store(words[i], state[i]);
+
+  for (size_t lane = 0; lane < width; ++lane) {
+    for (int i = 0; i < 5; ++i) {
+      digests[lane][4 * i] = words[i][lane] >> 24;
+      digests[lane][4 * i + 1] = words[i][lane] >> 16;
+      digests[lane][4 * i + 2] = words[i][lane] >> 8;
+      digests[lane][4 * i + 3] = words[i][lane];
+    }
+  }
+}
+
+} // namespace detail
+} // namespace util
+} // namespace sbt
+
+#endif // SBT_UTIL_SHA1_LANES_HPP
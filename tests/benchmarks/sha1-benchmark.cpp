@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+/**
+ * Hashing throughput of the SHA-1 backends on piece-sized inputs:
+ *
+ *   ./build/sha1-benchmark [piece length in KiB] [number of pieces]
+ *
+ * "cryptopp" is the CryptoPP path util::sha1 used to take; "sequential" rows hash one
+ * piece after the other with util::Sha1, "batch" rows hash all pieces with
+ * util::Sha1Batch.
+ */
+
+#include "util/hash.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+namespace sbt {
+namespace benchmark {
+
+static const int ROUNDS = 5;
+
+template<class Function>
+static void
+measure(const std::string& name, size_t totalLength, const Function& function)
+{
+  using namespace std::chrono;
+
+  function(); // warm up caches and the CPU clock
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    auto start = steady_clock::now();
+    function();
+    double seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    if (round == 0 || seconds < best)
+      best = seconds;
+  }
+
+  std::cout << std::left << std::setw(24) << name << std::right << std::setw(10)
+            << std::fixed << std::setprecision(1) << totalLength / best / (1 << 20)
+            << " MiB/s" << std::endl;
+}
+
+static int
+run(size_t pieceLength, size_t numPieces)
+{
+  Buffer payload(pieceLength * numPieces);
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = (i * 2654435761u) >> 24;
+
+  std::vector<BufferView> pieces;
+  for (size_t i = 0; i < numPieces; ++i)
+    pieces.push_back(BufferView(payload).slice(i * pieceLength, pieceLength));
+  std::vector<uint8_t> digests(numPieces * util::Sha1::DIGEST_LENGTH);
+
+  std::cout << numPieces << " pieces of " << pieceLength / 1024 << " KiB" << std::endl;
+
+  measure("cryptopp", payload.size(), [&] {
+      CryptoPP::SHA1 hash;
+      for (size_t i = 0; i < numPieces; ++i)
+        hash.CalculateDigest(&digests[i * util::Sha1::DIGEST_LENGTH], pieces[i].buf(),
+                             pieces[i].size());
+    });
+
+  const char* sha1Names[] = {"sequential portable", "sequential sha-ni"};
+  for (auto backend : {util::Sha1::BACKEND_PORTABLE, util::Sha1::BACKEND_SHA_NI}) {
+    if (!util::Sha1::setBackend(backend))
+      continue;
+    measure(sha1Names[backend], payload.size(), [&] {
+        for (size_t i = 0; i < numPieces; ++i)
+          util::Sha1().update(pieces[i]).final(&digests[i * util::Sha1::DIGEST_LENGTH]);
+      });
+  }
+  util::Sha1::setBackend(util::Sha1::isSupported(util::Sha1::BACKEND_SHA_NI) ?
+                         util::Sha1::BACKEND_SHA_NI : util::Sha1::BACKEND_PORTABLE);
+
+  const char* batchNames[] = {"batch sequential", "batch avx2", "batch avx512"};
+  for (auto backend : {util::Sha1Batch::BACKEND_SEQUENTIAL, util::Sha1Batch::BACKEND_AVX2,
+                       util::Sha1Batch::BACKEND_AVX512}) {
+    if (!util::Sha1Batch::setBackend(backend))
+      continue;
+    measure(batchNames[backend], payload.size(), [&] {
+        util::Sha1Batch::hash(pieces.data(), numPieces, digests.data());
+      });
+  }
+
+  return 0;
+}
+
+} // namespace benchmark
+} // namespace sbt
+
+int
+main(int argc, char** argv)
+{
+  try {
+    size_t pieceLength = (argc > 1 ? boost::lexical_cast<size_t>(argv[1]) : 256) * 1024;
+    size_t numPieces = argc > 2 ? boost::lexical_cast<size_t>(argv[2]) : 64;
+    return sbt::benchmark::run(pieceLength, numPieces);
+  }
+  catch (const boost::bad_lexical_cast&) {
+    std::cerr << "usage: " << argv[0] << " [piece length in KiB] [number of pieces]"
+              << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#ifndef SBT_TESTS_UNIT_TESTS_FAKE_TRACKER_HPP
+#define SBT_TESTS_UNIT_TESTS_FAKE_TRACKER_HPP
+
+#include "net/reactor.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+/**
+ * @brief A tracker on the loopback interface, driven by hand from the test
+ */
+class FakeTracker
+{
+public:
+  FakeTracker()
+    : m_conn(-1)
+  {
+    m_sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    BOOST_REQUIRE_EQUAL(bind(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    BOOST_REQUIRE_EQUAL(listen(m_sock, 4), 0);
+    net::Reactor::setNonBlocking(m_sock);
+
+    socklen_t length = sizeof(addr);
+    getsockname(m_sock, reinterpret_cast<sockaddr*>(&addr), &length);
+    m_port = std::to_string(ntohs(addr.sin_port));
+  }
+
+  ~FakeTracker()
+  {
+    if (m_conn != -1)
+      close(m_conn);
+    close(m_sock);
+  }
+
+  const std::string&
+  getPort() const
+  {
+    return m_port;
+  }
+
+  std::string
+  getUrl(const std::string& path = "/announce") const
+  {
+    return "http://127.0.0.1:" + m_port + path;
+  }
+
+  /**
+   * @brief Run @p reactor until @p nRequests complete requests have arrived
+   */
+  std::string
+  receiveRequest(net::Reactor& reactor, size_t nRequests = 1)
+  {
+    std::string request;
+    for (int i = 0; i < 200 && countRequests(request) < nRequests; ++i) {
+      reactor.runOnce(5);
+      if (m_conn == -1) {
+        m_conn = accept(m_sock, nullptr, nullptr);
+        if (m_conn == -1)
+          continue;
+        net::Reactor::setNonBlocking(m_conn);
+      }
+
+      char buf[1024];
+      ssize_t res;
+      while ((res = read(m_conn, buf, sizeof(buf))) > 0)
+        request.append(buf, res);
+    }
+    return request;
+  }
+
+  static size_t
+  countRequests(const std::string& data)
+  {
+    size_t n = 0;
+    for (size_t pos = data.find("\r\n\r\n"); pos != std::string::npos;
+         pos = data.find("\r\n\r\n", pos + 4))
+      ++n;
+    return n;
+  }
+
+  void
+  send(const std::string& data)
+  {
+    BOOST_REQUIRE_EQUAL(write(m_conn, data.data(), data.size()), data.size());
+  }
+
+  /**
+   * @brief Answer the oldest request with status 200 and @p body
+   */
+  void
+  sendBody(const std::string& body)
+  {
+    send("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" +
+         body);
+  }
+
+  void
+  disconnect()
+  {
+    close(m_conn);
+    m_conn = -1;
+  }
+
+private:
+  int m_sock;
+  int m_conn;
+  std::string m_port;
+};
+
+} // namespace test
+} // namespace sbt
+
+#endif // SBT_TESTS_UNIT_TESTS_FAKE_TRACKER_HPP
@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "util/bencoding-document.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace bencoding {
+namespace test {
+
+static std::string
+str(const BufferView& view)
+{
+  return std::string(view.begin(), view.end());
+}
+
+BOOST_AUTO_TEST_SUITE(TestBencodingDocument)
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+  std::string wire("d8:announce3:url4:infod5:filesld6:lengthi10e4:pathl1:a1:beee"
+                   "4:name6:sample12:piece lengthi-2eee");
+  auto input = make_shared<Buffer>(wire.data(), wire.size());
+  Document document(input);
+
+  const Value& root = document.getRoot();
+  BOOST_REQUIRE(root.isDictionary());
+  BOOST_CHECK_EQUAL(root.size(), 2);
+  BOOST_CHECK_EQUAL(str(root.getWire()), wire);
+
+  BOOST_REQUIRE(root.get("announce") != nullptr);
+  BOOST_CHECK_EQUAL(root.get("announce")->toString(), "url");
+  // strings are not copied
+  BOOST_CHECK(root.get("announce")->getString().buf() == input->buf() + 13);
+  BOOST_CHECK(root.get("announce", TYPE_INTEGER) == nullptr);
+  BOOST_CHECK(root.get("missing") == nullptr);
+  BOOST_CHECK(root.get("info")->get("piece") == nullptr);
+
+  const Value* info = root.get("info", TYPE_DICTIONARY);
+  BOOST_REQUIRE(info != nullptr);
+  BOOST_CHECK_EQUAL(str(info->getWire()), wire.substr(22, wire.size() - 23));
+  BOOST_CHECK_EQUAL(info->get("piece length")->getInteger(), -2);
+  BOOST_CHECK_EQUAL(info->get("name")->toString(), "sample");
+
+  Range<Value> files = info->get("files")->getList();
+  BOOST_REQUIRE_EQUAL(files.size(), 1);
+  const Value& file = *files.begin();
+  BOOST_CHECK_EQUAL(file.get("length")->getInteger(), 10);
+  std::vector<std::string> path;
+  for (const Value& item : file.get("path")->getList())
+    path.push_back(item.toString());
+  BOOST_CHECK(path == (std::vector<std::string>{"a", "b"}));
+
+  std::vector<std::string> keys;
+  for (const Entry& entry : info->getDictionary())
+    keys.push_back(str(entry.key));
+  BOOST_CHECK(keys == (std::vector<std::string>{"files", "name", "piece length"}));
+
+  BOOST_CHECK_THROW(info->getInteger(), Error);
+  BOOST_CHECK_THROW(info->getList(), Error);
+  BOOST_CHECK_THROW(Document(BufferView(wire.data(), wire.size() - 1)), Error);
+}
+
+BOOST_AUTO_TEST_CASE(Unsorted)
+{
+  std::string wire("d1:ci3e1:ai1e2:bbi2e1:bi4ee");
+  Document document(BufferView(wire.data(), wire.size()));
+  const Value& root = document.getRoot();
+
+  BOOST_CHECK_EQUAL(root.get("a")->getInteger(), 1);
+  BOOST_CHECK_EQUAL(root.get("b")->getInteger(), 4);
+  BOOST_CHECK_EQUAL(root.get("bb")->getInteger(), 2);
+  BOOST_CHECK_EQUAL(root.get("c")->getInteger(), 3);
+  BOOST_CHECK_EQUAL(str(root.getDictionary().begin()->key), "a");
+}
+
+BOOST_AUTO_TEST_CASE(Large)
+{
+  const size_t nItems = 100000;
+  std::string wire("l");
+  for (size_t i = 0; i < nItems; ++i)
+    wire += "d1:" + std::to_string(i % 10) + "1:xe";
+  wire += "e";
+
+  Document document(BufferView(wire.data(), wire.size()));
+  Range<Value> list = document.getRoot().getList();
+  BOOST_REQUIRE_EQUAL(list.size(), nItems);
+  BOOST_CHECK_EQUAL(list.begin()[12345].getDictionary().begin()->value.toString(), "x");
+  BOOST_CHECK_EQUAL(str(list.begin()[12345].getDictionary().begin()->key), "5");
+
+  // one list node per item and one entry per dictionary, nothing else
+  BOOST_CHECK_EQUAL(document.getArenaSize(), nItems * (sizeof(Value) + sizeof(Entry)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace bencoding
+} // namespace sbt
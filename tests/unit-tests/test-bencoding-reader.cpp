@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "util/bencoding-reader.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace bencoding {
+namespace test {
+
+static BufferView
+view(const std::string& input)
+{
+  return BufferView(input.data(), input.size());
+}
+
+static std::string
+str(const BufferView& view)
+{
+  return std::string(view.begin(), view.end());
+}
+
+BOOST_AUTO_TEST_SUITE(TestBencodingReader)
+
+BOOST_AUTO_TEST_CASE(Tokens)
+{
+  std::string input("d4:infod6:lengthi-42e4:name3:abce5:peersl0:i9223372036854775807eee");
+  Reader reader(view(input));
+  Reader::Token token;
+
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_DICTIONARY);
+  BOOST_CHECK(reader.isKeyNext());
+
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_STRING);
+  BOOST_CHECK_EQUAL(str(token.string), "info");
+  BOOST_CHECK(!reader.isKeyNext());
+
+  // the raw encoding of a value, e.g. for an info-hash
+  BufferView info = reader.skipValue();
+  BOOST_CHECK_EQUAL(str(info), "d6:lengthi-42e4:name3:abce");
+  BOOST_CHECK_EQUAL(reader.getDepth(), 1);
+
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(str(token.string), "peers");
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_LIST);
+  BOOST_CHECK_EQUAL(token.offset, 40);
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_STRING);
+  BOOST_CHECK_EQUAL(token.string.size(), 0);
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_INTEGER);
+  BOOST_CHECK_EQUAL(token.integer, std::numeric_limits<int64_t>::max());
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_END);
+  BOOST_REQUIRE(reader.next(token));
+  BOOST_CHECK_EQUAL(token.type, Reader::TOKEN_END);
+
+  BOOST_CHECK(reader.isDone());
+  BOOST_CHECK(!reader.next(token));
+  BOOST_CHECK_EQUAL(reader.getOffset(), input.size());
+}
+
+BOOST_AUTO_TEST_CASE(Malformed)
+{
+  std::vector<std::string> inputs = {
+    "", "i42", "ie", "i-e", "i-0e", "i042e", "i9223372036854775808e", "x", "3:ab", "03:abc",
+    "l", "li1e", "di1e1:ae", "d1:ae", "e", "18446744073709551616:a"
+  };
+
+  for (const auto& input : inputs) {
+    Reader reader(view(input));
+    Reader::Token token;
+    BOOST_CHECK_THROW(while (reader.next(token)) {}, Error);
+  }
+
+  std::string deep(Reader::MAX_DEPTH + 1, 'l');
+  Reader reader(view(deep));
+  BOOST_CHECK_THROW(reader.skipValue(), Error);
+
+  std::string smallest("i-9223372036854775808e");
+  Reader reader2(view(smallest));
+  Reader::Token token;
+  BOOST_REQUIRE(reader2.next(token));
+  BOOST_CHECK_EQUAL(token.integer, std::numeric_limits<int64_t>::min());
+}
+
+BOOST_AUTO_TEST_CASE(Large)
+{
+  // the shape of a large .torrent: a long pieces string and a long file list
+  const size_t nFiles = 100000;
+  std::string input("d4:infod5:filesl");
+  for (size_t i = 0; i < nFiles; ++i) {
+    std::string name = "file" + std::to_string(i);
+    input += "d6:lengthi" + std::to_string(i) + "e4:pathl" + std::to_string(name.size()) + ":" +
+             name + "ee";
+  }
+  input += "e6:pieces" + std::to_string(nFiles * 20) + ":" + std::string(nFiles * 20, 'x');
+  input += "ee";
+
+  Reader reader(view(input));
+  Reader::Token token;
+  size_t nIntegers = 0;
+  int64_t sum = 0;
+  size_t piecesLength = 0;
+  while (reader.next(token)) {
+    if (token.type == Reader::TOKEN_INTEGER) {
+      ++nIntegers;
+      sum += token.integer;
+    }
+    else if (token.type == Reader::TOKEN_STRING && token.string.size() > 1000)
+      piecesLength = token.string.size();
+  }
+
+  BOOST_CHECK_EQUAL(nIntegers, nFiles);
+  BOOST_CHECK_EQUAL(sum, static_cast<int64_t>(nFiles * (nFiles - 1) / 2));
+  BOOST_CHECK_EQUAL(piecesLength, nFiles * 20);
+  BOOST_CHECK_EQUAL(reader.getOffset(), input.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace bencoding
+} // namespace sbt
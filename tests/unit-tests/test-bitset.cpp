@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "util/bitset.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestBitset)
+
+BOOST_AUTO_TEST_CASE(Wire)
+{
+  // pieces 0, 7, 8 and 18 of 19, with a spare bit set by a sloppy peer
+  uint8_t wire[] = {0x81, 0x80, 0x30};
+  Bitset bitset(BufferView(wire, sizeof(wire)), 19);
+
+  BOOST_CHECK_EQUAL(bitset.size(), 19);
+  BOOST_CHECK_EQUAL(bitset.count(), 4);
+  BOOST_CHECK(bitset.test(0));
+  BOOST_CHECK(bitset.test(7));
+  BOOST_CHECK(bitset.test(8));
+  BOOST_CHECK(!bitset.test(9));
+  BOOST_CHECK(bitset.test(18));
+  BOOST_CHECK(!bitset.test(19));
+
+  uint8_t expected[] = {0x81, 0x80, 0x20};
+  BufferPtr encoded = bitset.encode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(encoded->begin(), encoded->end(),
+                                expected, expected + sizeof(expected));
+
+  // whole words go through the big-endian path
+  Buffer longWire(20);
+  longWire[0] = 0x40;
+  longWire[9] = 0x01;
+  longWire[19] = 0x80;
+  Bitset longBitset(longWire, 153);
+  BOOST_CHECK_EQUAL(longBitset.count(), 3);
+  BOOST_CHECK_EQUAL(longBitset.findFirst(), 1);
+  BOOST_CHECK_EQUAL(longBitset.findFirst(2), 79);
+  BOOST_CHECK_EQUAL(longBitset.findFirst(80), 152);
+  BOOST_CHECK(*longBitset.encode() == longWire);
+}
+
+BOOST_AUTO_TEST_CASE(SetOperations)
+{
+  Bitset have(200);
+  Bitset peer(200);
+  peer.setAll();
+  BOOST_CHECK(peer.all());
+  BOOST_CHECK_EQUAL(peer.count(), 200);
+
+  for (size_t i = 0; i < 150; ++i)
+    have.set(i);
+  have.reset(70);
+
+  BOOST_CHECK_EQUAL(peer.countAndNot(have), 51);
+  BOOST_CHECK_EQUAL(peer.findFirstAndNot(have), 70);
+  BOOST_CHECK_EQUAL(peer.findFirstAndNot(have, 71), 150);
+  BOOST_CHECK_EQUAL(peer.findFirstAndNot(peer), Bitset::npos);
+
+  Bitset needed = peer;
+  needed.andNot(have);
+  BOOST_CHECK_EQUAL(needed.count(), 51);
+  BOOST_CHECK_EQUAL(needed.findFirst(151), 151);
+
+  Bitset empty(200);
+  BOOST_CHECK(empty.none());
+  BOOST_CHECK_EQUAL(empty.findFirst(), Bitset::npos);
+
+  // growing keeps the bits, the new ones are clear
+  have.resize(300);
+  BOOST_CHECK_EQUAL(have.count(), 149);
+  BOOST_CHECK(!have.test(250));
+  have.resize(10);
+  BOOST_CHECK_EQUAL(have.count(), 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
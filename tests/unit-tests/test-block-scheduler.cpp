@@ -0,0 +1,108 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "download/block-scheduler.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestBlockScheduler)
+
+BOOST_AUTO_TEST_CASE(Geometry)
+{
+  BlockScheduler scheduler;
+  // two full pieces of 2.5 blocks, and a last piece of 100 bytes
+  uint32_t pieceLength = BlockScheduler::BLOCK_LENGTH * 5 / 2;
+  scheduler.init(2 * pieceLength + 100, pieceLength);
+
+  BOOST_CHECK_EQUAL(scheduler.getNumPieces(), 3);
+  BOOST_CHECK_EQUAL(scheduler.getPieceLength(1), pieceLength);
+  BOOST_CHECK_EQUAL(scheduler.getPieceLength(2), 100);
+  BOOST_CHECK_EQUAL(scheduler.getNumBlocks(0), 3);
+  BOOST_CHECK_EQUAL(scheduler.getNumBlocks(2), 1);
+}
+
+BOOST_AUTO_TEST_CASE(PickAndReassemble)
+{
+  BlockScheduler scheduler;
+  uint32_t pieceLength = BlockScheduler::BLOCK_LENGTH * 5 / 2;
+  scheduler.init(2 * pieceLength, pieceLength);
+
+  auto any = [] (uint32_t) { return true; };
+  Block block;
+  BOOST_CHECK(!scheduler.pickBlock(any, block));
+
+  scheduler.startPiece(1);
+  BOOST_CHECK(scheduler.isInProgress(1));
+
+  std::vector<Block> blocks;
+  while (scheduler.pickBlock(any, block))
+    blocks.push_back(block);
+  BOOST_REQUIRE_EQUAL(blocks.size(), 3);
+  BOOST_CHECK_EQUAL(blocks[1].begin, BlockScheduler::BLOCK_LENGTH);
+  BOOST_CHECK_EQUAL(blocks[2].length, BlockScheduler::BLOCK_LENGTH / 2);
+
+  // pieces the peer does not have are skipped
+  scheduler.startPiece(0);
+  BOOST_CHECK(!scheduler.pickBlock([] (uint32_t index) { return index == 1; }, block));
+
+  // a cancelled block is handed out again
+  scheduler.cancelBlock(blocks[1]);
+  BOOST_REQUIRE(scheduler.pickBlock([] (uint32_t index) { return index == 1; }, block));
+  BOOST_CHECK(block == blocks[1]);
+
+  // blocks arrive out of order
+  Buffer piece(pieceLength);
+  for (size_t i = 0; i < piece.size(); i++)
+    piece[i] = i % 241;
+
+  BOOST_CHECK(!scheduler.receiveBlock(blocks[2], BufferView(piece).slice(blocks[2].begin)));
+  BOOST_CHECK(!scheduler.receiveBlock(blocks[0],
+                                      BufferView(piece).slice(0, BlockScheduler::BLOCK_LENGTH)));
+  // duplicates and blocks of the wrong size are ignored
+  BOOST_CHECK(!scheduler.receiveBlock(blocks[0],
+                                      BufferView(piece).slice(0, BlockScheduler::BLOCK_LENGTH)));
+  Block odd = {1, 100, BlockScheduler::BLOCK_LENGTH};
+  BOOST_CHECK(!scheduler.markReceived(odd));
+
+  BOOST_CHECK(scheduler.receiveBlock(blocks[1], BufferView(piece).slice(blocks[1].begin,
+                                                                        blocks[1].length)));
+  BOOST_CHECK(*scheduler.getPieceData(1) == piece);
+
+  // hashed while the blocks came in, in order despite the early last block
+  uint8_t digest[util::Sha1::DIGEST_LENGTH];
+  BOOST_REQUIRE(scheduler.getPieceDigest(1, digest));
+  ConstBufferPtr expected = util::sha1(BufferView(piece));
+  BOOST_CHECK_EQUAL_COLLECTIONS(digest, digest + sizeof(digest),
+                                expected->begin(), expected->end());
+  BOOST_CHECK(!scheduler.getPieceDigest(0, digest));
+
+  scheduler.finishPiece(1);
+  BOOST_CHECK(!scheduler.isInProgress(1));
+  BOOST_CHECK_EQUAL(scheduler.getNumInProgress(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -41,6 +41,31 @@ BOOST_AUTO_TEST_CASE(Print)
   BOOST_CHECK_EQUAL("0123456789abcdef", ss.str());
 }
 
+BOOST_AUTO_TEST_CASE(View)
+{
+  uint8_t raw[] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef};
+  Buffer buffer(raw, sizeof(raw));
+
+  BufferView view(buffer);
+  BOOST_CHECK_EQUAL(view.size(), buffer.size());
+  BOOST_CHECK(view.buf() == buffer.buf());
+
+  BufferView middle = view.slice(2, 3);
+  BOOST_CHECK(middle.buf() == buffer.buf() + 2);
+  BOOST_CHECK_EQUAL_COLLECTIONS(middle.begin(), middle.end(), raw + 2, raw + 5);
+
+  BOOST_CHECK_EQUAL(view.slice(6).size(), 2);
+  BOOST_CHECK_EQUAL(view.slice(6, 100).size(), 2);
+  BOOST_CHECK_EQUAL(view.slice(100).size(), 0);
+
+  BufferPtr copied = middle.copy();
+  BOOST_CHECK(copied->buf() != middle.buf());
+  BOOST_CHECK_EQUAL_COLLECTIONS(copied->begin(), copied->end(), raw + 2, raw + 5);
+
+  BOOST_CHECK_EQUAL(BufferView().empty(), true);
+  BOOST_CHECK_EQUAL(BufferView(Buffer()).empty(), true);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace test
@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "download/hash-pool.hpp"
+#include "util/hash.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestHashPool)
+
+BOOST_AUTO_TEST_CASE(Verify)
+{
+  net::Reactor reactor;
+  HashPool pool(reactor, 4);
+  BOOST_CHECK_EQUAL(pool.getNumThreads(), 4);
+
+  // enough pieces for the workers to take batches, every odd one with a wrong digest
+  const uint32_t nPieces = 100;
+  std::vector<bool> results(nPieces);
+  size_t nResults = 0;
+  Buffer digests(nPieces * util::Sha1::DIGEST_LENGTH);
+  for (uint32_t i = 0; i < nPieces; ++i) {
+    auto piece = make_shared<Buffer>(64 * 1024);
+    std::fill(piece->begin(), piece->end(), i);
+
+    uint8_t* digest = &digests[i * util::Sha1::DIGEST_LENGTH];
+    util::Sha1().update(*piece).final(digest);
+    if (i % 2 == 1)
+      digest[0] ^= 1;
+
+    pool.submit(i, *piece, piece, digest, [&] (uint32_t index, bool isValid) {
+        results[index] = isValid;
+        if (++nResults == nPieces)
+          reactor.stop();
+      });
+  }
+
+  reactor.schedule(10000, [&] { reactor.stop(); }); // safety net
+  reactor.run();
+
+  BOOST_REQUIRE_EQUAL(nResults, nPieces);
+  for (uint32_t i = 0; i < nPieces; ++i)
+    BOOST_CHECK_EQUAL(results[i], i % 2 == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
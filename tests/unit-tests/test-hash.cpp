@@ -52,6 +52,97 @@ BOOST_AUTO_TEST_CASE(Basic)
                                   result3->begin(), result3->end());
 }
 
+BOOST_AUTO_TEST_CASE(Incremental)
+{
+  // FIPS 180 test vector
+  uint8_t abcHash[] = {
+    0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+    0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+
+  Buffer input(1000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = (i * 31) % 253;
+
+  Sha1::Backend original = Sha1::getBackend();
+  for (auto backend : {Sha1::BACKEND_PORTABLE, Sha1::BACKEND_SHA_NI}) {
+    if (!Sha1::setBackend(backend))
+      continue;
+
+    BOOST_CHECK(sha1(std::string("abc")) == std::string(abcHash, abcHash + sizeof(abcHash)));
+
+    // every split point, across and within the 64-byte blocks
+    ConstBufferPtr expected = sha1(BufferView(input));
+    for (size_t split = 0; split <= 200; ++split) {
+      Sha1 hasher;
+      hasher.update(input.buf(), split);
+      hasher.update(BufferView(input).slice(split));
+      BOOST_CHECK_EQUAL(hasher.getLength(), input.size());
+      ConstBufferPtr digest = hasher.final();
+      BOOST_REQUIRE(*digest == *expected);
+      BOOST_CHECK_EQUAL(hasher.getLength(), 0);
+    }
+
+    Sha1 hasher;
+    uint8_t digest[Sha1::DIGEST_LENGTH];
+    for (size_t i = 0; i < input.size(); ++i)
+      hasher.update(&input[i], 1);
+    hasher.final(digest);
+    BOOST_CHECK_EQUAL_COLLECTIONS(digest, digest + sizeof(digest),
+                                  expected->begin(), expected->end());
+  }
+
+  // both backends agree
+  if (Sha1::setBackend(Sha1::BACKEND_SHA_NI)) {
+    ConstBufferPtr accelerated = sha1(BufferView(input));
+    Sha1::setBackend(Sha1::BACKEND_PORTABLE);
+    BOOST_CHECK(*accelerated == *sha1(BufferView(input)));
+  }
+  BOOST_CHECK(Sha1::setBackend(original));
+}
+
+BOOST_AUTO_TEST_CASE(Batch)
+{
+  Buffer input(40 * 1000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = (i * 13) % 251;
+
+  Sha1Batch::Backend original = Sha1Batch::getBackend();
+  for (auto backend : {Sha1Batch::BACKEND_SEQUENTIAL, Sha1Batch::BACKEND_AVX2,
+                       Sha1Batch::BACKEND_AVX512}) {
+    if (!Sha1Batch::setBackend(backend))
+      continue;
+
+    // lengths around the padding boundaries, and counts that leave some lanes unused
+    for (size_t length : {0, 1, 55, 56, 63, 64, 119, 120, 1000}) {
+      for (size_t count : {1, 3, 8, 9, 16, 21, 40}) {
+        std::vector<BufferView> inputs;
+        for (size_t i = 0; i < count; ++i)
+          inputs.push_back(BufferView(input).slice(i * 1000, length));
+
+        std::vector<uint8_t> digests(count * Sha1::DIGEST_LENGTH);
+        Sha1Batch::hash(inputs.data(), count, digests.data());
+        for (size_t i = 0; i < count; ++i) {
+          ConstBufferPtr expected = sha1(inputs[i]);
+          BOOST_REQUIRE_EQUAL_COLLECTIONS(digests.begin() + i * Sha1::DIGEST_LENGTH,
+                                          digests.begin() + (i + 1) * Sha1::DIGEST_LENGTH,
+                                          expected->begin(), expected->end());
+        }
+      }
+    }
+
+    // different lengths are hashed one by one
+    std::vector<BufferView> inputs;
+    for (size_t i = 0; i < 16; ++i)
+      inputs.push_back(BufferView(input).slice(i * 1000, 100 + i));
+    std::vector<uint8_t> digests(inputs.size() * Sha1::DIGEST_LENGTH);
+    Sha1Batch::hash(inputs.data(), inputs.size(), digests.data());
+    ConstBufferPtr expected = sha1(inputs[15]);
+    BOOST_CHECK_EQUAL_COLLECTIONS(digests.end() - Sha1::DIGEST_LENGTH, digests.end(),
+                                  expected->begin(), expected->end());
+  }
+  BOOST_CHECK(Sha1Batch::setBackend(original));
+}
+
 BOOST_AUTO_TEST_CASE(Tmp)
 {
   // {
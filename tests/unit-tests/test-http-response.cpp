@@ -0,0 +1,100 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "http/http-response.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestHttpResponse)
+
+BOOST_AUTO_TEST_CASE(KeepAlive)
+{
+  HttpResponse response;
+  std::string header = "HTTP/1.1 200 OK\r\nTransfer-Encoding: Chunked\r\n\r\n";
+  response.parseResponse(header.data(), header.size());
+  BOOST_CHECK_EQUAL(response.isKeepAlive(), true);
+  BOOST_CHECK_EQUAL(response.isChunked(), true);
+
+  HttpResponse response2;
+  header = "HTTP/1.1 200 OK\r\nconnection: Close\r\nContent-Length: 3\r\n\r\n";
+  response2.parseResponse(header.data(), header.size());
+  BOOST_CHECK_EQUAL(response2.isKeepAlive(), false);
+  BOOST_CHECK_EQUAL(response2.isChunked(), false);
+  BOOST_CHECK_EQUAL(response2.findHeader("content-length"), "3");
+
+  HttpResponse response3;
+  header = "HTTP/1.0 200 OK\r\nContent-Length: 3\r\n\r\n";
+  response3.parseResponse(header.data(), header.size());
+  BOOST_CHECK_EQUAL(response3.isKeepAlive(), false);
+
+  HttpResponse response4;
+  header = "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\n\r\n";
+  response4.parseResponse(header.data(), header.size());
+  BOOST_CHECK_EQUAL(response4.isKeepAlive(), true);
+}
+
+BOOST_AUTO_TEST_CASE(Chunked)
+{
+  std::string input = "4\r\nWiki\r\n"
+                      "5;name=value\r\npedia\r\n"
+                      "E\r\n in\r\n\r\nchunks.\r\n"
+                      "0\r\n"
+                      "Expires: never\r\n"
+                      "\r\n"
+                      "HTTP/1.1";
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+
+  // at once
+  ChunkedDecoder decoder;
+  Buffer body;
+  size_t consumed = decoder.decode(data, input.size(), body);
+  BOOST_CHECK_EQUAL(decoder.isComplete(), true);
+  BOOST_CHECK_EQUAL(consumed, input.size() - 8);
+  BOOST_CHECK_EQUAL(std::string(body.begin(), body.end()), "Wikipedia in\r\n\r\nchunks.");
+
+  // byte by byte, a cut off line is left for the next call
+  decoder.reset();
+  body.clear();
+  size_t pos = 0;
+  for (size_t end = 1; end <= input.size() && !decoder.isComplete(); ++end)
+    pos += decoder.decode(data + pos, end - pos, body);
+  BOOST_CHECK_EQUAL(decoder.isComplete(), true);
+  BOOST_CHECK_EQUAL(pos, input.size() - 8);
+  BOOST_CHECK_EQUAL(std::string(body.begin(), body.end()), "Wikipedia in\r\n\r\nchunks.");
+
+  std::string bad = "4\r\nWikiXX";
+  decoder.reset();
+  BOOST_CHECK_THROW(decoder.decode(reinterpret_cast<const uint8_t*>(bad.data()), bad.size(), body),
+                    ParseError);
+
+  bad = "zz\r\n";
+  decoder.reset();
+  BOOST_CHECK_THROW(decoder.decode(reinterpret_cast<const uint8_t*>(bad.data()), bad.size(), body),
+                    ParseError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
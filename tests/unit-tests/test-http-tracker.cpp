@@ -0,0 +1,412 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "tracker/http-tracker.hpp"
+#include "tracker/scraper.hpp"
+#include <chrono>
+#include <thread>
+
+#include "fake-tracker.hpp"
+
+namespace sbt {
+namespace test {
+
+static TrackerRequestParam
+makeParam()
+{
+  TrackerRequestParam param;
+  param.setInfoHash(make_shared<Buffer>(20, 0xe2));
+  param.setPeerId("SIMPLEBT.TEST.PEERID");
+  param.setPort(6881);
+  param.setLeft(100);
+  return param;
+}
+
+BOOST_AUTO_TEST_SUITE(TestHttpTracker)
+
+BOOST_AUTO_TEST_CASE(Announce)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker server;
+
+  HttpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort(), "/announce");
+
+  int nResponses = 0;
+  std::vector<PeerEndpoint> endpoints;
+  uint64_t interval = 0;
+  tracker.announce(makeParam(),
+                   [&] (const TrackerResponse& response) {
+                     ++nResponses;
+                     endpoints = response.getEndpoints();
+                     interval = response.getInterval();
+                   },
+                   [&] (const std::string& reason) { BOOST_ERROR(reason); });
+  BOOST_CHECK(tracker.isBusy());
+
+  std::string request = server.receiveRequest(reactor);
+  BOOST_CHECK_EQUAL(request.compare(0, 27, "GET /announce?info_hash=%E2"), 0);
+  BOOST_CHECK(request.find("&compact=1 HTTP/1.1\r\n") != std::string::npos);
+  BOOST_CHECK(request.find("Host: 127.0.0.1:" + server.getPort()) != std::string::npos);
+
+  std::string body("d8:intervali900e5:peers12:\x7f\x00\x00\x01\x1a\xe1\x0a\x00\x00\x02\x1a\xe2" "e",
+                   39);
+  std::string header = "HTTP/1.0 200 OK\r\ncontent-length: 39\r\n\r\n";
+
+  // the response trickles in, nothing is parsed before it is complete
+  server.send(header.substr(0, 20));
+  reactor.runOnce(10);
+  server.send(header.substr(20) + body.substr(0, 10));
+  reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nResponses, 0);
+
+  server.send(body.substr(10));
+  for (int i = 0; i < 100 && nResponses == 0; ++i)
+    reactor.runOnce(10);
+
+  BOOST_CHECK_EQUAL(nResponses, 1);
+  BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  BOOST_CHECK_EQUAL(interval, 900);
+  BOOST_REQUIRE_EQUAL(endpoints.size(), 2);
+  BOOST_CHECK_EQUAL(endpoints[0].getIp(), "127.0.0.1");
+  BOOST_CHECK_EQUAL(endpoints[0].port, 6881);
+  BOOST_CHECK_EQUAL(endpoints[1].getIp(), "10.0.0.2");
+  BOOST_CHECK_EQUAL(endpoints[1].port, 6882);
+
+  // the resolved address is reused, a body without length ends with the connection
+  server.disconnect();
+  tracker.setTimeout(2000);
+  tracker.announce(makeParam(),
+                   [&] (const TrackerResponse& response) { ++nResponses; },
+                   [&] (const std::string& reason) { BOOST_ERROR(reason); });
+  BOOST_CHECK(server.receiveRequest(reactor).find("GET /announce?") == 0);
+  server.send("HTTP/1.0 200 OK\r\n\r\nd8:intervali900e5:peers0:e");
+  reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nResponses, 1);
+  server.disconnect();
+  for (int i = 0; i < 100 && nResponses == 1; ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nResponses, 2);
+}
+
+BOOST_AUTO_TEST_CASE(KeepAlive)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker server;
+
+  HttpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort(), "/announce");
+
+  std::vector<uint64_t> intervals;
+  auto onResponse = [&] (const TrackerResponse& response) {
+    intervals.push_back(response.getInterval());
+  };
+  auto onError = [&] (const std::string& reason) { BOOST_ERROR(reason); };
+
+  tracker.announce(makeParam(), onResponse, onError);
+  server.receiveRequest(reactor);
+  server.send("HTTP/1.1 200 OK\r\nContent-Length: 26\r\n\r\nd8:intervali100e5:peers0:e");
+  for (int i = 0; i < 100 && intervals.size() < 1; ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(tracker.isConnected(), true);
+
+  // two announces pipelined on the same connection, the second answer is chunked
+  tracker.announce(makeParam(), onResponse, onError);
+  tracker.announce(makeParam(), onResponse, onError);
+  std::string requests = server.receiveRequest(reactor, 2);
+  BOOST_CHECK_EQUAL(FakeTracker::countRequests(requests), 2);
+
+  server.send("HTTP/1.1 200 OK\r\nContent-Length: 26\r\n\r\nd8:intervali200e5:peers0:e"
+              "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+              "a\r\nd8:interva\r\n");
+  reactor.runOnce(10);
+  server.send("10;ext=1\r\nli300e5:peers0:e\r\n0\r\n\r\n");
+  for (int i = 0; i < 100 && intervals.size() < 3; ++i)
+    reactor.runOnce(10);
+
+  BOOST_REQUIRE_EQUAL(intervals.size(), 3);
+  BOOST_CHECK_EQUAL(intervals[1], 200);
+  BOOST_CHECK_EQUAL(intervals[2], 300);
+  BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  BOOST_CHECK_EQUAL(tracker.isConnected(), true);
+
+  // a request the tracker dropped the connection on is sent again on a new one
+  tracker.announce(makeParam(), onResponse, onError);
+  server.receiveRequest(reactor);
+  server.disconnect();
+  server.receiveRequest(reactor);
+  server.send("HTTP/1.1 200 OK\r\nContent-Length: 26\r\nConnection: close\r\n\r\n"
+              "d8:intervali400e5:peers0:e");
+  for (int i = 0; i < 100 && intervals.size() < 4; ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(intervals.size(), 4);
+  BOOST_CHECK_EQUAL(intervals[3], 400);
+  BOOST_CHECK_EQUAL(tracker.isConnected(), false);
+}
+
+BOOST_AUTO_TEST_CASE(PathWithQuery)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker server;
+
+  HttpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort(), "/announce.php?passkey=abc");
+  tracker.announce(makeParam(), [] (const TrackerResponse&) {}, [] (const std::string&) {});
+
+  std::string request = server.receiveRequest(reactor);
+  BOOST_CHECK_EQUAL(request.compare(0, 49, "GET /announce.php?passkey=abc&info_hash=%E2%E2%E2"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Errors)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+
+  std::string error;
+  bool hasResponse = false;
+  auto onResponse = [&] (const TrackerResponse&) { hasResponse = true; };
+  auto onError = [&] (const std::string& reason) { error = reason; };
+
+  // a tracker that never answers does not hold up the event loop
+  {
+    FakeTracker server;
+    HttpTracker tracker(reactor, resolver);
+    tracker.setTarget("127.0.0.1", server.getPort(), "/announce");
+    tracker.setTimeout(50);
+
+    int nTicks = 0;
+    reactor.schedule(10, [&] { ++nTicks; });
+    tracker.announce(makeParam(), onResponse, onError);
+    server.receiveRequest(reactor);
+    for (int i = 0; i < 100 && error.empty(); ++i)
+      reactor.runOnce(10);
+
+    BOOST_CHECK_EQUAL(nTicks, 1);
+    BOOST_CHECK_EQUAL(error, "Tracker 127.0.0.1 timed out");
+    BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  }
+
+  // error status
+  {
+    FakeTracker server;
+    HttpTracker tracker(reactor, resolver);
+    tracker.setTarget("127.0.0.1", server.getPort(), "/announce");
+
+    error.clear();
+    tracker.announce(makeParam(), onResponse, onError);
+    server.receiveRequest(reactor);
+    server.send("HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    for (int i = 0; i < 100 && error.empty(); ++i)
+      reactor.runOnce(10);
+    BOOST_CHECK_EQUAL(error, "Tracker 127.0.0.1 replied 404 Not Found");
+  }
+
+  // nobody listening
+  std::string port;
+  {
+    FakeTracker server;
+    port = server.getPort();
+  }
+  {
+    HttpTracker tracker(reactor, resolver);
+    tracker.setTarget("127.0.0.1", port, "/announce");
+
+    error.clear();
+    tracker.announce(makeParam(), onResponse, onError);
+    for (int i = 0; i < 100 && error.empty(); ++i)
+      reactor.runOnce(10);
+    BOOST_CHECK_EQUAL(error, "Cannot connect to tracker 127.0.0.1");
+  }
+
+  // cancelled announces stay silent
+  {
+    FakeTracker server;
+    HttpTracker tracker(reactor, resolver);
+    tracker.setTarget("127.0.0.1", server.getPort(), "/announce");
+
+    error.clear();
+    tracker.announce(makeParam(), onResponse, onError);
+    tracker.cancel();
+    for (int i = 0; i < 10; ++i)
+      reactor.runOnce(5);
+    BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  }
+
+  BOOST_CHECK_EQUAL(error, "");
+  BOOST_CHECK_EQUAL(hasResponse, false);
+}
+
+BOOST_AUTO_TEST_CASE(Resolve)
+{
+  std::vector<net::Address> addresses;
+  BOOST_CHECK_EQUAL(net::Resolver::lookup("127.0.0.1", "6969", addresses), "");
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1);
+  BOOST_CHECK_EQUAL(addresses[0].getFamily(), AF_INET);
+  const sockaddr_in* addr = reinterpret_cast<const sockaddr_in*>(addresses[0].get());
+  BOOST_CHECK_EQUAL(ntohs(addr->sin_port), 6969);
+
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  bool isDone = false;
+  resolver.resolve("127.0.0.1", "80", [&] (const std::vector<net::Address>& result,
+                                           const std::string& error) {
+      BOOST_CHECK_EQUAL(result.size(), 1);
+      BOOST_CHECK_EQUAL(error, "");
+      isDone = true;
+    });
+  for (int i = 0; i < 100 && !isDone; ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK(isDone);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelResolve)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  resolver.setLookup([] (const std::string& host, const std::string& port,
+                         std::vector<net::Address>& addresses) {
+      // a name server that does not answer for a while
+      if (host == "slow.example.com")
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      return net::Resolver::lookup("127.0.0.1", port, addresses);
+    });
+
+  std::vector<std::string> answers;
+  auto record = [&answers] (const std::string& host) {
+    return [&answers, host] (const std::vector<net::Address>&, const std::string&) {
+      answers.push_back(host);
+    };
+  };
+  resolver.resolve("slow.example.com", "80", record("slow"));
+  resolver.resolve("fast.example.com", "80", record("fast"));
+
+  uint64_t start = net::Reactor::now();
+  for (int i = 0; i < 100 && answers.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(answers.size(), 1);
+  BOOST_CHECK_EQUAL(answers[0], "fast");
+  BOOST_CHECK_LT(net::Reactor::now() - start, 400);
+
+  for (int i = 0; i < 200 && answers.size() < 2; ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(answers.size(), 2);
+  BOOST_CHECK_EQUAL(answers[1], "slow");
+}
+
+BOOST_AUTO_TEST_CASE(Scrape)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker server;
+
+  HttpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort(), "/announce.php?passkey=1");
+
+  ScrapeRequestParam param;
+  param.addInfoHash(make_shared<Buffer>(20, 0xaa));
+  param.addInfoHash(make_shared<Buffer>(20, 0xbb));
+
+  std::vector<ScrapeResponse> responses;
+  tracker.scrape(param,
+                 [&] (const ScrapeResponse& response) { responses.push_back(response); },
+                 [&] (const std::string& reason) { BOOST_ERROR(reason); });
+
+  std::string request = server.receiveRequest(reactor);
+  BOOST_CHECK_EQUAL(request.compare(0, 48, "GET /scrape.php?passkey=1&info_hash=%AA%AA%AA%AA"), 0);
+  BOOST_CHECK(request.find("&info_hash=%BB%BB") != std::string::npos);
+
+  server.send("HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\nd5:filesdee");
+  for (int i = 0; i < 100 && responses.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(responses.size(), 1);
+  BOOST_CHECK_EQUAL(responses[0].isFailure(), false);
+  BOOST_CHECK(responses[0].getFiles().empty());
+
+  tracker.setTarget("127.0.0.1", server.getPort(), "/tracker");
+  BOOST_CHECK_THROW(tracker.scrape(param, nullptr, nullptr), HttpTracker::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(TestScraper)
+
+BOOST_AUTO_TEST_CASE(Batch)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker server;
+  Scraper scraper(reactor, resolver);
+
+  std::string url = "http://127.0.0.1:" + server.getPort() + "/announce";
+  auto first = make_shared<Buffer>(20, 0x61);
+  auto second = make_shared<Buffer>(20, 0x62);
+
+  std::vector<ScrapeStats> results;
+  std::vector<std::string> errors;
+  auto onStats = [&] (const ScrapeStats& stats) { results.push_back(stats); };
+  auto onError = [&] (const std::string& reason) { errors.push_back(reason); };
+
+  // asked for in the same turn, the same torrent twice: one request for both torrents
+  scraper.scrape(url, first, onStats, onError);
+  scraper.scrape(url, second, onStats, onError);
+  scraper.scrape(url, first, onStats, onError);
+
+  std::string request = server.receiveRequest(reactor);
+  BOOST_CHECK_EQUAL(FakeTracker::countRequests(request), 1);
+  BOOST_CHECK_EQUAL(request.compare(0, 26, "GET /scrape?info_hash=aaaa"), 0);
+  BOOST_CHECK(request.find("&info_hash=bbbb") != std::string::npos);
+
+  std::string body = "d5:filesd20:" + std::string(20, 'a') +
+    "d8:completei5e10:downloadedi50e10:incompletei3eeee";
+  server.sendBody(body);
+  for (int i = 0; i < 100 && results.size() + errors.size() < 3; ++i)
+    reactor.runOnce(10);
+
+  BOOST_REQUIRE_EQUAL(results.size(), 2);
+  BOOST_CHECK_EQUAL(results[0].complete, 5);
+  BOOST_CHECK_EQUAL(results[1].incomplete, 3);
+  BOOST_REQUIRE_EQUAL(errors.size(), 1);
+  BOOST_CHECK_EQUAL(errors[0], "Tracker 127.0.0.1 does not know the torrent");
+
+  // answered from the cache without asking the tracker
+  ScrapeStats stats;
+  BOOST_CHECK(scraper.getStats(url, *first, stats));
+  BOOST_CHECK_EQUAL(stats.downloaded, 50);
+  BOOST_CHECK(!scraper.getStats(url, *second, stats));
+
+  scraper.scrape(url, first, onStats, onError);
+  BOOST_CHECK_EQUAL(results.size(), 2);
+  BOOST_CHECK_EQUAL(server.receiveRequest(reactor), "");
+  BOOST_CHECK_EQUAL(results.size(), 3);
+
+  BOOST_CHECK_THROW(scraper.scrape("udp://127.0.0.1:6969", first, onStats, onError),
+                    Tracker::Error);
+  BOOST_CHECK_THROW(scraper.scrape("http://127.0.0.1/tracker", first, onStats, onError),
+                    Tracker::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -20,6 +20,7 @@
  */
 
 #include "meta-info.hpp"
+#include "util/hash.hpp"
 #include <sstream>
 #include <fstream>
 #include <boost/filesystem.hpp>
@@ -134,6 +135,44 @@ BOOST_AUTO_TEST_CASE(Basic)
   BOOST_CHECK_EQUAL(ss.str(), result);
 }
 
+BOOST_AUTO_TEST_CASE(AnnounceList)
+{
+  MetaInfo info;
+  BOOST_CHECK(info.getAnnounceList().empty());
+
+  info.setAnnounce("http://a.com/announce");
+  info.setAnnounceList({{"http://a.com/announce", "udp://b.com:80"}, {"http://c.com/announce"}});
+
+  auto tiers = info.getAnnounceList();
+  BOOST_REQUIRE_EQUAL(tiers.size(), 2);
+  BOOST_REQUIRE_EQUAL(tiers[0].size(), 2);
+  BOOST_CHECK_EQUAL(tiers[0][1], "udp://b.com:80");
+  BOOST_REQUIRE_EQUAL(tiers[1].size(), 1);
+  BOOST_CHECK_EQUAL(tiers[1][0], "http://c.com/announce");
+
+  // entries of the wrong type and empty tiers are skipped
+  std::string wire =
+    "d"
+      "8:announce3:a/b"
+      "13:announce-list"
+        "l"
+          "l" "i1e" "3:x/y" "e"
+          "le"
+          "3:z/z"
+          "l" "3:u/v" "e"
+        "e"
+      "4:info" "d" "4:name1:n" "e"
+    "e";
+  std::istringstream is(wire);
+  MetaInfo info2;
+  info2.wireDecode(is);
+  tiers = info2.getAnnounceList();
+  BOOST_REQUIRE_EQUAL(tiers.size(), 2);
+  BOOST_CHECK_EQUAL(tiers[0].size(), 1);
+  BOOST_CHECK_EQUAL(tiers[0][0], "x/y");
+  BOOST_CHECK_EQUAL(tiers[1][0], "u/v");
+}
+
 BOOST_AUTO_TEST_CASE(EncodeDecode)
 {
   MetaInfo info;
@@ -191,11 +230,49 @@ BOOST_AUTO_TEST_CASE(EncodeDecode)
 
   BOOST_CHECK_EQUAL(ss.str(), result);
 
+  // the piece hashes point into the decoded file
+  util::DigestTable hashes = info2.getPieceHashes();
+  BOOST_REQUIRE_EQUAL(hashes.size(), 2);
+  BOOST_CHECK(hashes[1] == info2.getDocumentRoot().getWire().buf() + result.find("abcdefghij"));
+  BOOST_CHECK(hashes.matches(0, &pieces[0]));
+  BOOST_CHECK(!hashes.matches(1, &pieces[0]));
+
   boost::filesystem::path torrentPath(boost::filesystem::absolute("tmp.torrent"));
   boost::filesystem::remove(torrentPath);
 
 }
 
+BOOST_AUTO_TEST_CASE(DecodeEdit)
+{
+  // not canonical: keys out of order; decoding must keep the bytes as they are
+  std::string wire("d4:infod4:name1:a6:lengthi5ee8:announce3:urle");
+  std::istringstream is(wire);
+  MetaInfo info;
+  info.wireDecode(is);
+
+  BOOST_CHECK_EQUAL(info.getName(), "a");
+  BOOST_CHECK_EQUAL(info.getLength(), 5);
+  BOOST_CHECK_EQUAL(info.getAnnounce(), "url");
+  BufferView root = info.getDocumentRoot().getWire();
+  BOOST_CHECK_EQUAL(std::string(root.begin(), root.end()), wire);
+
+  // the hash covers the info dictionary as it is in the file, and is computed once
+  std::string infoWire("d4:name1:a6:lengthi5ee");
+  ConstBufferPtr hash = info.getHash();
+  BOOST_CHECK(*hash == *util::sha1(BufferView(infoWire.data(), infoWire.size())));
+  BOOST_CHECK_EQUAL(info.getHash(), hash);
+  BOOST_CHECK(info.getInfoWire().buf() == root.buf() + 7);
+
+  info.setName("b");
+  BOOST_CHECK(*info.getHash() != *hash);
+  BOOST_CHECK_EQUAL(info.getName(), "b");
+  BOOST_CHECK_EQUAL(info.getLength(), 5);
+  BOOST_CHECK_EQUAL(info.getAnnounce(), "url");
+
+  std::istringstream bad("d8:announce3:urle");
+  BOOST_CHECK_THROW(info.wireDecode(bad), bencoding::Error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace test
@@ -344,6 +344,64 @@ BOOST_AUTO_TEST_CASE(TestPiece)
                                   block_raw + sizeof(block_raw));
 }
 
+BOOST_AUTO_TEST_CASE(TestPieceView)
+{
+  uint8_t encoded_piece[] = {
+    0x00, 0x00, 0x00, 0x0d,
+    0x07,
+    0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x01, 0x01,
+    0x00, 0x00, 0x01, 0x02
+  };
+
+  Piece piece;
+  BOOST_REQUIRE_NO_THROW(piece.decode(BufferView(encoded_piece, sizeof(encoded_piece))));
+
+  BOOST_CHECK_EQUAL(piece.getIndex(), 256);
+  BOOST_CHECK_EQUAL(piece.getBegin(), 257);
+  // the block refers to the decoded bytes, nothing was copied
+  BOOST_CHECK(piece.getBlockView().buf() == encoded_piece + 13);
+  BOOST_CHECK_EQUAL(piece.getBlockView().size(), 4);
+
+  Bitfield bitfield;
+  BOOST_REQUIRE_NO_THROW(bitfield.decode(BufferView(encoded_piece, sizeof(encoded_piece))));
+  BOOST_CHECK(bitfield.getBitfieldView().buf() == encoded_piece + 5);
+
+  BOOST_CHECK_THROW(piece.decode(BufferView(encoded_piece, sizeof(encoded_piece) - 1)), Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestPieceIovec)
+{
+  auto block = make_shared<Buffer>(16384, 0x5a);
+  Piece piece(3, 16384, block);
+
+  std::vector<struct iovec> iov;
+  piece.encode(iov);
+
+  BOOST_REQUIRE_EQUAL(iov.size(), 2);
+  BOOST_CHECK_EQUAL(iov[0].iov_len, Piece::HEADER_LENGTH);
+  // the block is referenced, not copied
+  BOOST_CHECK(iov[1].iov_base == block->buf());
+  BOOST_CHECK_EQUAL(iov[1].iov_len, block->size());
+
+  Buffer gathered;
+  for (const auto& vec : iov) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(vec.iov_base);
+    gathered.insert(gathered.end(), data, data + vec.iov_len);
+  }
+
+  ConstBufferPtr encoded = Piece(3, 16384, block).encode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(gathered.begin(), gathered.end(),
+                                encoded->begin(), encoded->end());
+
+  // messages without bulk data fall back to a single encoded buffer
+  Have have(256);
+  std::vector<struct iovec> iov2;
+  have.encode(iov2);
+  BOOST_REQUIRE_EQUAL(iov2.size(), 1);
+  BOOST_CHECK_EQUAL(iov2[0].iov_len, 9);
+}
+
 BOOST_AUTO_TEST_CASE(TestCancel)
 {
   uint8_t encoded_cancel[] = {
@@ -0,0 +1,416 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "peerConnection.hpp"
+#include "msg/msg-base.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestPeerConnection)
+
+BOOST_AUTO_TEST_CASE(Framing)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  net::Reactor::setNonBlocking(fds[0]);
+
+  auto conn = make_shared<PeerConnection>(fds[0], true, true);
+
+  size_t nHandshakes = 0;
+  std::vector<std::vector<uint8_t>> messages;
+  bool isClosed = false;
+  conn->setOnHandshake([&] (PeerConnection&, const uint8_t* frame, size_t length) {
+      BOOST_CHECK_EQUAL(length, PeerConnection::HANDSHAKE_LENGTH);
+      ++nHandshakes;
+    });
+  conn->setOnMessage([&] (PeerConnection&, const uint8_t* frame, size_t length) {
+      messages.push_back(std::vector<uint8_t>(frame, frame + length));
+    });
+  conn->setOnClose([&] (PeerConnection&) { isClosed = true; });
+
+  Buffer handshake(68);
+  ConstBufferPtr have = msg::Have(7).encode();
+  ConstBufferPtr piece = msg::Piece(1, 0, make_shared<Buffer>(100000, 0xab)).encode();
+
+  Buffer stream(handshake);
+  stream.insert(stream.end(), have->begin(), have->end());
+  stream.insert(stream.end(), 4, 0); // keep-alive
+  stream.insert(stream.end(), piece->begin(), piece->end());
+
+  // deliver the stream in awkward fragments: every frame boundary is split
+  size_t cuts[] = {30, 70, 75, 80, 1000, 50000, stream.size()};
+  size_t written = 0;
+  for (size_t cut : cuts) {
+    while (written < cut) {
+      ssize_t res = write(fds[1], stream.buf() + written, cut - written);
+      BOOST_REQUIRE(res > 0);
+      written += res;
+      conn->handleEvent(net::Reactor::EVENT_READ);
+    }
+  }
+
+  BOOST_CHECK_EQUAL(nHandshakes, 1);
+  BOOST_REQUIRE_EQUAL(messages.size(), 3);
+  BOOST_CHECK_EQUAL_COLLECTIONS(messages[0].begin(), messages[0].end(),
+                                have->begin(), have->end());
+  BOOST_CHECK_EQUAL(messages[1].size(), 4);
+  BOOST_CHECK_EQUAL_COLLECTIONS(messages[2].begin(), messages[2].end(),
+                                piece->begin(), piece->end());
+  BOOST_CHECK_EQUAL(isClosed, false);
+
+  close(fds[1]);
+  conn->handleEvent(net::Reactor::EVENT_READ);
+  BOOST_CHECK_EQUAL(isClosed, true);
+
+  close(fds[0]);
+}
+
+BOOST_AUTO_TEST_CASE(OversizedMessage)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  net::Reactor::setNonBlocking(fds[0]);
+
+  auto conn = make_shared<PeerConnection>(fds[0], true, false);
+  bool isClosed = false;
+  conn->setOnClose([&] (PeerConnection&) { isClosed = true; });
+
+  uint8_t header[] = {0x7f, 0xff, 0xff, 0xff, 0x07};
+  BOOST_CHECK_EQUAL(write(fds[1], header, sizeof(header)), sizeof(header));
+  conn->handleEvent(net::Reactor::EVENT_READ);
+  BOOST_CHECK_EQUAL(isClosed, true);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(MalformedPayload)
+{
+  int bad[2];
+  int good[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, bad), 0);
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, good), 0);
+  net::Reactor::setNonBlocking(bad[0]);
+  net::Reactor::setNonBlocking(good[0]);
+
+  std::vector<uint32_t> haves;
+  std::vector<PeerConnection*> closed;
+  auto onMessage = [&] (PeerConnection&, const uint8_t* frame, size_t length) {
+    msg::Have have;
+    have.decode(BufferView(frame, length));
+    haves.push_back(have.getIndex());
+  };
+
+  auto badConn = make_shared<PeerConnection>(bad[0], true, false);
+  auto goodConn = make_shared<PeerConnection>(good[0], true, false);
+  for (auto conn : {badConn, goodConn}) {
+    conn->setOnMessage(onMessage);
+    conn->setOnClose([&] (PeerConnection& c) { closed.push_back(&c); c.setClosed(); });
+  }
+
+  // a have with a 2-byte index, followed by a valid one that must not be dispatched
+  uint8_t malformed[] = {0, 0, 0, 3, msg::MSG_ID_HAVE, 0, 1};
+  ConstBufferPtr have = msg::Have(7).encode();
+  BOOST_CHECK_EQUAL(write(bad[1], malformed, sizeof(malformed)), sizeof(malformed));
+  BOOST_CHECK_EQUAL(write(bad[1], have->buf(), have->size()), have->size());
+  BOOST_CHECK_EQUAL(write(good[1], have->buf(), have->size()), have->size());
+
+  badConn->handleEvent(net::Reactor::EVENT_READ);
+  goodConn->handleEvent(net::Reactor::EVENT_READ);
+
+  BOOST_REQUIRE_EQUAL(closed.size(), 1);
+  BOOST_CHECK_EQUAL(closed[0], badConn.get());
+  BOOST_REQUIRE_EQUAL(haves.size(), 1);
+  BOOST_CHECK_EQUAL(haves[0], 7);
+  BOOST_CHECK_EQUAL(goodConn->isClosed(), false);
+
+  for (int fd : {bad[0], bad[1], good[0], good[1]})
+    close(fd);
+}
+
+BOOST_AUTO_TEST_CASE(GatheredSend)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  net::Reactor::setNonBlocking(fds[0]);
+
+  auto conn = make_shared<PeerConnection>(fds[0], false, false);
+
+  // more than the socket buffer takes at once, so part of it has to be queued
+  auto block = make_shared<Buffer>(4 * 1024 * 1024);
+  for (size_t i = 0; i < block->size(); i++)
+    (*block)[i] = i % 251;
+
+  msg::Piece piece(9, 0, block);
+  std::vector<struct iovec> iov;
+  piece.encode(iov);
+  conn->send(iov, block);
+  conn->send(msg::Have(9).encode());
+
+  ConstBufferPtr expectedPiece = msg::Piece(9, 0, block).encode();
+  ConstBufferPtr expectedHave = msg::Have(9).encode();
+  Buffer expected(*expectedPiece);
+  expected.insert(expected.end(), expectedHave->begin(), expectedHave->end());
+
+  Buffer received;
+  uint8_t buf[65536];
+  while (received.size() < expected.size()) {
+    ssize_t res = read(fds[1], buf, sizeof(buf));
+    BOOST_REQUIRE(res > 0);
+    received.insert(received.end(), buf, buf + res);
+    conn->handleEvent(net::Reactor::EVENT_WRITE);
+  }
+
+  BOOST_CHECK(received == expected);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(SendFile)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  net::Reactor::setNonBlocking(fds[0]);
+
+  Buffer content(1024 * 1024);
+  for (size_t i = 0; i < content.size(); i++)
+    content[i] = i % 253;
+
+  char path[] = "/tmp/sbt-test-sendfile-XXXXXX";
+  int fileFd = mkstemp(path);
+  BOOST_REQUIRE(fileFd != -1);
+  unlink(path);
+  BOOST_REQUIRE_EQUAL(write(fileFd, content.buf(), content.size()), content.size());
+
+  auto conn = make_shared<PeerConnection>(fds[0], false, false);
+
+  size_t offset = 1000;
+  size_t length = 600 * 1000;
+  ConstBufferPtr header = msg::Piece::encodeHeader(0, offset, length);
+  conn->sendFile(header, fileFd, offset, length);
+
+  ConstBufferPtr expected =
+    msg::Piece(0, offset, make_shared<Buffer>(content.buf() + offset, length)).encode();
+
+  Buffer received;
+  uint8_t buf[65536];
+  while (received.size() < expected->size()) {
+    ssize_t res = read(fds[1], buf, sizeof(buf));
+    BOOST_REQUIRE(res > 0);
+    received.insert(received.end(), buf, buf + res);
+    conn->handleEvent(net::Reactor::EVENT_WRITE);
+  }
+
+  BOOST_CHECK(received == *expected);
+
+  close(fileFd);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(SendHeld)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  net::Reactor::setNonBlocking(fds[0]);
+
+  auto conn = make_shared<PeerConnection>(fds[0], false, false);
+
+  // the held memory must outlive our reference until it has been written
+  weak_ptr<Buffer> weakBlock;
+  ConstBufferPtr expected;
+  {
+    auto block = make_shared<Buffer>(512 * 1024);
+    for (size_t i = 0; i < block->size(); i++)
+      (*block)[i] = i % 251;
+    weakBlock = block;
+    expected = msg::Piece(1, 0, block).encode();
+    conn->send(msg::Piece::encodeHeader(1, 0, block->size()), block->buf(), block->size(), block);
+  }
+  BOOST_CHECK(!weakBlock.expired());
+
+  Buffer received;
+  uint8_t buf[65536];
+  while (received.size() < expected->size()) {
+    ssize_t res = read(fds[1], buf, sizeof(buf));
+    BOOST_REQUIRE(res > 0);
+    received.insert(received.end(), buf, buf + res);
+    conn->handleEvent(net::Reactor::EVENT_WRITE);
+  }
+
+  BOOST_CHECK(received == *expected);
+  BOOST_CHECK(weakBlock.expired());
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(Connect)
+{
+  net::Reactor reactor;
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  BOOST_REQUIRE_EQUAL(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  BOOST_REQUIRE_EQUAL(listen(listener, 4), 0);
+  socklen_t addrLength = sizeof(addr);
+  getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLength);
+
+  auto connectTo = [&] (const sockaddr_in& target) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int res = connect(sock, reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+    BOOST_REQUIRE(res == 0 || errno == EINPROGRESS);
+    auto conn = make_shared<PeerConnection>(sock, true, true);
+    conn->setConnecting();
+    return conn;
+  };
+
+  // data queued while connecting waits for the connection and keeps its order
+  auto conn = connectTo(addr);
+  std::vector<std::string> events;
+  conn->setOnConnect([&] (PeerConnection& c) {
+      events.push_back("connect");
+      c.send(make_shared<Buffer>(1, 0x01));
+    });
+  conn->setOnClose([&] (PeerConnection&) { events.push_back("close"); });
+  conn->send(make_shared<Buffer>(1, 0x02));
+  reactor.add(conn->getSocket(), net::Reactor::EVENT_READ | net::Reactor::EVENT_WRITE,
+              conn.get());
+  for (int i = 0; i < 100 && events.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(events.size(), 1);
+  BOOST_CHECK_EQUAL(events[0], "connect");
+  BOOST_CHECK_EQUAL(conn->isConnecting(), false);
+
+  int accepted = accept(listener, nullptr, nullptr);
+  uint8_t buf[2];
+  BOOST_REQUIRE_EQUAL(read(accepted, buf, sizeof(buf)), 2);
+  BOOST_CHECK_EQUAL(buf[0], 0x02);
+  BOOST_CHECK_EQUAL(buf[1], 0x01);
+  reactor.remove(conn->getSocket());
+  close(conn->getSocket());
+  close(accepted);
+
+  // nobody listens any more: the connection is closed instead of connected
+  close(listener);
+  auto refused = connectTo(addr);
+  events.clear();
+  refused->setOnConnect([&] (PeerConnection&) { events.push_back("connect"); });
+  refused->setOnClose([&] (PeerConnection&) { events.push_back("close"); });
+  reactor.add(refused->getSocket(), net::Reactor::EVENT_READ | net::Reactor::EVENT_WRITE,
+              refused.get());
+  for (int i = 0; i < 100 && events.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(events.size(), 1);
+  BOOST_CHECK_EQUAL(events[0], "close");
+  reactor.remove(refused->getSocket());
+  close(refused->getSocket());
+}
+
+BOOST_AUTO_TEST_CASE(HaveAfterBitfield)
+{
+  int ready[2];
+  int handshaking[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, ready), 0);
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, handshaking), 0);
+  net::Reactor::setNonBlocking(ready[0]);
+  net::Reactor::setNonBlocking(handshaking[0]);
+
+  Bitset have(16);
+  Buffer handshake(PeerConnection::HANDSHAKE_LENGTH);
+
+  // what the client does: its bitfield follows the exchange of handshakes, a verified
+  // piece is announced to the peers that have had the bitfield
+  auto sendBitfield = [&] (PeerConnection& conn, const uint8_t*, size_t) {
+    conn.send(msg::Bitfield(have.encode()).encode());
+    conn.setBitfieldSent();
+  };
+  auto finishPiece = [&] (uint32_t index, const std::vector<shared_ptr<PeerConnection>>& conns) {
+    have.set(index);
+    for (const auto& conn : conns) {
+      if (conn->hasSentBitfield())
+        conn->send(msg::Have(index).encode());
+    }
+  };
+
+  auto readyConn = make_shared<PeerConnection>(ready[0], true, true);
+  auto handshakingConn = make_shared<PeerConnection>(handshaking[0], true, true);
+  for (auto conn : {readyConn, handshakingConn}) {
+    conn->setOnHandshake(sendBitfield);
+    conn->send(make_shared<Buffer>(handshake));
+  }
+
+  // only the first peer has answered our handshake when piece 3 completes
+  BOOST_CHECK_EQUAL(write(ready[1], handshake.buf(), handshake.size()), handshake.size());
+  readyConn->handleEvent(net::Reactor::EVENT_READ);
+  BOOST_CHECK_EQUAL(readyConn->hasSentBitfield(), true);
+  BOOST_CHECK_EQUAL(handshakingConn->hasSentBitfield(), false);
+
+  finishPiece(3, {readyConn, handshakingConn});
+
+  BOOST_CHECK_EQUAL(write(handshaking[1], handshake.buf(), handshake.size()),
+                    handshake.size());
+  handshakingConn->handleEvent(net::Reactor::EVENT_READ);
+
+  auto readAll = [] (int fd) {
+    Buffer received(1024);
+    ssize_t res = read(fd, received.buf(), received.size());
+    received.resize(res > 0 ? res : 0);
+    return received;
+  };
+
+  // handshake, empty bitfield, then the have
+  Bitset none(16);
+  Buffer expected(handshake);
+  ConstBufferPtr bitfield = msg::Bitfield(none.encode()).encode();
+  ConstBufferPtr haveMsg = msg::Have(3).encode();
+  expected.insert(expected.end(), bitfield->begin(), bitfield->end());
+  expected.insert(expected.end(), haveMsg->begin(), haveMsg->end());
+  Buffer received = readAll(ready[1]);
+  BOOST_CHECK_EQUAL_COLLECTIONS(received.begin(), received.end(),
+                                expected.begin(), expected.end());
+
+  // handshake and a bitfield that already has the piece, no have in between
+  expected = handshake;
+  bitfield = msg::Bitfield(have.encode()).encode();
+  expected.insert(expected.end(), bitfield->begin(), bitfield->end());
+  received = readAll(handshaking[1]);
+  BOOST_CHECK_EQUAL_COLLECTIONS(received.begin(), received.end(),
+                                expected.begin(), expected.end());
+
+  for (int fd : {ready[0], ready[1], handshaking[0], handshaking[1]})
+    close(fd);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "download/piece-picker.hpp"
+
+#include <set>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestPiecePicker)
+
+static Bitset
+makeBitfield(uint32_t numPieces, std::initializer_list<uint32_t> pieces)
+{
+  Bitset bitfield(numPieces);
+  for (uint32_t i : pieces)
+    bitfield.set(i);
+  return bitfield;
+}
+
+BOOST_AUTO_TEST_CASE(RarestFirst)
+{
+  PiecePicker picker;
+  picker.init(8);
+
+  // complete enough pieces to leave the random first-piece phase
+  for (uint32_t i = 4; i < 4 + PiecePicker::RANDOM_FIRST_PIECES; ++i)
+    picker.setHave(i);
+
+  picker.addPeer(makeBitfield(8, {0, 1, 2, 3}));
+  picker.addPeer(makeBitfield(8, {0, 1, 2}));
+  picker.addPeer(makeBitfield(8, {0, 2}));
+  picker.incrementAvailability(1);
+  BOOST_CHECK_EQUAL(picker.getAvailability(0), 3);
+  BOOST_CHECK_EQUAL(picker.getAvailability(1), 3);
+  BOOST_CHECK_EQUAL(picker.getAvailability(3), 1);
+
+  auto all = [] (uint32_t) { return true; };
+
+  // 3 is the rarest, then 2 once the third peer is gone
+  BOOST_CHECK_EQUAL(picker.pick(all), 3);
+  picker.removePeer(makeBitfield(8, {0, 2}));
+  picker.decrementAvailability(1);
+  BOOST_CHECK_EQUAL(picker.getAvailability(2), 2);
+  BOOST_CHECK_EQUAL(picker.getAvailability(0), 2);
+  BOOST_CHECK_EQUAL(picker.getAvailability(1), 2);
+
+  std::set<int> picked;
+  picked.insert(picker.pick(all));
+  picked.insert(picker.pick(all));
+  picked.insert(picker.pick(all));
+  BOOST_CHECK(picked == std::set<int>({0, 1, 2}));
+
+  // every missing piece is being downloaded
+  BOOST_CHECK_EQUAL(picker.pick(all), -1);
+  BOOST_CHECK(picker.isEndgame());
+
+  // a failed piece can be picked again
+  picker.abortPiece(1);
+  BOOST_CHECK(!picker.isEndgame());
+  BOOST_CHECK_EQUAL(picker.pick([] (uint32_t index) { return index != 1; }), -1);
+  BOOST_CHECK_EQUAL(picker.pick(all), 1);
+}
+
+BOOST_AUTO_TEST_CASE(RandomFirst)
+{
+  PiecePicker picker;
+  picker.init(64);
+  // piece 0 is the rarest, but the first pieces are picked at random
+  Bitset seed(64);
+  seed.setAll();
+  picker.addPeer(seed);
+  for (uint32_t i = 1; i < 64; ++i)
+    picker.incrementAvailability(i);
+
+  std::set<int> picked;
+  for (int i = 0; i < 64; ++i) {
+    int index = picker.pick([] (uint32_t) { return true; });
+    BOOST_REQUIRE(index >= 0);
+    picked.insert(index);
+  }
+  BOOST_CHECK_EQUAL(picked.size(), 64);
+
+  // pieces nobody has are never picked
+  PiecePicker empty;
+  empty.init(4);
+  BOOST_CHECK_EQUAL(empty.pick([] (uint32_t) { return true; }), -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "net/reactor.hpp"
+#include <thread>
+#include <sys/socket.h>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace net {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestReactor)
+
+BOOST_AUTO_TEST_CASE(ReadReadiness)
+{
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  Reactor::setNonBlocking(fds[0]);
+
+  Reactor reactor;
+  int nCalls = 0;
+  size_t nRead = 0;
+  reactor.add(fds[0], Reactor::EVENT_READ, [&] (uint32_t events) {
+      ++nCalls;
+      char buf[4];
+      ssize_t res;
+      while ((res = read(fds[0], buf, sizeof(buf))) > 0)
+        nRead += res;
+    });
+
+  BOOST_CHECK_EQUAL(write(fds[1], "0123456789", 10), 10);
+  reactor.runOnce(100);
+  BOOST_CHECK_EQUAL(nCalls, 1);
+  BOOST_CHECK_EQUAL(nRead, 10);
+
+  // edge-triggered, nothing new arrived
+  reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nCalls, 1);
+
+  reactor.remove(fds[0]);
+  BOOST_CHECK_EQUAL(reactor.isRegistered(fds[0]), false);
+  BOOST_CHECK_EQUAL(write(fds[1], "x", 1), 1);
+  reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nCalls, 1);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(ReusedDescriptor)
+{
+  int a[2];
+  int b[2];
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, a), 0);
+  BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, b), 0);
+
+  Reactor reactor;
+  int ready[] = {a[0], b[0]};
+  int reused[2] = {-1, -1};
+  int nStaleCalls = 0;
+
+  // whichever handler runs first closes the other descriptor and opens a new one that
+  // gets its number; the other descriptor's event in the same batch must not reach it
+  auto replaceOther = [&] (int self) {
+    if (reused[0] != -1)
+      return;
+    int other = self == ready[0] ? ready[1] : ready[0];
+    reactor.remove(other);
+    close(other);
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, reused), 0);
+    BOOST_REQUIRE_EQUAL(reused[0], other);
+    reactor.add(reused[0], Reactor::EVENT_READ, [&] (uint32_t) { ++nStaleCalls; });
+  };
+  for (int fd : ready)
+    reactor.add(fd, Reactor::EVENT_READ, [&, fd] (uint32_t) { replaceOther(fd); });
+
+  BOOST_CHECK_EQUAL(write(a[1], "x", 1), 1);
+  BOOST_CHECK_EQUAL(write(b[1], "x", 1), 1);
+  reactor.runOnce(100);
+  BOOST_REQUIRE(reused[0] != -1);
+  BOOST_CHECK_EQUAL(nStaleCalls, 0);
+
+  // the new registration gets its own events
+  BOOST_CHECK_EQUAL(write(reused[1], "x", 1), 1);
+  reactor.runOnce(100);
+  BOOST_CHECK_EQUAL(nStaleCalls, 1);
+
+  int survivor = reused[0] == a[0] ? b[0] : a[0];
+  for (int fd : {survivor, a[1], b[1], reused[0], reused[1]})
+    close(fd);
+}
+
+BOOST_AUTO_TEST_CASE(Timers)
+{
+  Reactor reactor;
+  std::vector<int> order;
+
+  reactor.schedule(20, [&] { order.push_back(2); });
+  reactor.schedule(0, [&] { order.push_back(1); });
+  Reactor::TimerId id = reactor.schedule(10, [&] { order.push_back(3); });
+  reactor.cancel(id);
+  reactor.schedule(30, [&] { reactor.stop(); });
+
+  reactor.run();
+
+  BOOST_REQUIRE_EQUAL(order.size(), 2);
+  BOOST_CHECK_EQUAL(order[0], 1);
+  BOOST_CHECK_EQUAL(order[1], 2);
+}
+
+BOOST_AUTO_TEST_CASE(Post)
+{
+  Reactor reactor;
+  std::vector<int> order;
+  std::thread::id reactorThread = std::this_thread::get_id();
+  bool isOnReactorThread = true;
+
+  std::thread poster([&] {
+      for (int i = 0; i < 100; ++i)
+        reactor.post([&, i] {
+            order.push_back(i);
+            isOnReactorThread = isOnReactorThread &&
+                                std::this_thread::get_id() == reactorThread;
+            if (i == 99)
+              reactor.stop();
+          });
+    });
+
+  reactor.schedule(5000, [&] { reactor.stop(); }); // safety net
+  reactor.run();
+  poster.join();
+
+  BOOST_REQUIRE_EQUAL(order.size(), 100);
+  for (int i = 0; i < 100; ++i)
+    BOOST_CHECK_EQUAL(order[i], i);
+  BOOST_CHECK(isOnReactorThread);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace net
+} // namespace sbt
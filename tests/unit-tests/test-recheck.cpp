@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "download/recheck.hpp"
+#include "util/hash.hpp"
+#include <boost/filesystem.hpp>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestRecheck)
+
+BOOST_AUTO_TEST_CASE(PartialPayload)
+{
+  boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+                                 boost::filesystem::unique_path();
+
+  // 40 pieces of 1000 bytes and a last one of 500
+  const int64_t pieceLength = 1000;
+  const int64_t length = 40 * pieceLength + 500;
+  Buffer payload(length);
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = (i * 7) % 251;
+
+  auto hashes = make_shared<Buffer>();
+  for (int64_t offset = 0; offset < length; offset += pieceLength) {
+    ConstBufferPtr hash = util::sha1(BufferView(payload).slice(offset, pieceLength));
+    hashes->insert(hashes->end(), hash->begin(), hash->end());
+  }
+  util::DigestTable digests(*hashes, hashes);
+
+  for (auto mode : {Storage::MODE_PREAD, Storage::MODE_MMAP}) {
+    {
+      // only every third piece and the short last piece made it to disk
+      Storage storage;
+      storage.open(path.string(), length, pieceLength);
+      for (uint32_t i = 0; i < digests.size(); i += 3)
+        storage.writeBlock(i, 0, BufferView(payload).slice(i * pieceLength, pieceLength));
+      storage.writeBlock(40, 0, BufferView(payload).slice(40 * pieceLength));
+    }
+
+    Storage storage;
+    storage.open(path.string(), length, pieceLength, mode);
+
+    net::Reactor reactor;
+    HashPool pool(reactor, 3);
+    Recheck recheck(storage, pool, digests);
+
+    Bitset candidates(digests.size());
+    candidates.setAll();
+    candidates.reset(3); // not a candidate, not checked
+
+    Bitset result;
+    bool isDone = false;
+    recheck.start(candidates, [&] (const Bitset& valid) {
+        result = valid;
+        isDone = true;
+      });
+    while (!isDone)
+      reactor.runOnce(1000);
+
+    BOOST_CHECK_EQUAL(recheck.getNumChecked(), digests.size() - 1);
+    BOOST_REQUIRE_EQUAL(result.size(), digests.size());
+    for (uint32_t i = 0; i < digests.size(); ++i)
+      BOOST_CHECK_EQUAL(result.test(i), (i % 3 == 0 && i != 3) || i == 40);
+
+    boost::filesystem::remove(path);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
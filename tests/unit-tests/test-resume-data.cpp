@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "storage/resume-data.hpp"
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestResumeData)
+
+BOOST_AUTO_TEST_CASE(SaveLoad)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                                boost::filesystem::unique_path();
+  boost::filesystem::create_directories(dir);
+  std::string payload = (dir / "payload").string();
+  std::string resumePath = (dir / "payload.resume").string();
+
+  std::ofstream(payload) << "0123456789";
+  std::vector<std::string> paths = {payload, (dir / "missing").string()};
+  std::vector<ResumeData::FileState> files = ResumeData::statFiles(paths);
+  BOOST_CHECK_EQUAL(files[0].size, 10);
+  BOOST_CHECK_EQUAL(files[1].size, -1);
+
+  Bitset pieces(11);
+  pieces.set(0);
+  pieces.set(10);
+
+  ResumeData resume;
+  resume.setInfoHash(std::string(20, 'h'));
+  resume.setPieces(pieces);
+  resume.setFiles(files);
+  resume.save(resumePath);
+
+  ResumeData loaded;
+  BOOST_REQUIRE(loaded.load(resumePath, 11));
+  BOOST_CHECK(loaded.getPieces() == pieces);
+  BOOST_CHECK(loaded.matches(std::string(20, 'h'), ResumeData::statFiles(paths)));
+  BOOST_CHECK(!loaded.matches(std::string(20, 'x'), files));
+
+  // a different torrent geometry or a changed file invalidates the data
+  BOOST_CHECK(!loaded.load(resumePath, 17));
+  std::ofstream(payload, std::ios::app) << "x";
+  BOOST_REQUIRE(loaded.load(resumePath, 11));
+  BOOST_CHECK(!loaded.matches(std::string(20, 'h'), ResumeData::statFiles(paths)));
+
+  std::ofstream(resumePath) << "garbage";
+  BOOST_CHECK(!loaded.load(resumePath, 11));
+  BOOST_CHECK(!loaded.load((dir / "nothing").string(), 11));
+
+  boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
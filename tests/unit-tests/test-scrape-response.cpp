@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "scrape-request-param.hpp"
+#include "scrape-response.hpp"
+#include "tracker/http-tracker.hpp"
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestScrapeResponse)
+
+BOOST_AUTO_TEST_CASE(Param)
+{
+  ScrapeRequestParam param;
+  BOOST_CHECK_THROW(param.encode(), ScrapeRequestParam::Error);
+
+  param.addInfoHash(make_shared<Buffer>(2, 0xaa));
+  BOOST_CHECK_EQUAL(param.encode(), "?info_hash=%AA%AA");
+  param.addInfoHash(make_shared<Buffer>(2, 0xbb));
+  BOOST_CHECK_EQUAL(param.encode(), "?info_hash=%AA%AA&info_hash=%BB%BB");
+}
+
+BOOST_AUTO_TEST_CASE(ScrapePath)
+{
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/announce"), "/scrape");
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/x/announce.php"), "/x/scrape.php");
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/announce?passkey=a/b"), "/scrape?passkey=a/b");
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/a"), "");
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/announce/x"), "");
+  BOOST_CHECK_EQUAL(HttpTracker::getScrapePath("/x?announce"), "");
+}
+
+BOOST_AUTO_TEST_CASE(Decode)
+{
+  std::string first(20, 'a');
+  std::string second(20, 'b');
+  std::string wire = "d5:filesd"
+    "20:" + first + "d8:completei5e10:downloadedi50e10:incompletei3ee"
+    "20:" + second + "d8:completei-1ee"
+    "e5:flagsd20:min_request_intervali1800eee";
+
+  ScrapeResponse response;
+  BOOST_CHECK_EQUAL(response.isFailure(), true);
+  response.wireDecode(BufferView(wire.data(), wire.size()));
+  BOOST_CHECK_EQUAL(response.isFailure(), false);
+  BOOST_CHECK_EQUAL(response.getFiles().size(), 2);
+  BOOST_CHECK_EQUAL(response.getMinRequestInterval(), 1800);
+
+  const ScrapeStats* stats = response.find(BufferView(first.data(), first.size()));
+  BOOST_REQUIRE(stats != nullptr);
+  BOOST_CHECK_EQUAL(stats->complete, 5);
+  BOOST_CHECK_EQUAL(stats->downloaded, 50);
+  BOOST_CHECK_EQUAL(stats->incomplete, 3);
+
+  // missing and negative counts read as 0
+  stats = response.find(BufferView(second.data(), second.size()));
+  BOOST_REQUIRE(stats != nullptr);
+  BOOST_CHECK_EQUAL(stats->complete, 0);
+  BOOST_CHECK_EQUAL(stats->downloaded, 0);
+  BOOST_CHECK_EQUAL(stats->incomplete, 0);
+
+  std::string unknown(20, 'c');
+  BOOST_CHECK(response.find(BufferView(unknown.data(), unknown.size())) == nullptr);
+
+  wire = "d7:failure6:deniede";
+  response.wireDecode(BufferView(wire.data(), wire.size()));
+  BOOST_CHECK_EQUAL(response.isFailure(), true);
+  BOOST_CHECK_EQUAL(response.getFailure(), "denied");
+  BOOST_CHECK(response.getFiles().empty());
+
+  wire = "d8:intervali900ee";
+  BOOST_CHECK_THROW(response.wireDecode(BufferView(wire.data(), wire.size())),
+                    ScrapeResponse::Error);
+  wire = "d5:filesd20:" + first + "i1eee";
+  BOOST_CHECK_THROW(response.wireDecode(BufferView(wire.data(), wire.size())),
+                    ScrapeResponse::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "storage/storage.hpp"
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(TestStorage)
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+  boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+                                 boost::filesystem::unique_path();
+
+  {
+    Storage storage;
+    storage.open(path.string(), 10, 4);
+
+    BOOST_CHECK_EQUAL(storage.hasExistingData(), false);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), 10);
+
+    // out of order, the last piece is short
+    uint8_t piece2[] = {'8', '9'};
+    uint8_t piece0[] = {'0', '1', '2', '3'};
+    uint8_t piece1[] = {'6', '7'};
+    storage.writeBlock(2, 0, BufferView(piece2, sizeof(piece2)));
+    storage.writeBlock(0, 0, BufferView(piece0, sizeof(piece0)));
+    storage.writeBlock(1, 2, BufferView(piece1, sizeof(piece1)));
+
+    BOOST_CHECK_THROW(storage.writeBlock(2, 1, BufferView(piece2, sizeof(piece2))),
+                      Storage::Error);
+
+    BufferPtr block = storage.readBlock(0, 2, 2);
+    BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "23");
+
+    // reads are clamped to the end of the payload
+    block = storage.readBlock(2, 0, 4);
+    BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "89");
+  }
+
+  {
+    // reopening keeps the data
+    Storage storage;
+    storage.open(path.string(), 10, 4);
+    BOOST_CHECK_EQUAL(storage.hasExistingData(), true);
+
+    BufferPtr block = storage.readBlock(1, 2, 2);
+    BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "67");
+  }
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(MultiFile)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                                boost::filesystem::unique_path();
+
+  // payload "0123456789" as a(3) + empty + sub/b(5) + c(2), pieces of 4 bytes
+  std::vector<Storage::FileSpec> files = {
+    {(dir / "a").string(), 3},
+    {(dir / "empty").string(), 0},
+    {(dir / "sub" / "b").string(), 5},
+    {(dir / "c").string(), 2}
+  };
+
+  {
+    Storage storage;
+    storage.open(files, 4);
+
+    BOOST_CHECK_EQUAL(storage.getLength(), 10);
+    BOOST_CHECK_EQUAL(storage.getNumFiles(), 4);
+    BOOST_CHECK(boost::filesystem::exists(dir / "empty"));
+
+    uint8_t piece1[] = {'4', '5', '6', '7'};
+    uint8_t piece0[] = {'0', '1', '2', '3'};
+    uint8_t piece2[] = {'8', '9'};
+    storage.writeBlock(1, 0, BufferView(piece1, sizeof(piece1)));
+    storage.writeBlock(0, 0, BufferView(piece0, sizeof(piece0)));
+    storage.writeBlock(2, 0, BufferView(piece2, sizeof(piece2)));
+
+    // a block spanning three files
+    BufferPtr block = storage.readBlock(0, 2, 7);
+    BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "2345678");
+
+    std::vector<Storage::Segment> segments;
+    storage.locate(1, 3, 100, segments);
+    BOOST_REQUIRE_EQUAL(segments.size(), 2);
+    BOOST_CHECK_EQUAL(segments[0].offset, 4);
+    BOOST_CHECK_EQUAL(segments[0].length, 1);
+    BOOST_CHECK_EQUAL(segments[1].offset, 0);
+    BOOST_CHECK_EQUAL(segments[1].length, 2);
+  }
+
+  std::ifstream is((dir / "sub" / "b").string());
+  std::string content;
+  is >> content;
+  BOOST_CHECK_EQUAL(content, "34567");
+
+  Storage storage;
+  std::vector<Storage::FileSpec> unsafe = {{(dir / ".." / "x").string(), 1}};
+  BOOST_CHECK_THROW(storage.open(unsafe, 4), Storage::Error);
+
+  boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(PayloadPath)
+{
+  BOOST_CHECK_EQUAL(Storage::makePayloadPath("name", {}), "name");
+  BOOST_CHECK_EQUAL(Storage::makePayloadPath("name", {"sub", "a.txt"}), "name/sub/a.txt");
+  BOOST_CHECK_EQUAL(Storage::makePayloadPath("..name", {"a..b"}), "..name/a..b");
+
+  // an absolute name, e.g. of a single-file torrent
+  BOOST_CHECK_THROW(Storage::makePayloadPath("/etc/cron.d/x", {}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("", {"a"}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("..", {}), Storage::Error);
+
+  // components that are empty, climb up or hide more components
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {"sub", ""}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {"..", "x"}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {"."}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {"a/../../x"}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {"/etc"}), Storage::Error);
+  BOOST_CHECK_THROW(Storage::makePayloadPath("name", {std::string("a\0b", 3)}),
+                    Storage::Error);
+}
+
+BOOST_AUTO_TEST_CASE(Mapped)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+                                boost::filesystem::unique_path();
+
+  std::vector<Storage::FileSpec> files = {
+    {(dir / "a").string(), 6},
+    {(dir / "b").string(), 4}
+  };
+
+  {
+    Storage storage;
+    storage.open(files, 4, Storage::MODE_MMAP);
+    BOOST_CHECK(storage.isMapped());
+    storage.advise(Storage::ACCESS_SEQUENTIAL);
+
+    uint8_t data[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    storage.writeBlock(0, 0, BufferView(data, 4));
+    storage.writeBlock(1, 0, BufferView(data + 4, 4));
+    storage.writeBlock(2, 0, BufferView(data + 8, 2));
+    storage.syncPiece(1);
+
+    // piece 0 lies in one file and can be accessed in place, piece 1 spans two
+    BufferView piece = storage.getMappedBlock(0, 0, 4);
+    BOOST_CHECK_EQUAL(std::string(piece.begin(), piece.end()), "0123");
+    BOOST_CHECK(storage.getMappedBlock(1, 0, 4).empty());
+
+    BufferPtr block = storage.readBlock(1, 0, 4);
+    BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "4567");
+
+    std::vector<Storage::Segment> segments;
+    storage.locate(1, 0, 4, segments);
+    BOOST_REQUIRE_EQUAL(segments.size(), 2);
+    BOOST_CHECK_EQUAL(std::string(segments[1].data, segments[1].data + segments[1].length), "67");
+    storage.sync();
+  }
+
+  // the data made it to the files
+  Storage storage;
+  storage.open(files, 4);
+  BufferPtr block = storage.readBlock(0, 0, 10);
+  BOOST_CHECK_EQUAL(std::string(block->begin(), block->end()), "0123456789");
+
+  boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
@@ -0,0 +1,189 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "tracker/tracker-list.hpp"
+
+#include "fake-tracker.hpp"
+
+namespace sbt {
+namespace test {
+
+static TrackerRequestParam
+makeListParam()
+{
+  TrackerRequestParam param;
+  param.setInfoHash(make_shared<Buffer>(20, 0xe2));
+  param.setPeerId("SIMPLEBT.TEST.PEERID");
+  param.setPort(6881);
+  param.setLeft(100);
+  return param;
+}
+
+BOOST_AUTO_TEST_SUITE(TestTrackerList)
+
+BOOST_AUTO_TEST_CASE(ParseUrl)
+{
+  TrackerUrl url = TrackerUrl::parse("http://tracker.example.com/announce?key=1");
+  BOOST_CHECK_EQUAL(url.scheme, "http");
+  BOOST_CHECK_EQUAL(url.host, "tracker.example.com");
+  BOOST_CHECK_EQUAL(url.port, "80");
+  BOOST_CHECK_EQUAL(url.path, "/announce?key=1");
+
+  url = TrackerUrl::parse("https://[2001:db8::1]:8443/announce");
+  BOOST_CHECK_EQUAL(url.scheme, "https");
+  BOOST_CHECK_EQUAL(url.host, "2001:db8::1");
+  BOOST_CHECK_EQUAL(url.port, "8443");
+
+  url = TrackerUrl::parse("udp://tracker.example.com:6969");
+  BOOST_CHECK_EQUAL(url.scheme, "udp");
+  BOOST_CHECK_EQUAL(url.port, "6969");
+  BOOST_CHECK_EQUAL(url.path, "/");
+
+  BOOST_CHECK_THROW(TrackerUrl::parse("udp://tracker.example.com/announce"), Tracker::Error);
+  BOOST_CHECK_THROW(TrackerUrl::parse("wss://tracker.example.com/announce"), Tracker::Error);
+  BOOST_CHECK_THROW(TrackerUrl::parse("http://tracker.example.com"), Tracker::Error);
+}
+
+BOOST_AUTO_TEST_CASE(Tiers)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  TrackerList trackers(reactor, resolver);
+
+  std::vector<std::string> tier;
+  tier.push_back("http://a.example.com/announce");
+  tier.push_back("wss://b.example.com/announce");
+  tier.push_back("udp://c.example.com:6969");
+  BOOST_CHECK_EQUAL(trackers.addTier(tier), 2);
+  BOOST_CHECK_EQUAL(trackers.addTier(std::vector<std::string>(1, "magnet:?")), 0);
+  BOOST_REQUIRE_EQUAL(trackers.getNumTiers(), 1);
+  BOOST_CHECK_EQUAL(trackers.getTier(0)[0], "http://a.example.com/announce");
+  BOOST_CHECK_EQUAL(trackers.getTier(0)[1], "udp://c.example.com:6969");
+
+  std::string error;
+  TrackerList empty(reactor, resolver);
+  empty.announce(makeListParam(), nullptr,
+                 [] (uint64_t) { BOOST_ERROR("announce without trackers succeeded"); },
+                 [&] (const std::string& reason) { error = reason; });
+  BOOST_CHECK(!error.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ParallelAnnounce)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker first;
+  FakeTracker second;
+
+  TrackerList trackers(reactor, resolver);
+  std::vector<std::string> tier;
+  tier.push_back(first.getUrl());
+  tier.push_back(second.getUrl());
+  trackers.addTier(tier);
+
+  std::vector<std::vector<PeerEndpoint>> batches;
+  std::vector<uint64_t> intervals;
+  trackers.announce(makeListParam(),
+                    [&] (const std::vector<PeerEndpoint>& peers) { batches.push_back(peers); },
+                    [&] (uint64_t interval) { intervals.push_back(interval); },
+                    [&] (const std::string& reason) { BOOST_ERROR(reason); });
+  BOOST_CHECK(trackers.isBusy());
+
+  // both trackers are asked at once
+  BOOST_REQUIRE_EQUAL(FakeTracker::countRequests(first.receiveRequest(reactor)), 1);
+  BOOST_REQUIRE_EQUAL(FakeTracker::countRequests(second.receiveRequest(reactor)), 1);
+
+  // the second tracker is faster, its peers are handed out right away
+  second.sendBody(std::string("d8:intervali600e5:peers12:"
+                              "\x7f\x00\x00\x01\x1a\xe1\x0a\x00\x00\x02\x1a\xe2" "e", 39));
+  for (int i = 0; i < 100 && batches.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(batches.size(), 1);
+  BOOST_CHECK_EQUAL(batches[0].size(), 2);
+  BOOST_CHECK(intervals.empty());
+  BOOST_CHECK_EQUAL(trackers.getTier(0)[0], second.getUrl());
+
+  // of the slower answer only the peer not seen before is new
+  first.sendBody(std::string("d8:intervali900e5:peers12:"
+                             "\x0a\x00\x00\x02\x1a\xe2\x0a\x00\x00\x03\x1a\xe3" "e", 39));
+  for (int i = 0; i < 100 && intervals.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(batches.size(), 2);
+  BOOST_REQUIRE_EQUAL(batches[1].size(), 1);
+  BOOST_CHECK_EQUAL(batches[1][0].getIp(), "10.0.0.3");
+  BOOST_CHECK_EQUAL(batches[1][0].port, 6883);
+  BOOST_REQUIRE_EQUAL(intervals.size(), 1);
+  BOOST_CHECK_EQUAL(intervals[0], 600);
+  BOOST_CHECK_EQUAL(trackers.isBusy(), false);
+}
+
+BOOST_AUTO_TEST_CASE(Fallback)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeTracker backup;
+
+  // nobody listens on the port of a tracker that is gone
+  std::string refusedUrl;
+  {
+    FakeTracker gone;
+    refusedUrl = gone.getUrl();
+  }
+
+  TrackerList trackers(reactor, resolver);
+  trackers.addTier(std::vector<std::string>(1, refusedUrl));
+  trackers.addTier(std::vector<std::string>(1, backup.getUrl()));
+
+  size_t nPeers = 0;
+  std::vector<uint64_t> intervals;
+  std::string error;
+  auto announce = [&] {
+    trackers.announce(makeListParam(),
+                      [&] (const std::vector<PeerEndpoint>& peers) { nPeers += peers.size(); },
+                      [&] (uint64_t interval) { intervals.push_back(interval); },
+                      [&] (const std::string& reason) { error = reason; });
+  };
+
+  // the second tier is only asked once the first one has failed
+  announce();
+  BOOST_REQUIRE_EQUAL(FakeTracker::countRequests(backup.receiveRequest(reactor)), 1);
+  backup.sendBody(std::string("d8:intervali300e5:peers6:\x0a\x00\x00\x02\x1a\xe2" "e", 33));
+  for (int i = 0; i < 100 && intervals.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(nPeers, 1);
+  BOOST_REQUIRE_EQUAL(intervals.size(), 1);
+  BOOST_CHECK_EQUAL(intervals[0], 300);
+  BOOST_CHECK(error.empty());
+
+  // a failure answer counts as no answer
+  announce();
+  BOOST_REQUIRE_EQUAL(FakeTracker::countRequests(backup.receiveRequest(reactor)), 1);
+  backup.sendBody("d7:failure9:not founde");
+  for (int i = 0; i < 100 && error.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(error, "not found");
+  BOOST_CHECK_EQUAL(intervals.size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt
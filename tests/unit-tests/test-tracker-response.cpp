@@ -21,6 +21,7 @@
 
 #include "tracker-response.hpp"
 #include <sstream>
+#include <arpa/inet.h>
 
 #include "boost-test.hpp"
 
@@ -105,6 +106,9 @@ BOOST_AUTO_TEST_CASE(Basic)
   BOOST_CHECK_EQUAL(response10.isFailure(), false);
   BOOST_CHECK_EQUAL(response10.getInterval(), 100);
   BOOST_CHECK_EQUAL(response10.getPeers().size(), 1);
+  BOOST_REQUIRE_EQUAL(response10.getEndpoints().size(), 1);
+  BOOST_CHECK_EQUAL(response10.getEndpoints()[0].getIp(), ip);
+  BOOST_CHECK_EQUAL(response10.getEndpoints()[0].port, port);
 
   TrackerResponse response2("no torrent");
 
@@ -129,6 +133,89 @@ BOOST_AUTO_TEST_CASE(Basic)
   BOOST_CHECK_EQUAL(response20.getFailure(), "no torrent");
 }
 
+BOOST_AUTO_TEST_CASE(Compact)
+{
+  std::string peers("\x7f\x00\x00\x01\x30\x39"
+                    "\x0a\x01\x02\x03\x1a\xe1", 12);
+  std::string peers6("\x20\x01\x0d\xb8\x00\x00\x00\x00"
+                     "\x00\x00\x00\x00\x00\x00\x00\x01\x00\x50", 18);
+  std::string wire = "d8:intervali1800e5:peers12:" + peers + "6:peers618:" + peers6 + "e";
+
+  TrackerResponse response;
+  response.wireDecode(BufferView(wire.data(), wire.size()));
+
+  BOOST_CHECK_EQUAL(response.isFailure(), false);
+  BOOST_CHECK_EQUAL(response.getInterval(), 1800);
+  BOOST_CHECK_EQUAL(response.getPeers().size(), 0);
+
+  const auto& endpoints = response.getEndpoints();
+  BOOST_REQUIRE_EQUAL(endpoints.size(), 3);
+  BOOST_CHECK_EQUAL(endpoints[0].family, AF_INET);
+  BOOST_CHECK_EQUAL(endpoints[0].getIp(), "127.0.0.1");
+  BOOST_CHECK_EQUAL(endpoints[0].port, 12345);
+  BOOST_CHECK_EQUAL(endpoints[1].getIp(), "10.1.2.3");
+  BOOST_CHECK_EQUAL(endpoints[1].port, 6881);
+  BOOST_CHECK_EQUAL(endpoints[2].family, AF_INET6);
+  BOOST_CHECK_EQUAL(endpoints[2].getIp(), "2001:db8::1");
+  BOOST_CHECK_EQUAL(endpoints[2].port, 80);
+
+  sockaddr_storage addr;
+  BOOST_CHECK_EQUAL(endpoints[0].toSockaddr(addr), sizeof(sockaddr_in));
+  const sockaddr_in* in = reinterpret_cast<const sockaddr_in*>(&addr);
+  BOOST_CHECK_EQUAL(ntohs(in->sin_port), 12345);
+  BOOST_CHECK_EQUAL(ntohl(in->sin_addr.s_addr), 0x7f000001);
+  BOOST_CHECK_EQUAL(endpoints[2].toSockaddr(addr), sizeof(sockaddr_in6));
+
+  PeerEndpoint local;
+  BOOST_CHECK(local.setIp("127.0.0.1"));
+  local.port = 12345;
+  BOOST_CHECK(local == endpoints[0]);
+  BOOST_CHECK(!local.setIp("localhost"));
+}
+
+BOOST_AUTO_TEST_CASE(CompactLarge)
+{
+  const size_t nPeers = 10000;
+  std::string peers;
+  for (size_t i = 0; i < nPeers; i++) {
+    uint8_t entry[6] = {10, 0, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i),
+                        static_cast<uint8_t>((i + 1024) >> 8), static_cast<uint8_t>(i + 1024)};
+    peers.append(reinterpret_cast<const char*>(entry), sizeof(entry));
+  }
+  std::string wire = "d8:intervali900e5:peers" + std::to_string(peers.size()) + ":" + peers + "e";
+
+  TrackerResponse response;
+  response.wireDecode(BufferView(wire.data(), wire.size()));
+
+  const auto& endpoints = response.getEndpoints();
+  BOOST_REQUIRE_EQUAL(endpoints.size(), nPeers);
+  BOOST_CHECK_EQUAL(endpoints[0].getIp(), "10.0.0.0");
+  BOOST_CHECK_EQUAL(endpoints[0].port, 1024);
+  BOOST_CHECK_EQUAL(endpoints[nPeers - 1].getIp(), "10.0.39.15");
+  BOOST_CHECK_EQUAL(endpoints[nPeers - 1].port, nPeers - 1 + 1024);
+}
+
+BOOST_AUTO_TEST_CASE(CompactMalformed)
+{
+  TrackerResponse response;
+
+  std::string wire = "d8:intervali900e5:peers7:abcdefge";
+  BOOST_CHECK_THROW(response.wireDecode(BufferView(wire.data(), wire.size())),
+                    TrackerResponse::Error);
+
+  wire = "d8:intervali900e6:peers66:abcdefe";
+  BOOST_CHECK_THROW(response.wireDecode(BufferView(wire.data(), wire.size())),
+                    TrackerResponse::Error);
+
+  wire = "d8:intervali900e5:peersi1ee";
+  BOOST_CHECK_THROW(response.wireDecode(BufferView(wire.data(), wire.size())),
+                    TrackerResponse::Error);
+
+  wire = "d8:intervali900e5:peers0:e";
+  response.wireDecode(BufferView(wire.data(), wire.size()));
+  BOOST_CHECK_EQUAL(response.getEndpoints().size(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace test
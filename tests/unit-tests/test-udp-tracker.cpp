@@ -0,0 +1,336 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+ * Copyright (c) 2014,  Regents of the University of California
+ *
+ * This file is part of Simple BT.
+ * See AUTHORS.md for complete list of Simple BT authors and contributors.
+ *
+ * NSL is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NSL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NSL, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \author Yingdi Yu <yingdi@cs.ucla.edu>
+ */
+
+#include "tracker/udp-tracker.hpp"
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "boost-test.hpp"
+
+namespace sbt {
+namespace test {
+
+/**
+ * @brief A UDP tracker on the loopback interface, driven by hand from the test
+ */
+class FakeUdpTracker
+{
+public:
+  FakeUdpTracker()
+    : m_peerLength(sizeof(m_peer))
+  {
+    m_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    BOOST_REQUIRE_EQUAL(bind(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    net::Reactor::setNonBlocking(m_sock);
+
+    socklen_t length = sizeof(addr);
+    getsockname(m_sock, reinterpret_cast<sockaddr*>(&addr), &length);
+    m_port = std::to_string(ntohs(addr.sin_port));
+  }
+
+  ~FakeUdpTracker()
+  {
+    close(m_sock);
+  }
+
+  const std::string&
+  getPort() const
+  {
+    return m_port;
+  }
+
+  /**
+   * @brief Run @p reactor until a datagram arrives
+   */
+  Buffer
+  receive(net::Reactor& reactor)
+  {
+    uint8_t buf[2048];
+    for (int i = 0; i < 200; ++i) {
+      reactor.runOnce(5);
+      m_peerLength = sizeof(m_peer);
+      ssize_t res = recvfrom(m_sock, buf, sizeof(buf), 0,
+                             reinterpret_cast<sockaddr*>(&m_peer), &m_peerLength);
+      if (res >= 0)
+        return Buffer(buf, res);
+    }
+    return Buffer();
+  }
+
+  void
+  reply(const Buffer& datagram)
+  {
+    BOOST_REQUIRE_EQUAL(sendto(m_sock, datagram.buf(), datagram.size(), 0,
+                               reinterpret_cast<sockaddr*>(&m_peer), m_peerLength),
+                        datagram.size());
+  }
+
+private:
+  int m_sock;
+  std::string m_port;
+  sockaddr_storage m_peer;
+  socklen_t m_peerLength;
+};
+
+static uint32_t
+getUint32(const Buffer& buf, size_t offset)
+{
+  uint32_t value;
+  memcpy(&value, &buf[offset], 4);
+  return ntohl(value);
+}
+
+static uint64_t
+getUint64(const Buffer& buf, size_t offset)
+{
+  uint64_t value;
+  memcpy(&value, &buf[offset], 8);
+  return be64toh(value);
+}
+
+static void
+putUint32(Buffer& buf, uint32_t value)
+{
+  value = htonl(value);
+  buf.insert(buf.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 4);
+}
+
+static void
+putUint64(Buffer& buf, uint64_t value)
+{
+  value = htobe64(value);
+  buf.insert(buf.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 8);
+}
+
+static Buffer
+makeConnectResponse(const Buffer& request, uint64_t connectionId)
+{
+  Buffer response;
+  putUint32(response, UdpTracker::ACTION_CONNECT);
+  putUint32(response, getUint32(request, 12));
+  putUint64(response, connectionId);
+  return response;
+}
+
+static TrackerRequestParam
+makeParam()
+{
+  TrackerRequestParam param;
+  param.setInfoHash(make_shared<Buffer>(20, 0xe2));
+  param.setPeerId("SIMPLEBT.TEST.PEERID");
+  param.setPort(6881);
+  param.setLeft(100);
+  param.setDownloaded(5);
+  param.setEvent(TrackerRequestParam::STARTED);
+  return param;
+}
+
+BOOST_AUTO_TEST_SUITE(TestUdpTracker)
+
+BOOST_AUTO_TEST_CASE(Announce)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeUdpTracker server;
+
+  UdpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort());
+
+  std::vector<TrackerResponse> responses;
+  auto onResponse = [&] (const TrackerResponse& response) { responses.push_back(response); };
+  auto onError = [&] (const std::string& reason) { BOOST_ERROR(reason); };
+
+  tracker.announce(makeParam(), onResponse, onError);
+  BOOST_CHECK(tracker.isBusy());
+
+  Buffer connect = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(connect.size(), UdpTracker::CONNECT_LENGTH);
+  BOOST_CHECK_EQUAL(getUint64(connect, 0), UdpTracker::PROTOCOL_ID);
+  BOOST_CHECK_EQUAL(getUint32(connect, 8), UdpTracker::ACTION_CONNECT);
+  server.reply(makeConnectResponse(connect, 0x1122334455667788));
+
+  Buffer announce = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(announce.size(), UdpTracker::ANNOUNCE_LENGTH);
+  BOOST_CHECK_EQUAL(getUint64(announce, 0), 0x1122334455667788);
+  BOOST_CHECK_EQUAL(getUint32(announce, 8), UdpTracker::ACTION_ANNOUNCE);
+  BOOST_CHECK_EQUAL(std::string(&announce[16], &announce[36]), std::string(20, '\xe2'));
+  BOOST_CHECK_EQUAL(std::string(&announce[36], &announce[56]), "SIMPLEBT.TEST.PEERID");
+  BOOST_CHECK_EQUAL(getUint64(announce, 56), 5);
+  BOOST_CHECK_EQUAL(getUint64(announce, 64), 100);
+  BOOST_CHECK_EQUAL(getUint64(announce, 72), 0);
+  BOOST_CHECK_EQUAL(getUint32(announce, 80), UdpTracker::EVENT_STARTED);
+  BOOST_CHECK_EQUAL(getUint32(announce, 84), 0);
+  BOOST_CHECK_EQUAL(getUint32(announce, 92), 0xffffffff);
+  BOOST_CHECK_EQUAL(announce[96] * 256 + announce[97], 6881);
+
+  Buffer response;
+  putUint32(response, UdpTracker::ACTION_ANNOUNCE);
+  putUint32(response, getUint32(announce, 12));
+  putUint32(response, 1800);
+  putUint32(response, 3);
+  putUint32(response, 7);
+  uint8_t peers[] = {127, 0, 0, 1, 0x1a, 0xe1, 10, 0, 0, 2, 0x1a, 0xe2};
+  response.insert(response.end(), peers, peers + sizeof(peers));
+
+  // an answer to some other transaction is ignored
+  Buffer stale(response);
+  stale[4] ^= 0xff;
+  server.reply(stale);
+  server.reply(response);
+  for (int i = 0; i < 100 && responses.empty(); ++i)
+    reactor.runOnce(10);
+
+  BOOST_REQUIRE_EQUAL(responses.size(), 1);
+  BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  BOOST_CHECK_EQUAL(responses[0].isFailure(), false);
+  BOOST_CHECK_EQUAL(responses[0].getInterval(), 1800);
+  BOOST_CHECK_EQUAL(responses[0].getIncomplete(), 3);
+  BOOST_CHECK_EQUAL(responses[0].getComplete(), 7);
+  const auto& endpoints = responses[0].getEndpoints();
+  BOOST_REQUIRE_EQUAL(endpoints.size(), 2);
+  BOOST_CHECK_EQUAL(endpoints[0].getIp(), "127.0.0.1");
+  BOOST_CHECK_EQUAL(endpoints[0].port, 6881);
+  BOOST_CHECK_EQUAL(endpoints[1].getIp(), "10.0.0.2");
+  BOOST_CHECK_EQUAL(endpoints[1].port, 6882);
+
+  // the connection id is cached, the next announce goes out right away
+  // a loopback address is not passed on
+  BOOST_CHECK(tracker.hasConnectionId());
+  TrackerRequestParam param = makeParam();
+  param.setIp("127.0.0.1");
+  tracker.announce(param, onResponse, onError);
+  announce = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(announce.size(), UdpTracker::ANNOUNCE_LENGTH);
+  BOOST_CHECK_EQUAL(getUint32(announce, 8), UdpTracker::ACTION_ANNOUNCE);
+  BOOST_CHECK_EQUAL(getUint64(announce, 0), 0x1122334455667788);
+  BOOST_CHECK_EQUAL(getUint32(announce, 84), 0);
+
+  response.resize(UdpTracker::ANNOUNCE_RESPONSE_HEADER_LENGTH);
+  memcpy(&response[4], &announce[12], 4);
+  server.reply(response);
+  for (int i = 0; i < 100 && responses.size() < 2; ++i)
+    reactor.runOnce(10);
+  BOOST_REQUIRE_EQUAL(responses.size(), 2);
+  BOOST_CHECK_EQUAL(responses[1].getEndpoints().size(), 0);
+
+  // a configured public address is
+  param.setIp("203.0.113.5");
+  tracker.announce(param, onResponse, onError);
+  announce = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(announce.size(), UdpTracker::ANNOUNCE_LENGTH);
+  BOOST_CHECK_EQUAL(getUint32(announce, 84), 0xcb007105);
+}
+
+BOOST_AUTO_TEST_CASE(Retransmit)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeUdpTracker server;
+
+  UdpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort());
+  tracker.setRetransmitTimeout(20);
+  tracker.setMaxRetransmissions(2);
+
+  std::string error;
+  bool hasResponse = false;
+  auto onResponse = [&] (const TrackerResponse&) { hasResponse = true; };
+  auto onError = [&] (const std::string& reason) { error = reason; };
+
+  // the first connect request is lost
+  tracker.announce(makeParam(), onResponse, onError);
+  Buffer connect = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(connect.size(), UdpTracker::CONNECT_LENGTH);
+  uint64_t start = net::Reactor::now();
+  Buffer connect2 = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(connect2.size(), UdpTracker::CONNECT_LENGTH);
+  BOOST_CHECK_GE(net::Reactor::now() - start, 10);
+  BOOST_CHECK(connect == connect2);
+  server.reply(makeConnectResponse(connect2, 42));
+
+  // the tracker refuses
+  Buffer announce = server.receive(reactor);
+  BOOST_REQUIRE_EQUAL(announce.size(), UdpTracker::ANNOUNCE_LENGTH);
+  Buffer failure;
+  putUint32(failure, UdpTracker::ACTION_ERROR);
+  putUint32(failure, getUint32(announce, 12));
+  std::string message("unregistered torrent");
+  failure.insert(failure.end(), message.begin(), message.end());
+  server.reply(failure);
+  for (int i = 0; i < 100 && error.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(error, "Tracker 127.0.0.1 failed: unregistered torrent");
+
+  // no answer at all: the request goes out 1 + 2 times, then the announce fails
+  error.clear();
+  tracker.announce(makeParam(), onResponse, onError);
+  size_t nAnnounces = 0;
+  for (int i = 0; i < 3; ++i)
+    nAnnounces += server.receive(reactor).size() == UdpTracker::ANNOUNCE_LENGTH;
+  BOOST_CHECK_EQUAL(nAnnounces, 3);
+  for (int i = 0; i < 100 && error.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(error, "Tracker 127.0.0.1 timed out");
+  BOOST_CHECK_EQUAL(tracker.isBusy(), false);
+  BOOST_CHECK_EQUAL(hasResponse, false);
+}
+
+BOOST_AUTO_TEST_CASE(MalformedPeers)
+{
+  net::Reactor reactor;
+  net::Resolver resolver(reactor);
+  FakeUdpTracker server;
+
+  UdpTracker tracker(reactor, resolver);
+  tracker.setTarget("127.0.0.1", server.getPort());
+
+  std::string error;
+  tracker.announce(makeParam(), [] (const TrackerResponse&) {},
+                   [&] (const std::string& reason) { error = reason; });
+  server.reply(makeConnectResponse(server.receive(reactor), 1));
+  Buffer announce = server.receive(reactor);
+
+  Buffer response;
+  putUint32(response, UdpTracker::ACTION_ANNOUNCE);
+  putUint32(response, getUint32(announce, 12));
+  putUint32(response, 1800);
+  putUint32(response, 0);
+  putUint32(response, 0);
+  response.insert(response.end(), 5, 0);
+  server.reply(response);
+  for (int i = 0; i < 100 && error.empty(); ++i)
+    reactor.runOnce(10);
+  BOOST_CHECK_EQUAL(error.compare(0, 39, "Malformed response of tracker 127.0.0.1"), 0);
+
+  BOOST_CHECK_THROW(tracker.announce(TrackerRequestParam(), nullptr, nullptr), UdpTracker::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace test
+} // namespace sbt